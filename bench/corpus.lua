@@ -0,0 +1,233 @@
+--------------
+-- Synthetic projects for benchmarking LDoc (see bench/run.lua).
+--
+-- A corpus has `modules` modules of `items` documented functions each, in
+-- Lua, C or MoonScript, plus `topics` Markdown topics. On average every
+-- item has `refs` references (`@see` and inline `@{...}`) to other items,
+-- and the topics have `paragraphs` sections of headers, lists, code and
+-- references. It is generated with its own random number generator from
+-- `seed`, so the same parameters always give the same files.
+--
+-- As a script: `lua bench/corpus.lua DIR [name=value ...]`, e.g.
+--
+--    lua bench/corpus.lua /tmp/corpus modules=200 items=30 lang=c
+
+local corpus = {}
+
+corpus.defaults = {
+   lang = 'lua', modules = 50, items = 20, refs = 2,
+   topics = 5, paragraphs = 20, seed = 1,
+}
+
+local extensions = {lua = '.lua', c = '.c', moon = '.moon'}
+
+-- a fixed linear congruential generator; math.random differs between versions
+local function generator (seed)
+   local state = seed % 2147483647
+   if state <= 0 then state = state + 2147483646 end
+   return function (n)
+      state = state * 16807 % 2147483647
+      return state % n + 1
+   end
+end
+
+local words = {
+   'value', 'table', 'string', 'index', 'buffer', 'option', 'result', 'handler',
+   'number', 'list', 'entry', 'module', 'field', 'object', 'callback', 'stream',
+   'key', 'path', 'limit', 'error', 'the', 'a', 'of', 'to', 'given', 'new',
+}
+
+local types = {'string', 'number', 'int', 'bool', 'tab', 'func', '{string,...}', '?string'}
+
+local function mod_name (i)
+   return ('bench.mod%03d'):format(i)
+end
+
+local function fun_name (j)
+   return ('fun%02d'):format(j)
+end
+
+local function writefile (name, text)
+   local f = assert(io.open(name, 'wb'))
+   f:write(text)
+   f:close()
+end
+
+local function mkdir (dir)
+   local sep = package.config:sub(1,1)
+   if sep == '\\' then
+      dir = dir:gsub('/','\\')
+      os.execute('if not exist "'..dir..'" mkdir "'..dir..'"')
+   else
+      os.execute("mkdir -p '"..dir.."'")
+   end
+end
+
+--- generate a corpus into the directory `dir`, with the parameters `opts`
+-- (missing ones are taken from `corpus.defaults`).
+-- Returns the parameters used.
+function corpus.generate (dir, opts)
+   local p = {}
+   for k, v in pairs(corpus.defaults) do p[k] = v end
+   for k, v in pairs(opts or {}) do p[k] = v end
+   local ext = extensions[p.lang]
+   if not ext then error('unknown language '..tostring(p.lang)) end
+   local random = generator(p.seed)
+
+   local function sentence (n)
+      local ws = {}
+      for i = 1, n do ws[i] = words[random(#words)] end
+      ws[1] = ws[1]:sub(1,1):upper()..ws[1]:sub(2)
+      return table.concat(ws, ' ')..'.'
+   end
+
+   local function some_ref ()
+      return mod_name(random(p.modules))..'.'..fun_name(random(p.items))
+   end
+
+   -- about p.refs references per item, some as @see and some inline
+   local function refs_of ()
+      local see, inline = {}, {}
+      local n = random(2 * p.refs + 1) - 1
+      for _ = 1, n do
+         if random(2) == 1 then see[#see+1] = some_ref()
+         else inline[#inline+1] = some_ref()
+         end
+      end
+      return see, inline
+   end
+
+   -- the doc comment lines of item j, without comment markers
+   local function item_lines (j, explicit)
+      local see, inline = refs_of()
+      local lines = {sentence(random(6) + 3)}
+      local desc = {sentence(random(12) + 6)}
+      for _, r in ipairs(inline) do
+         desc[#desc+1] = 'See @{'..r..'} for the '..words[random(#words)]..'.'
+      end
+      lines[#lines+1] = table.concat(desc, ' ')
+      if explicit then lines[#lines+1] = '@function '..fun_name(j) end
+      local nparams = random(4) - 1
+      for k = 1, nparams do
+         local opt = random(4) == 1 and '[opt]' or ''
+         lines[#lines+1] = ('@tparam%s %s p%d %s'):format(opt, types[random(#types)], k, sentence(random(5) + 2))
+      end
+      lines[#lines+1] = '@treturn '..types[random(#types)]..' '..sentence(random(4) + 2)
+      for _, r in ipairs(see) do lines[#lines+1] = '@see '..r end
+      return lines, nparams
+   end
+
+   local function params (n)
+      local ps = {}
+      for k = 1, n do ps[k] = 'p'..k end
+      return table.concat(ps, ', ')
+   end
+
+   local writers = {}
+
+   function writers.lua (i)
+      local out = {'--- '..sentence(6), '-- '..sentence(20), '-- @module '..mod_name(i), '', 'local M = {}', ''}
+      for j = 1, p.items do
+         local lines, nparams = item_lines(j, false)
+         out[#out+1] = '--- '..lines[1]
+         for k = 2, #lines do out[#out+1] = '-- '..lines[k] end
+         out[#out+1] = ('function M.%s(%s)'):format(fun_name(j), params(nparams))
+         out[#out+1] = '   return nil'
+         out[#out+1] = 'end'
+         out[#out+1] = ''
+      end
+      out[#out+1] = 'return M'
+      return out
+   end
+
+   function writers.c (i)
+      local out = {'/// '..sentence(6), '// '..sentence(20), '// @module '..mod_name(i), '',
+         '#include <lua.h>', ''}
+      for j = 1, p.items do
+         local lines = item_lines(j, true)
+         out[#out+1] = '/***'
+         for _, l in ipairs(lines) do out[#out+1] = l end
+         out[#out+1] = '*/'
+         out[#out+1] = ('static int l_%s (lua_State *L) {'):format(fun_name(j))
+         out[#out+1] = '  return 0;'
+         out[#out+1] = '}'
+         out[#out+1] = ''
+      end
+      return out
+   end
+
+   function writers.moon (i)
+      local out = {'----', '-- '..sentence(6), '-- @classmod '..mod_name(i), '', 'class Mod'..i}
+      for j = 1, p.items do
+         local lines, nparams = item_lines(j, false)
+         out[#out+1] = '    --- '..lines[1]
+         for k = 2, #lines do out[#out+1] = '    -- '..lines[k] end
+         out[#out+1] = ('    %s: (%s) =>'):format(fun_name(j), params(nparams))
+         out[#out+1] = '        nil'
+         out[#out+1] = ''
+      end
+      return out
+   end
+
+   local function topic (t)
+      local out = {'# Topic '..t, '', sentence(25), ''}
+      for s = 1, p.paragraphs do
+         out[#out+1] = '## Section '..s
+         out[#out+1] = ''
+         out[#out+1] = sentence(30)..' See @{'..some_ref()..'}.'
+         out[#out+1] = ''
+         for _ = 1, random(4) do
+            out[#out+1] = '* '..sentence(8)..' `'..words[random(#words)]..'`'
+         end
+         out[#out+1] = ''
+         if random(2) == 1 then
+            out[#out+1] = '    local '..words[random(#words)]..' = require "'..mod_name(random(p.modules))..'"'
+            out[#out+1] = '    print(x.'..fun_name(random(p.items))..'(1, "two"))'
+            out[#out+1] = ''
+         end
+         out[#out+1] = sentence(15)..' *'..words[random(#words)]..'* and **'..words[random(#words)]..'**.'
+         out[#out+1] = ''
+      end
+      return out
+   end
+
+   mkdir(dir..'/src')
+   for i = 1, p.modules do
+      writefile(('%s/src/mod%03d%s'):format(dir, i, ext), table.concat(writers[p.lang](i), '\n')..'\n')
+   end
+   local config = {
+      "project = 'bench'",
+      "title = 'LDoc benchmark corpus'",
+      "file = 'src'",
+      "format = 'markdown'",
+   }
+   if p.topics > 0 then
+      mkdir(dir..'/topics')
+      for t = 1, p.topics do
+         writefile(('%s/topics/topic%02d.md'):format(dir, t), table.concat(topic(t), '\n')..'\n')
+      end
+      config[#config+1] = "topics = 'topics'"
+   end
+   writefile(dir..'/config.ld', table.concat(config, '\n')..'\n')
+   return p
+end
+
+if arg and arg[0] and arg[0]:match 'corpus%.lua$' then
+   local dir = arg[1]
+   if not dir then
+      io.stderr:write('usage: lua bench/corpus.lua DIR [name=value ...]\n')
+      os.exit(1)
+   end
+   local opts = {}
+   for i = 2, #arg do
+      local k, v = arg[i]:match '^(%w+)=(.*)$'
+      if not k then
+         io.stderr:write('bad parameter '..arg[i]..'\n')
+         os.exit(1)
+      end
+      opts[k] = tonumber(v) or v
+   end
+   corpus.generate(dir, opts)
+end
+
+return corpus
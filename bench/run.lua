@@ -0,0 +1,290 @@
+--------------
+-- Benchmarks of LDoc on synthetic projects (see bench/corpus.lua).
+--
+--    lua bench/run.lua [--ldoc CMD] [--repeat N] [--only NAME] [--out FILE]
+--    lua bench/run.lua --compare OLD.json NEW.json
+--
+-- Every corpus below is generated into bench/corpus/NAME and documented
+-- N times (default 3) with `--profile`. Of these runs, the one with the
+-- median total time is kept: the time of each phase as timed by ldoc.profile
+-- and, with the launcher, the functions its sampler saw most. The results
+-- go to a JSON file (default bench/results.json); `--compare` shows the phase
+-- times of two such files side by side, e.g. of two commits.
+--
+-- CMD defaults to `lua ldoc.lua` of this checkout; use e.g. `--ldoc ldoc.exe`
+-- for the launcher.
+
+local corpus = dofile((arg[0]:gsub('run%.lua$', 'corpus.lua')))
+
+local corpora = {
+   {name = 'lua-small', lang = 'lua', modules = 20, items = 10},
+   {name = 'lua-large', lang = 'lua', modules = 300, items = 30, refs = 3},
+   {name = 'c', lang = 'c', modules = 100, items = 20},
+   {name = 'moon', lang = 'moon', modules = 100, items = 20},
+   {name = 'markdown', lang = 'lua', modules = 20, items = 10, topics = 40, paragraphs = 60},
+}
+
+local function quit (msg)
+   io.stderr:write('bench: ', msg, '\n')
+   os.exit(1)
+end
+
+local function readfile (name)
+   local f = io.open(name, 'rb')
+   if not f then return nil end
+   local text = f:read '*a'
+   f:close()
+   return text
+end
+
+local function command_output (cmd)
+   local f = io.popen(cmd)
+   if not f then return nil end
+   local out = f:read '*a'
+   f:close()
+   return out:match '^%s*(.-)%s*$'
+end
+
+local function succeeded (...)
+   local ok, _, code = ...
+   if type(ok) == 'number' then return ok == 0 end -- Lua 5.1
+   return ok == true and (code == nil or code == 0)
+end
+
+------- JSON, just enough for the results ----------
+
+local function encode (v, indent, out)
+   local t = type(v)
+   if t == 'table' then
+      local inner = indent..'  '
+      if #v > 0 or next(v) == nil then
+         out[#out+1] = '['
+         for i, x in ipairs(v) do
+            out[#out+1] = (i > 1 and ',\n' or '\n')..inner
+            encode(x, inner, out)
+         end
+         out[#out+1] = (#v > 0 and '\n'..indent or '')..']'
+      else
+         local keys = {}
+         for k in pairs(v) do keys[#keys+1] = tostring(k) end
+         table.sort(keys)
+         out[#out+1] = '{'
+         for i, k in ipairs(keys) do
+            out[#out+1] = (i > 1 and ',\n' or '\n')..inner
+            encode(k, inner, out)
+            out[#out+1] = ': '
+            encode(v[k], inner, out)
+         end
+         out[#out+1] = '\n'..indent..'}'
+      end
+   elseif t == 'string' then
+      out[#out+1] = '"'..v:gsub('[%c"\\]', function(c)
+         return ('\\u%04x'):format(c:byte())
+      end)..'"'
+   elseif t == 'number' then
+      out[#out+1] = ('%.6g'):format(v)
+   else
+      out[#out+1] = tostring(v)
+   end
+end
+
+local function decode (s)
+   local pos = 1
+   local value
+   local function skip ()
+      pos = s:find('%S', pos) or #s + 1
+   end
+   local function fail ()
+      error(('bad JSON at %d'):format(pos), 0)
+   end
+   local function str ()
+      local res, i = {}, pos + 1
+      while true do
+         local c = s:sub(i, i)
+         if c == '"' then break
+         elseif c == '' then fail()
+         elseif c == '\\' then
+            local e = s:sub(i + 1, i + 1)
+            if e == 'u' then
+               res[#res+1] = string.char(tonumber(s:sub(i + 2, i + 5), 16) % 256)
+               i = i + 6
+            else
+               res[#res+1] = ({n = '\n', t = '\t', r = '\r', b = '\b', f = '\f'})[e] or e
+               i = i + 2
+            end
+         else
+            res[#res+1] = c
+            i = i + 1
+         end
+      end
+      pos = i + 1
+      return table.concat(res)
+   end
+   function value ()
+      skip()
+      local c = s:sub(pos, pos)
+      if c == '{' or c == '[' then
+         local res, close = {}, c == '{' and '}' or ']'
+         pos = pos + 1
+         skip()
+         if s:sub(pos, pos) == close then
+            pos = pos + 1
+            return res
+         end
+         while true do
+            if close == '}' then
+               skip()
+               if s:sub(pos, pos) ~= '"' then fail() end
+               local k = str()
+               skip()
+               if s:sub(pos, pos) ~= ':' then fail() end
+               pos = pos + 1
+               res[k] = value()
+            else
+               res[#res+1] = value()
+            end
+            skip()
+            c = s:sub(pos, pos)
+            pos = pos + 1
+            if c == close then return res end
+            if c ~= ',' then fail() end
+         end
+      elseif c == '"' then
+         return str()
+      else
+         local lit = s:match('^[%w%.%-+]+', pos)
+         if not lit then fail() end
+         pos = pos + #lit
+         if lit == 'true' then return true
+         elseif lit == 'false' then return false
+         elseif lit == 'null' then return nil
+         end
+         return tonumber(lit) or fail()
+      end
+   end
+   return value()
+end
+
+------- running LDoc ----------
+
+-- the report of ldoc.profile
+local function parse_profile (text)
+   local res = {phases = {}, functions = {}}
+   res.total = tonumber(text:match 'profile: ([%d%.]+) s')
+   if not res.total then return nil end
+   for line in text:gmatch '[^\n]+' do
+      local name, total, self, calls = line:match '^  (%S+)%s+([%d%.]+)%s+([%d%.]+)%s+(%d+)$'
+      if name then
+         res.phases[name] = {total = tonumber(total), self = tonumber(self), calls = tonumber(calls)}
+      end
+      local fself, ftotal, fname = line:match '^%s+([%d%.]+)%% +([%d%.]+)%%  (.+)$'
+      if fself and #res.functions < 10 then
+         res.functions[#res.functions+1] = {name = fname, self = tonumber(fself), total = tonumber(ftotal)}
+      end
+   end
+   res.samples = tonumber(text:match '(%d+) samples')
+   return res
+end
+
+local function run_ldoc (ldoc, dir, name)
+   local log = dir..'/../'..name..'.log'
+   local cmd = ('cd "%s" && %s --profile --testing --dir out . > "%s" 2>&1'):format(dir, ldoc, log)
+   if not succeeded(os.execute(cmd)) then
+      quit(cmd..' failed, see '..log)
+   end
+   local res = parse_profile(readfile(log) or '')
+   if not res then quit('no profile report in '..log) end
+   return res
+end
+
+local function compare (old_file, new_file)
+   local function load (f)
+      local text = readfile(f) or quit('cannot read '..f)
+      local ok, res = pcall(decode, text)
+      if not ok then quit(f..': '..res) end
+      return res
+   end
+   local old, new = load(old_file), load(new_file)
+   print(('%-12s %-24s %10s %10s %8s'):format('corpus', 'phase', 'old s', 'new s', 'change'))
+   local names = {}
+   for name in pairs(new.corpora) do names[#names+1] = name end
+   table.sort(names)
+   for _, name in ipairs(names) do
+      local o, n = old.corpora[name], new.corpora[name]
+      if o then
+         local rows = {{'total', o.total, n.total}}
+         local phases = {}
+         for phase in pairs(n.phases) do phases[#phases+1] = phase end
+         table.sort(phases)
+         for _, phase in ipairs(phases) do
+            local op = o.phases[phase]
+            rows[#rows+1] = {phase, op and op.total, n.phases[phase].total}
+         end
+         for _, r in ipairs(rows) do
+            local change = r[2] and r[2] > 0 and ('%+7.1f%%'):format(100 * (r[3] - r[2]) / r[2]) or ''
+            print(('%-12s %-24s %10s %10.3f %8s'):format(name, r[1],
+               r[2] and ('%.3f'):format(r[2]) or '-', r[3], change))
+         end
+      end
+   end
+end
+
+------- main ----------
+
+local opts = {['repeat'] = 3}
+local i = 1
+while arg[i] do
+   local a = arg[i]
+   if a == '--compare' then
+      if not arg[i+2] then quit 'usage: --compare OLD.json NEW.json' end
+      compare(arg[i+1], arg[i+2])
+      return
+   elseif a == '--ldoc' or a == '--repeat' or a == '--only' or a == '--out' then
+      opts[a:sub(3)] = arg[i+1] or quit(a..' needs a value')
+      i = i + 2
+   else
+      quit('unknown option '..a)
+   end
+end
+
+local bench_dir = arg[0]:match '^(.-)[/\\]?run%.lua$'
+if bench_dir == '' then bench_dir = '.' end
+local pwd = os.getenv 'PWD' or command_output(package.config:sub(1,1) == '\\' and 'cd' or 'pwd')
+if not bench_dir:match '^[/\\]' and not bench_dir:match '^%a:' then
+   bench_dir = pwd..'/'..bench_dir
+end
+local ldoc = opts.ldoc or ('lua "%s/../ldoc.lua"'):format(bench_dir)
+local runs = tonumber(opts['repeat']) or quit '--repeat needs a number'
+
+local results = {
+   date = os.date '!%Y-%m-%dT%H:%M:%SZ',
+   commit = command_output 'git rev-parse HEAD',
+   ldoc = ldoc,
+   ['repeat'] = runs,
+   corpora = {},
+}
+
+for _, c in ipairs(corpora) do
+   if not opts.only or opts.only == c.name then
+      local dir = bench_dir..'/corpus/'..c.name
+      local params = corpus.generate(dir, c)
+      local times = {}
+      for r = 1, runs do
+         times[r] = run_ldoc(ldoc, dir, c.name)
+      end
+      table.sort(times, function(a, b) return a.total < b.total end)
+      local res = times[math.floor((runs + 1) / 2)]
+      params.name = nil
+      res.params = params
+      results.corpora[c.name] = res
+      print(('%-12s %8.3f s'):format(c.name, res.total))
+   end
+end
+
+local out = opts.out or bench_dir..'/results.json'
+local parts = {}
+encode(results, '', parts)
+local f = io.open(out, 'wb') or quit('cannot write '..out)
+f:write(table.concat(parts), '\n')
+f:close()
+print('results written to '..out)
@@ -2,22 +2,132 @@
 # Essentially reads ldoc.lua (the main script) and converts it into a C-header
 # file for inclusion in ldoc.cpp. The contents of the generated header are pure
 # hex values.
+#
+# Parameters (passed with -D):
+#   INPUT_FILE      - file to be embedded
+#   OUTPUT_FILE     - generated header
+#   VARIABLE        - prefix of the generated symbols (default: ldoc_source), i.e.
+#                     <VARIABLE>_bytes and <VARIABLE>_size
+#   BINARY          - if set, INPUT_FILE is embedded verbatim (e.g. precompiled
+#                     Lua bytecode) instead of being treated as Lua source text
+#
+# Alternatively, a whole module tree is packed into one table when MODULE_DIR
+# is given instead of INPUT_FILE:
+#   MODULE_DIR      - directory containing the 'ldoc' package
+#   PENLIGHT_DIR    - optional; directory containing the 'pl' package, whose
+#                     modules are packed into the same table
+#   LUAC_EXECUTABLE - optional; if set, stripped bytecode of every module is
+#                     embedded next to its source
 
-# Read the file content
-file(READ "${INPUT_FILE}" CONTENT)
+# Converts the content of FILE into the definition of a C array NAME and stores
+# it in OUT_VAR. A trailing 0x00 is appended, which is not part of the data.
+function(hex_array FILE NAME BINARY OUT_VAR)
+  if(BINARY)
+    # Binary chunks may contain NUL bytes, so they must never pass through a
+    # CMake string. Read them as hex right away.
+    file(READ "${FILE}" RAW_HEX HEX)
+  else()
+    # Read the file content
+    file(READ "${FILE}" CONTENT)
 
-# Remove Shebang line (starts with #!) if it exists to prevent Lua syntax errors
-string(REGEX REPLACE "^#![^\n]*\n" "" CLEAN_CONTENT "${CONTENT}")
+    # Remove Shebang line (starts with #!) if it exists to prevent Lua syntax errors
+    string(REGEX REPLACE "^#![^\n]*\n" "" CLEAN_CONTENT "${CONTENT}")
 
-# Convert cleaned content to hex
-file(WRITE "${OUTPUT_FILE}.tmp" "${CLEAN_CONTENT}")
-file(READ "${OUTPUT_FILE}.tmp" RAW_HEX HEX)
-file(REMOVE "${OUTPUT_FILE}.tmp")
+    # Convert cleaned content to hex
+    file(WRITE "${OUTPUT_FILE}.tmp" "${CLEAN_CONTENT}")
+    file(READ "${OUTPUT_FILE}.tmp" RAW_HEX HEX)
+    file(REMOVE "${OUTPUT_FILE}.tmp")
+  endif()
 
-string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," FORMATTED_HEX "${RAW_HEX}")
+  string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," FORMATTED_HEX "${RAW_HEX}")
+  set(${OUT_VAR}
+    "static const unsigned char ${NAME}[] = {\n${FORMATTED_HEX}\n0x00\n};\n" PARENT_SCOPE)
+endfunction()
 
-file(WRITE "${OUTPUT_FILE}" 
+if(MODULE_DIR)
+  # Every Lua file below MODULE_DIR/ldoc becomes a module, e.g.
+  # ldoc/html/ldoc_css.lua is served as 'ldoc.html.ldoc_css'; likewise for
+  # PENLIGHT_DIR/pl, e.g. pl/List.lua as 'pl.List'
+  file(GLOB_RECURSE MODULE_FILES RELATIVE "${MODULE_DIR}" "${MODULE_DIR}/ldoc/*.lua")
+  set(MODULE_PATHS "")
+  foreach(REL_PATH IN LISTS MODULE_FILES)
+    list(APPEND MODULE_PATHS "${MODULE_DIR}/${REL_PATH}")
+  endforeach()
+  if(PENLIGHT_DIR)
+    file(GLOB_RECURSE PENLIGHT_FILES RELATIVE "${PENLIGHT_DIR}" "${PENLIGHT_DIR}/pl/*.lua")
+    if(NOT PENLIGHT_FILES)
+      message(FATAL_ERROR "No Penlight modules found in ${PENLIGHT_DIR}/pl.")
+    endif()
+    foreach(REL_PATH IN LISTS PENLIGHT_FILES)
+      list(APPEND MODULE_FILES "${REL_PATH}")
+      list(APPEND MODULE_PATHS "${PENLIGHT_DIR}/${REL_PATH}")
+    endforeach()
+  endif()
+
+  set(ARRAYS "")
+  set(ENTRIES "")
+  set(INDEX 0)
+  foreach(REL_PATH IN LISTS MODULE_FILES)
+    list(GET MODULE_PATHS ${INDEX} FULL_PATH)
+    string(REGEX REPLACE "\\.lua$" "" MODULE_NAME "${REL_PATH}")
+    string(REGEX REPLACE "/init$" "" MODULE_NAME "${MODULE_NAME}")
+    string(REPLACE "/" "." MODULE_NAME "${MODULE_NAME}")
+
+    set(SOURCE_NAME "ldoc_module_${INDEX}_source")
+    hex_array("${FULL_PATH}" ${SOURCE_NAME} OFF SOURCE_ARRAY)
+    string(APPEND ARRAYS "/* ${REL_PATH} */\n${SOURCE_ARRAY}\n")
+
+    if(LUAC_EXECUTABLE)
+      set(BYTECODE_NAME "ldoc_module_${INDEX}_bytecode")
+      execute_process(
+        COMMAND "${LUAC_EXECUTABLE}" -s -o "${OUTPUT_FILE}.luac" "${FULL_PATH}"
+        RESULT_VARIABLE LUAC_RESULT
+      )
+      if(NOT LUAC_RESULT EQUAL 0)
+        message(FATAL_ERROR "Unable to compile ${REL_PATH} to bytecode.")
+      endif()
+      hex_array("${OUTPUT_FILE}.luac" ${BYTECODE_NAME} ON BYTECODE_ARRAY)
+      file(REMOVE "${OUTPUT_FILE}.luac")
+      string(APPEND ARRAYS "${BYTECODE_ARRAY}\n")
+      set(BYTECODE_REF "${BYTECODE_NAME}, sizeof(${BYTECODE_NAME}) - 1")
+    else()
+      set(BYTECODE_REF "NULL, 0")
+    endif()
+
+    string(APPEND ENTRIES
+      "  {\"${MODULE_NAME}\", \"${REL_PATH}\",\n"
+      "   ${SOURCE_NAME}, sizeof(${SOURCE_NAME}) - 1,\n"
+      "   ${BYTECODE_REF}},\n")
+    math(EXPR INDEX "${INDEX} + 1")
+  endforeach()
+
+  file(WRITE "${OUTPUT_FILE}"
+"#pragma once\n\n"
+"#include <stddef.h>\n\n"
+"struct LDocEmbeddedModule {\n"
+"  const char *name;                 // module name as passed to require()\n"
+"  const char *path;                 // path relative to the share/lua directory\n"
+"  const unsigned char *source;      // Lua source text\n"
+"  unsigned int source_size;\n"
+"  const unsigned char *bytecode;    // stripped bytecode or NULL\n"
+"  unsigned int bytecode_size;\n"
+"};\n\n"
+"${ARRAYS}"
+"static const LDocEmbeddedModule ldoc_modules[] = {\n"
+"${ENTRIES}"
+"  {NULL, NULL, NULL, 0, NULL, 0}    // End of List\n"
+"};\n"
+  )
+else()
+  if(NOT VARIABLE)
+    set(VARIABLE "ldoc_source")
+  endif()
+
+  hex_array("${INPUT_FILE}" ${VARIABLE}_bytes "${BINARY}" ARRAY)
+
+  file(WRITE "${OUTPUT_FILE}"
 "#pragma once\n\n"
-"static const unsigned char ldoc_source_bytes[] = {\n${FORMATTED_HEX}\n0x00\n};\n\n"
-"static const unsigned int ldoc_source_size = sizeof(ldoc_source_bytes) - 1;\n"
-)
+"${ARRAY}\n"
+"static const unsigned int ${VARIABLE}_size = sizeof(${VARIABLE}_bytes) - 1;\n"
+  )
+endif()
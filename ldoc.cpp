@@ -8,12 +8,38 @@
  * 
  * Key Features:
  * - Portable Execution: Resolves the installation prefix dynamically relative
- *   to the EXE location.
+ *   to the location of the executable: GetModuleFileNameW on Windows,
+ *   /proc/self/exe on Linux and _NSGetExecutablePath on macOS.
  * - Environment Setup: Automatically configures Lua's 'package.path' and
  *   'package.cpath' using a custom C++/Lua bridge to find shared libraries and
  *   modules in the system-independent 'share' and 'lib' directories.
  * - Encoding Safety: Uses UTF-8 conversion for Windows WideChar paths to ensure 
  *   compatibility with the Lua interpreter.
+ * - Precompiled Bytecode (optional, LDOC_EMBED_BYTECODE): Additionally embeds
+ *   'ldoc.lua' as stripped bytecode, which skips compiling the script on every
+ *   run. The source blob is used whenever the bytecode does not fit the running
+ *   interpreter.
+ * - Embedded Modules (LDOC_EMBED_MODULES): The complete 'ldoc/' module tree is
+ *   packed into the executable as well and served to require() by an in-memory
+ *   package searcher. Set LDOC_PREFER_DISK to let modules on disk take precedence.
+ * - Native Modules: Performance critical and platform specific parts (the
+ *   lexer, the tag scanner, the worker states of --jobs, the parse cache,
+ *   --watch, the 'native' Markdown format, the --profile sampler, writing and
+ *   escaping the pages, walking directories, the --search index) are
+ *   implemented in C++ (see native/) and registered in 'package.preload'.
+ *   Set LDOC_NO_NATIVE to run the pure Lua versions instead.
+ * - Watch Mode: With --watch, ldoc.lua runs again in a fresh Lua state whenever
+ *   one of its inputs changes, also while a run is going on. Not in batch mode.
+ * - Batch Mode: 'ldoc --batch FILE' (or '-' for stdin) does one run per line of
+ *   FILE in the same process, e.g. for documenting many packages.
+ * - Compiled Chunks: Every chunk is compiled once per process; all later states
+ *   (workers of --jobs, the runs of --watch and --batch) load its bytecode.
+ * - Memory Statistics: All states allocate through a counting allocator, which
+ *   the 'ldoc_stats' module reads for --stats and which enforces --max_memory.
+ * - Static Build (optional, LDOC_STATIC): liblua is linked statically,
+ *   LuaFileSystem is compiled in and preloaded as 'lfs', and the Penlight
+ *   modules are embedded next to the 'ldoc/' tree. A run then loads no DLL of
+ *   its own, and the DLL search setup below is left out.
  *
  * -----------------------------------------------------------------------------
  * MIT License
@@ -40,13 +66,28 @@
  * -----------------------------------------------------------------------------
  */
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#else
+#include <limits.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+#endif
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
 #include <string>
+#include <system_error>
 #include <vector>
 
+#ifdef _WIN32
 #ifdef USE_PATHCCH
 // newer, but incompatible with Win7 due to missing api-ms-win-core-path-l1-1-0.dll
 #include <pathcch.h>
@@ -56,12 +97,54 @@
 #include <shlwapi.h>
 #define MAX_PATH_BUFFER 32768 // same as PATHCCH_MAX_CCH
 #endif
+#endif
 
 #include <lua.hpp>
+#include "ldoc_native.h"
 #include "ldoc_source.h"
+#ifdef LDOC_EMBED_BYTECODE
+#include "ldoc_bytecode.h"
+#endif
+#ifdef LDOC_EMBED_MODULES
+#include "ldoc_modules.h"
+#endif
 
+#ifdef _WIN32
 #define appName "ldoc.exe"
+#define DIRSEP "\\"
+#define CMOD_EXT ".dll"
+#else
+#define appName "ldoc"
+#define DIRSEP "/"
+#define CMOD_EXT ".so"
+#endif
+
+static int luaopen_ldoc_stats(lua_State *L);
+#ifdef LDOC_STATIC
+extern "C" int luaopen_lfs(lua_State *L);	// lfs.c, compiled in
+#endif
+
+// Native modules, made available to require() through package.preload
+static const luaL_Reg NATIVE_MODULES[] = {
+  {"ldoc_lexer", luaopen_ldoc_lexer},
+  {"ldoc_tags", luaopen_ldoc_tags},
+  {"ldoc_jobs", luaopen_ldoc_jobs},
+  {"ldoc_cache", luaopen_ldoc_cache},
+  {"ldoc_watch", luaopen_ldoc_watch},
+  {"ldoc_markdown", luaopen_ldoc_markdown},
+  {"ldoc_profile", luaopen_ldoc_profile},
+  {"ldoc_output", luaopen_ldoc_output},
+  {"ldoc_html", luaopen_ldoc_html},
+  {"ldoc_dir", luaopen_ldoc_dir},
+  {"ldoc_search", luaopen_ldoc_search},
+  {"ldoc_stats", luaopen_ldoc_stats},
+#ifdef LDOC_STATIC
+  {"lfs", luaopen_lfs},
+#endif
+  {NULL, NULL}			// End of List
+};
 
+#ifdef _WIN32
 static std::string WideCharToUTF8(LPCWSTR text) {
   if (!text) return std::string();
   int size_needed = WideCharToMultiByte(CP_UTF8, 0, text, -1, NULL, 0, NULL, NULL);
@@ -70,10 +153,11 @@ static std::string WideCharToUTF8(LPCWSTR text) {
   WideCharToMultiByte(CP_UTF8, 0, text, -1, buffer.data(), size_needed, NULL, NULL);
   return std::string(buffer.data());
 }
+#endif
 
 static const char *setPaths = R"(
-function setPaths(basePath, paths, cpaths)
-   local cleanBase = basePath:gsub("\\+$", "")
+function setPaths(basePath, paths, cpaths, sep)
+   local cleanBase = basePath:gsub("[/\\]+$", "")
    local function process(list)
       local result = {}
       local isRelative = false
@@ -81,11 +165,11 @@ function setPaths(basePath, paths, cpaths)
 	 if v == "<RELATIVE>" then
 	    isRelative = true
 	 else
-	    local entry = v:gsub("^\\+", ""):gsub("\\+$", "")
+	    local entry = v:gsub("^/+", ""):gsub("/+$", ""):gsub("/", sep)
 	    if isRelative then
 	       table.insert(result, entry)
 	    else
-	       table.insert(result, cleanBase .. "\\" .. entry)
+	       table.insert(result, cleanBase .. sep .. entry)
 	    end
 	 end
       end
@@ -96,28 +180,43 @@ function setPaths(basePath, paths, cpaths)
 end
 )";
 
+// Relative to the installation prefix, with '/' for the directory separator
+#define LUA_VERSION_DIR LUA_VERSION_MAJOR "." LUA_VERSION_MINOR
+
 static const char* LUA_PATHS[] = {
-  R"(bin\lua\?.lua)",
-  R"(bin\lua\?\init.lua)",
-  R"(bin\?.lua)",
-  R"(bin\?\init.lua)",
-  "share\\lua\\" LUA_VERSION_MAJOR "." LUA_VERSION_MINOR "\\?.lua",
-  "share\\lua\\" LUA_VERSION_MAJOR "." LUA_VERSION_MINOR "\\?\\init.lua",
+#ifdef _WIN32
+  "bin/lua/?.lua",
+  "bin/lua/?/init.lua",
+  "bin/?.lua",
+  "bin/?/init.lua",
+#endif
+  "share/lua/" LUA_VERSION_DIR "/?.lua",
+  "share/lua/" LUA_VERSION_DIR "/?/init.lua",
+#ifndef _WIN32
+  "lib/lua/" LUA_VERSION_DIR "/?.lua",
+  "lib/lua/" LUA_VERSION_DIR "/?/init.lua",
+#endif
   "<RELATIVE>",		// Sentinel, relative paths from here
-  R"(.\?.lua)",
-  R"(.\?\init.lua)",
+  "./?.lua",
+  "./?/init.lua",
   NULL			// End of List
 };
 
 static const char* LUA_CPATHS[] = {
-  R"(bin\?.dll)",
-  "lib\\lua\\" LUA_VERSION_MAJOR "." LUA_VERSION_MINOR "\\?.dll",
-  R"(bin\loadall.dll)",
+#ifdef _WIN32
+  "bin/?.dll",
+  "lib/lua/" LUA_VERSION_DIR "/?.dll",
+  "bin/loadall.dll",
+#else
+  "lib/lua/" LUA_VERSION_DIR "/?.so",
+  "lib/lua/" LUA_VERSION_DIR "/loadall.so",
+#endif
   "<RELATIVE>",		// Sentinel, relative paths from here
-  R"(.\?.dll)",
+  "./?" CMOD_EXT,
   NULL			// End of List
 };
 
+#if defined(_WIN32) && !defined(LDOC_STATIC)
 static void SetupDeterministicDllResolution(){
   /* DETERMINISTIC DLL RESOLUTION FOR ONELUAPRO:
    * To keep the '/bin' directory clean, we do not load 'lua.dll' from there.
@@ -153,46 +252,362 @@ static void SetupDeterministicDllResolution(){
     }
   }
 }
+#endif
 
-int main(int argc, char** argv) {
+static bool BytecodeMatchesInterpreter(lua_State *L, const unsigned char *bytes, size_t size) {
+  /* A binary chunk starts with LUA_SIGNATURE followed by the version byte
+   * (major * 16 + minor). Compare against the version of the interpreter that is
+   * actually running, which may differ from the headers we were compiled with.
+   * The remaining header fields (format, data check, type sizes) are validated by
+   * lua_load() itself. */
+  const size_t sigLen = sizeof(LUA_SIGNATURE) - 1;
+  if (!bytes || size <= sigLen || memcmp(bytes, LUA_SIGNATURE, sigLen) != 0) return false;
+#if LUA_VERSION_NUM >= 504
+  int version = (int)lua_version(L);
+#else
+  int version = (int)*lua_version(L);
+#endif
+  return bytes[sigLen] == (version / 100) * 16 + version % 100;
+}
 
-  // Modity DLL search path
-  SetupDeterministicDllResolution();
+/* -----------------------------------------------------------------------------
+ * Compiled chunks, shared by all states of the process
+ */
 
-  // Determine path, where appName is currently located
-  WCHAR installPrefix[MAX_PATH_BUFFER];
-  if (!GetModuleFileNameW(NULL, installPrefix, MAX_PATH_BUFFER)) {
-    fprintf(stderr, "%s: Could not find executable path.\n", appName);
-    return 1;
+struct CompiledChunk {
+  std::string bytecode;
+  std::string stamp;		// of the file it was compiled from, if any
+};
+
+static std::mutex compiledMutex;	// worker states load modules concurrently
+static std::map<std::string, CompiledChunk> compiledChunks;
+
+static int AppendToString(lua_State *L, const void *p, size_t size, void *out) {
+  (void)L;
+  ((std::string *)out)->append((const char *)p, size);
+  return 0;
+}
+
+static bool LoadCompiled(lua_State *L, const std::string &key, const std::string &stamp,
+			 const char *chunkname) {
+  // pushes the chunk compiled earlier for key, if it is still up to date
+  std::string bytecode;
+  {
+    std::lock_guard<std::mutex> lock(compiledMutex);
+    auto it = compiledChunks.find(key);
+    if (it == compiledChunks.end() || it->second.stamp != stamp) return false;
+    bytecode = it->second.bytecode;
+  }
+  if (luaL_loadbufferx(L, bytecode.data(), bytecode.size(), chunkname, "b") != LUA_OK) {
+    lua_pop(L, 1);
+    return false;
   }
+  return true;
+}
 
-  // Navigate two levels up from <INSTALL_PREFIX>/bin/ldoc.exe to <INSTALL_PREFIX>
-#ifdef USE_PATHCCH
-  PathCchRemoveFileSpec(installPrefix, PATHCCH_MAX_CCH);
-  PathCchRemoveFileSpec(installPrefix, PATHCCH_MAX_CCH);
+static void KeepCompiled(lua_State *L, const std::string &key, const std::string &stamp) {
+  // keeps the function on top of the stack for LoadCompiled; with debug info,
+  // so that messages and tracebacks stay the same
+  CompiledChunk chunk;
+  chunk.stamp = stamp;
+  if (lua_dump(L, AppendToString, &chunk.bytecode, 0) != 0) return;
+  std::lock_guard<std::mutex> lock(compiledMutex);
+  compiledChunks[key] = std::move(chunk);
+}
+
+static int LoadEmbeddedChunk(lua_State *L,
+			     const unsigned char *source, size_t sourceSize,
+			     const unsigned char *bytecode, size_t bytecodeSize,
+			     const char *chunkname) {
+  // Prefer the precompiled chunk (if any), but never fail because of it
+  if (BytecodeMatchesInterpreter(L, bytecode, bytecodeSize)) {
+    if (luaL_loadbufferx(L, (const char*)bytecode, bytecodeSize, chunkname, "b") == LUA_OK) {
+      return LUA_OK;
+    }
+    lua_pop(L, 1);		// discard error message, fall back to source
+  }
+  // Compiled by an earlier state? Embedded sources never change.
+  if (LoadCompiled(L, chunkname, std::string(), chunkname)) return LUA_OK;
+  // Use loadbuffer, because it works with byte-arrays ans sizes
+  int status = luaL_loadbufferx(L, (const char*)source, sourceSize, chunkname, "t");
+  if (status == LUA_OK) KeepCompiled(L, chunkname, std::string());
+  return status;
+}
+
+static std::string FileStamp(const std::filesystem::path &file) {
+  // modification time and size, which tell whether a module file has changed
+  std::error_code ec;
+  auto mtime = std::filesystem::last_write_time(file, ec);
+  if (ec) return std::string();
+  auto size = std::filesystem::file_size(file, ec);
+  if (ec) return std::string();
+  return std::to_string((long long)mtime.time_since_epoch().count()) + ":" +
+    std::to_string((unsigned long long)size);
+}
+
+static bool IsLDocModule(const char *name) {
+  // the modules whose sources make part of the parse cache key
+  return strncmp(name, "ldoc.", 5) == 0;
+}
+
+static int CompiledFileSearcher(lua_State *L) {
+  /* Replaces the Lua file searcher of package.searchers: the same search along
+   * package.path, but a module file that an earlier state of the process has
+   * compiled is loaded from its bytecode. */
+  const char *name = luaL_checkstring(L, 1);
+  lua_getglobal(L, "package");
+  lua_getfield(L, -1, "searchpath");
+  lua_pushstring(L, name);
+  lua_getfield(L, -3, "path");
+  if (!lua_isstring(L, -1)) return luaL_error(L, "'package.path' must be a string");
+  lua_call(L, 2, 2);
+  if (lua_isnil(L, -2)) return 1;	// the message of all the files tried
+  lua_pop(L, 1);
+  const char *filename = lua_tostring(L, -1);
+  std::error_code ec;
+  std::filesystem::path file = std::filesystem::absolute(filename, ec);
+  std::string key = ec ? std::string(filename) : file.string();
+  std::string stamp = FileStamp(file);
+  std::string chunkname = std::string("@") + filename;
+  if (stamp.empty() || !LoadCompiled(L, key, stamp, chunkname.c_str())) {
+    if (luaL_loadfilex(L, filename, NULL) != LUA_OK) {
+      return luaL_error(L, "error loading module '%s' from file '%s':\n\t%s",
+			name, filename, lua_tostring(L, -1));
+    }
+    if (!stamp.empty()) KeepCompiled(L, key, stamp);
+    if (IsLDocModule(name)) ldoc_cache_note_file(name, filename);
+  }
+  lua_pushstring(L, filename);
+  return 2;
+}
+
+static void InstallCompiledFileSearcher(lua_State *L) {
+  // the Lua file searcher is the second one, after package.preload
+  lua_getglobal(L, "package");
+  lua_getfield(L, -1, "searchers");
+  if (lua_rawlen(L, -1) >= 2) {
+    lua_pushcfunction(L, CompiledFileSearcher);
+    lua_rawseti(L, -2, 2);
+  }
+  lua_pop(L, 2);		// searchers, package
+}
+
+static int LoadLDocChunk(lua_State *L) {
+  ldoc_cache_note_source("ldoc", (const char *)ldoc_source_bytes, ldoc_source_size);
+#ifdef LDOC_EMBED_BYTECODE
+  return LoadEmbeddedChunk(L, ldoc_source_bytes, ldoc_source_size,
+			   ldoc_bytecode_bytes, ldoc_bytecode_size, "@ldoc.lua");
 #else
-  PathRemoveFileSpecW(installPrefix);
-  PathRemoveFileSpecW(installPrefix);
+  return LoadEmbeddedChunk(L, ldoc_source_bytes, ldoc_source_size, NULL, 0, "@ldoc.lua");
 #endif
-  std::string utf8Prefix = WideCharToUTF8(installPrefix);
+}
 
-  // Create new Lua state
-  lua_State *L = luaL_newstate();
-  if (!L) {
-    fprintf(stderr, "%s: Failed to create Lua state.\n", appName);
-    return 1;
+static void PreloadNativeModules(lua_State *L) {
+  /* The Lua modules try to require() their native counterparts and fall back
+   * to a pure Lua implementation when they are not available, i.e. when LDoc
+   * is not run by this launcher. With the environment variable LDOC_NO_NATIVE
+   * set, the 'ldoc_*' modules are left out, so that 'lua run-tests.lua native'
+   * can check that both give the same output. */
+  bool noNative = getenv("LDOC_NO_NATIVE") != NULL;
+  luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_PRELOAD_TABLE);
+  for (const luaL_Reg *m = NATIVE_MODULES; m->name != NULL; ++m) {
+    if (noNative && strncmp(m->name, "ldoc_", 5) == 0) continue;
+    lua_pushcfunction(L, m->func);
+    lua_setfield(L, -2, m->name);
+  }
+  lua_pop(L, 1);		// preload table
+}
+
+#ifdef LDOC_EMBED_MODULES
+// Message prefix of package searchers: Lua 5.4 inserts the "\n\t" separator itself
+#if LUA_VERSION_NUM >= 504
+#define SEARCHER_MSG_PREFIX ""
+#else
+#define SEARCHER_MSG_PREFIX "\n\t"
+#endif
+
+static int EmbeddedModuleSearcher(lua_State *L) {
+  /* package.searchers entry serving the 'ldoc.*' (and with LDOC_STATIC, the
+   * 'pl.*') modules packed by convert_lua_to_hex.cmake. Like the file searchers, it returns the loader
+   * (i.e. the compiled chunk) and the module's (pseudo) file name. */
+  const char *name = luaL_checkstring(L, 1);
+  for (const LDocEmbeddedModule *m = ldoc_modules; m->name != NULL; ++m) {
+    if (strcmp(m->name, name) == 0) {
+      std::string chunkname = std::string("@") + m->path;
+      if (LoadEmbeddedChunk(L, m->source, m->source_size, m->bytecode, m->bytecode_size,
+			    chunkname.c_str()) != LUA_OK) {
+	return luaL_error(L, "error loading embedded module '%s':\n\t%s",
+			  name, lua_tostring(L, -1));
+      }
+      if (IsLDocModule(name)) {
+	ldoc_cache_note_source(name, (const char *)m->source, m->source_size);
+      }
+      lua_pushstring(L, m->path);
+      return 2;
+    }
+  }
+  lua_pushfstring(L, SEARCHER_MSG_PREFIX "no embedded module '%s'", name);
+  return 1;
+}
+
+static void InstallEmbeddedModuleSearcher(lua_State *L) {
+  /* By default, the embedded modules are found right after package.preload and
+   * before any file system searcher. For developing LDoc itself, setting the
+   * environment variable LDOC_PREFER_DISK appends the searcher instead, so that
+   * modules on package.path take precedence over the embedded copies. */
+  bool preferDisk = getenv("LDOC_PREFER_DISK") != NULL;
+  lua_getglobal(L, "package");
+  lua_getfield(L, -1, "searchers");
+  lua_Integer n = (lua_Integer)lua_rawlen(L, -1);
+  lua_Integer pos = (preferDisk || n < 1) ? n + 1 : 2;
+  for (lua_Integer i = n; i >= pos; --i) {	// make room at pos
+    lua_rawgeti(L, -1, i);
+    lua_rawseti(L, -2, i + 1);
+  }
+  lua_pushcfunction(L, EmbeddedModuleSearcher);
+  lua_rawseti(L, -2, pos);
+  lua_pop(L, 2);		// searchers, package
+}
+#endif
+
+// Allocations of all Lua states of the process, i.e. also of the workers
+static std::atomic<size_t> memoryInUse(0);
+static std::atomic<size_t> memoryPeak(0);
+static std::atomic<size_t> memoryLimit(0);	// 0: none
+static std::atomic<bool> memoryRefused(false);	// an allocation failed at the limit
+static std::atomic<unsigned long long> allocationCount(0);
+static std::atomic<unsigned long long> bytesAllocated(0);
+
+static void RaisePeak(size_t used) {
+  size_t peak = memoryPeak.load(std::memory_order_relaxed);
+  while (used > peak && !memoryPeak.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {
   }
+}
+
+static void *CountingAlloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+  /* The allocator every state is created with by lua_newstate (see
+   * NewLDocState): realloc and free, like that of luaL_newstate, while
+   * counting what is in use. Only growing can fail, and it does once
+   * --max_memory is reached: Lua then collects garbage and tries again, and
+   * otherwise raises a memory error, which ends the run with a message instead
+   * of letting the machine swap. */
+  (void)ud;
+  if (!ptr) osize = 0;		// osize is the type of the new object then
+  if (nsize == 0) {
+    free(ptr);
+    memoryInUse.fetch_sub(osize, std::memory_order_relaxed);
+    return NULL;
+  }
+  size_t grow = nsize > osize ? nsize - osize : 0;
+  if (grow > 0) {
+    size_t used = memoryInUse.fetch_add(grow, std::memory_order_relaxed) + grow;
+    size_t limit = memoryLimit.load(std::memory_order_relaxed);
+    if (limit != 0 && used > limit) {
+      memoryInUse.fetch_sub(grow, std::memory_order_relaxed);
+      memoryRefused.store(true, std::memory_order_relaxed);
+      return NULL;
+    }
+  }
+  void *block = realloc(ptr, nsize);
+  if (!block) {
+    memoryInUse.fetch_sub(grow, std::memory_order_relaxed);
+    return NULL;
+  }
+  if (grow > 0) {
+    RaisePeak(memoryInUse.load(std::memory_order_relaxed));
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    bytesAllocated.fetch_add(grow, std::memory_order_relaxed);
+  }
+  else {
+    memoryInUse.fetch_sub(osize - nsize, std::memory_order_relaxed);
+  }
+  return block;
+}
+
+static int Panic(lua_State *L) {
+  // like the panic function of luaL_newstate
+  const char *msg = lua_type(L, -1) == LUA_TSTRING ? lua_tostring(L, -1) : "error object is not a string";
+  fprintf(stderr, "%s: PANIC: unprotected error in call to Lua API (%s)\n", appName, msg);
+  fflush(stderr);
+  return 0;
+}
+
+static void ResetMemoryStats() {
+  // every run of --watch and --batch reports and limits its own allocations
+  allocationCount = 0;
+  bytesAllocated = 0;
+  memoryPeak = memoryInUse.load();
+  memoryLimit = 0;
+  memoryRefused = false;
+}
+
+// ldoc_stats.memory() -> allocations, bytes allocated, bytes in use, peak bytes in use
+static int StatsMemory(lua_State *L) {
+  lua_pushinteger(L, (lua_Integer)allocationCount.load());
+  lua_pushinteger(L, (lua_Integer)bytesAllocated.load());
+  lua_pushinteger(L, (lua_Integer)memoryInUse.load());
+  lua_pushinteger(L, (lua_Integer)memoryPeak.load());
+  return 4;
+}
+
+// ldoc_stats.reset_peak() -> the peak so far, which starts again from the bytes in use
+static int StatsResetPeak(lua_State *L) {
+  lua_pushinteger(L, (lua_Integer)memoryPeak.exchange(memoryInUse.load()));
+  return 1;
+}
+
+// ldoc_stats.raise_peak(n): the peak is at least n bytes (an outer phase's peak)
+static int StatsRaisePeak(lua_State *L) {
+  lua_Integer n = luaL_checkinteger(L, 1);
+  if (n > 0) RaisePeak((size_t)n);
+  return 0;
+}
+
+// ldoc_stats.set_limit(n): allocations fail beyond n bytes in use (0: no limit)
+static int StatsSetLimit(lua_State *L) {
+  lua_Integer n = luaL_checkinteger(L, 1);
+  memoryLimit = n > 0 ? (size_t)n : 0;
+  return 0;
+}
+
+static int luaopen_ldoc_stats(lua_State *L) {
+  static const luaL_Reg functions[] = {
+    {"memory", StatsMemory},
+    {"reset_peak", StatsResetPeak},
+    {"raise_peak", StatsRaisePeak},
+    {"set_limit", StatsSetLimit},
+    {NULL, NULL}
+  };
+  luaL_newlib(L, functions);
+  return 1;
+}
+
+// Installation prefix, shared by all states
+static std::string utf8Prefix;
+
+static lua_State *NewLDocState(const std::vector<std::string> &args) {
+  /* Creates a Lua state that is ready to run ldoc.lua with the arguments of
+   * a run (args[0] is the launcher). Besides the main state, this is used for
+   * the worker states of 'ldoc --jobs N', which run on their own threads, so
+   * nothing in here may have any process-wide side effects. args must live as
+   * long as the state. */
+  lua_State *L = lua_newstate(CountingAlloc, NULL);
+  if (!L) return NULL;
+  lua_atpanic(L, Panic);
 
   // Open standard libs
   luaL_openlibs(L);
 
   // hand-over command-line args to lua by setting global table arg
   lua_newtable(L);
-  for (int i = 0; i < argc; i++) {
-    lua_pushstring(L, argv[i]);
-    lua_rawseti(L, -2, i);
+  for (size_t i = 0; i < args.size(); i++) {
+    lua_pushlstring(L, args[i].data(), args[i].size());
+    lua_rawseti(L, -2, (lua_Integer)i);
   }
   lua_setglobal(L, "arg");
+  // and to ldoc_jobs, for the workers of this run
+  lua_pushlightuserdata(L, (void *)&args);
+  lua_setfield(L, LUA_REGISTRYINDEX, LDOC_ARGS_KEY);
 
   // Globally register function setPaths()
   luaL_dostring(L, setPaths);
@@ -217,23 +632,292 @@ int main(int argc, char** argv) {
     lua_rawseti(L, -2, i + 1);
   }
 
+  // Push 4th arg (the directory separator of the platform)
+  lua_pushstring(L, DIRSEP);
+
   // Run function
-  if (lua_pcall(L, 3, 0, 0) != 0) {
+  if (lua_pcall(L, 4, 0, 0) != 0) {
     fprintf(stderr, "%s: Error setting paths: %s\n", appName, lua_tostring(L, -1));
   }
   // Lua state now fully initialized with all standard search paths
 
-  // Use loadbuffer, because it works with byte-arrays ans sizes
-  if (luaL_loadbuffer(L, (const char*)ldoc_source_bytes, ldoc_source_size, "@ldoc.lua") == LUA_OK) {
-    // Execute the chunk
-    if (lua_pcall(L, 0, LUA_MULTRET, 0) != LUA_OK) {
-      fprintf(stderr, "%s: Runtime error: %s\n", appName, lua_tostring(L, -1));
+  // Register the native modules
+  PreloadNativeModules(L);
+
+  // Compile module files only once per process
+  InstallCompiledFileSearcher(L);
+
+#ifdef LDOC_EMBED_MODULES
+  // Serve require('ldoc.*') from memory
+  InstallEmbeddedModuleSearcher(L);
+#endif
+  return L;
+}
+
+static lua_State *NewWorkerState(const std::vector<std::string> &args) {
+  // State factory of ldoc_jobs: a new state with the ldoc.lua chunk on top
+  lua_State *L = NewLDocState(args);
+  if (L && LoadLDocChunk(L) != LUA_OK) {
+    lua_close(L);
+    return NULL;
+  }
+  return L;
+}
+
+// In batch and watch mode, os.exit ends the run with this error object, not the process
+static bool batchMode = false;
+static char runExitTag;
+#define EXIT_STATUS_KEY "ldoc.exit_status"
+
+static void RunExitHook(lua_State *L, lua_Debug *ar) {
+  // raises the exit again wherever the run goes on, i.e. after a pcall caught it
+  (void)ar;
+  lua_pushlightuserdata(L, &runExitTag);
+  lua_error(L);
+}
+
+static int RunExit(lua_State *L) {
+  /* os.exit of a run. Outside of batch and watch mode it is the original one
+   * (upvalue 1); otherwise the run ends, but the launcher does not: no pcall of
+   * the run can catch this for long, since it is raised again on the next
+   * instruction of the main thread (and of the coroutine calling it). */
+  if (!batchMode && !ldoc_watch_pending()) {
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 1);
+    lua_call(L, lua_gettop(L) - 1, 0);
+    return 0;
+  }
+  int status;
+  if (lua_isboolean(L, 1)) status = lua_toboolean(L, 1) ? EXIT_SUCCESS : EXIT_FAILURE;
+  else status = (int)luaL_optinteger(L, 1, EXIT_SUCCESS);
+  lua_pushinteger(L, status);
+  lua_setfield(L, LUA_REGISTRYINDEX, EXIT_STATUS_KEY);
+  lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+  lua_sethook(lua_tothread(L, -1), RunExitHook, LUA_MASKCOUNT, 1);
+  lua_pop(L, 1);
+  lua_sethook(L, RunExitHook, LUA_MASKCOUNT, 1);
+  lua_pushlightuserdata(L, &runExitTag);
+  return lua_error(L);
+}
+
+static int RunLDoc(const std::vector<std::string> &args) {
+  // Runs ldoc.lua once; returns its exit status, or -1 if there is no Lua state
+
+  // Create new Lua state
+  ResetMemoryStats();
+  lua_State *L = NewLDocState(args);
+  if (!L) {
+    fprintf(stderr, "%s: Failed to create Lua state.\n", appName);
+    return -1;
+  }
+  ldoc_watch_begin(!batchMode);
+  lua_getglobal(L, "os");
+  lua_getfield(L, -1, "exit");
+  lua_pushcclosure(L, RunExit, 1);
+  lua_setfield(L, -2, "exit");
+  lua_pop(L, 1);
+
+  // Load the embedded script (bytecode or source)
+  int status = EXIT_SUCCESS;
+  if (LoadLDocChunk(L) == LUA_OK) {
+    // Execute the chunk; batch and watch mode end a run with an error object
+    int rc = lua_pcall(L, 0, LUA_MULTRET, 0);
+    lua_sethook(L, NULL, 0, 0);		// (see RunExit)
+    if (rc != LUA_OK) {
+      if (lua_touserdata(L, -1) == &runExitTag) {
+	lua_getfield(L, LUA_REGISTRYINDEX, EXIT_STATUS_KEY);
+	status = (int)lua_tointeger(L, -1);
+      }
+      else if (memoryLimit.load() != 0 && (rc == LUA_ERRMEM || memoryRefused.load())) {
+	/* also when rethrown as another error, e.g. the message of a --jobs
+	 * worker: the limit was hit in this run, any of its states */
+	fprintf(stderr, "%s: Out of memory: more than --max_memory %zu MB needed\n", appName,
+		memoryLimit.load() >> 20);
+	status = EXIT_FAILURE;
+      }
+      else if (lua_type(L, -1) == LUA_TSTRING) {
+	fprintf(stderr, "%s: Runtime error: %s\n", appName, lua_tostring(L, -1));
+	status = EXIT_FAILURE;
+      }
     }
   }
   else {
     fprintf(stderr, "%s: Syntax error in embedded code: %s\n", appName, lua_tostring(L, -1));
+    status = EXIT_FAILURE;
   }
 
   lua_close(L);
-  return 0;
+  return status;
+}
+
+static bool SplitCommandLine(const std::string &line, std::vector<std::string> *words) {
+  /* Words are separated by blanks and tabs. Double quotes keep blanks within
+   * a word and are removed, so 'a" b"c' is the word 'a bc' and '""' an empty
+   * word; there are no escapes, so no word can contain a double quote. There
+   * is no shell or CommandLineToArgvW() involved, so backslashes are just
+   * characters. False if the quotes are unbalanced. */
+  std::string word;
+  bool inWord = false, quoted = false;
+  for (char c : line) {
+    if (c == '"') {
+      quoted = !quoted;
+      inWord = true;
+    }
+    else if (!quoted && (c == ' ' || c == '\t')) {
+      if (inWord) words->push_back(word);
+      word.clear();
+      inWord = false;
+    }
+    else {
+      word.push_back(c);
+      inWord = true;
+    }
+  }
+  if (inWord) words->push_back(word);
+  return !quoted;
+}
+
+static int RunBatch(const char *arg0, const char *manifest) {
+  /* Batch mode: every line of the manifest holds the arguments of one run,
+   * split as by SplitCommandLine(); a line 'cd DIR' sets the
+   * directory for the runs that follow (relative to the one batch mode started
+   * in), and empty lines and lines starting with '#' are skipped. Every run gets
+   * a fresh state, but none of the chunks is compiled again. After each run,
+   * "ldoc.exe: done STATUS" (or "ldoc: ...") goes to stdout, so that a client can also hand
+   * out runs one at a time through a pipe. Returns the exit status of the
+   * launcher: 0 if all runs succeeded. */
+  bool fromStdin = strcmp(manifest, "-") == 0;
+  FILE *in = fromStdin ? stdin : fopen(manifest, "r");
+  if (!in) {
+    fprintf(stderr, "%s: cannot open batch file %s\n", appName, manifest);
+    return 1;
+  }
+  batchMode = true;
+  std::error_code ec;
+  std::filesystem::path startDir = std::filesystem::current_path(ec);
+  std::filesystem::path runDir = startDir;
+  int failed = 0;
+  char buffer[4096];
+  std::string line;
+  while (fgets(buffer, sizeof(buffer), in)) {
+    line += buffer;
+    if (line.back() != '\n' && !feof(in)) continue;	// a longer line
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+    // the arguments of this run, for the main state and its workers
+    std::vector<std::string> words{arg0};
+    bool balanced = SplitCommandLine(line, &words);
+    if (words.size() == 1 || words[1][0] == '#') {
+      line.clear();
+      continue;
+    }
+    int status;
+    if (!balanced) {
+      fprintf(stderr, "%s: unbalanced quotes in %s\n", appName, line.c_str());
+      status = EXIT_FAILURE;
+    }
+    else if (words[1] == "cd" && words.size() == 3) {
+      runDir = startDir / words[2];
+      status = std::filesystem::is_directory(runDir, ec) ? EXIT_SUCCESS : EXIT_FAILURE;
+      if (status != EXIT_SUCCESS) {
+	fprintf(stderr, "%s: no directory %s\n", appName, runDir.string().c_str());
+      }
+    }
+    else {
+      std::filesystem::current_path(runDir, ec);
+      status = RunLDoc(words);
+      if (status < 0) status = EXIT_FAILURE;
+    }
+    line.clear();
+    if (status != EXIT_SUCCESS) ++failed;
+    fflush(stderr);
+    printf("%s: done %d\n", appName, status);
+    fflush(stdout);
+  }
+  if (!fromStdin) fclose(in);
+  std::filesystem::current_path(startDir, ec);
+  return failed > 0 ? 1 : 0;
+}
+
+#ifndef _WIN32
+static std::string ExecutablePath(const char *argv0) {
+  // the file of the running executable, with links resolved; "" if unknown
+  char resolved[PATH_MAX];
+#ifdef __APPLE__
+  uint32_t size = 0;
+  _NSGetExecutablePath(NULL, &size);		// gives the size needed
+  std::vector<char> buffer(size + 1);
+  if (_NSGetExecutablePath(buffer.data(), &size) == 0 && realpath(buffer.data(), resolved)) {
+    return resolved;
+  }
+#else
+  if (realpath("/proc/self/exe", resolved)) return resolved;
+#endif
+  // e.g. no /proc: as it was started, if that is a path
+  if (argv0 && strchr(argv0, '/') && realpath(argv0, resolved)) return resolved;
+  return std::string();
+}
+#endif
+
+int main(int argc, char** argv) {
+
+#ifdef _WIN32
+#ifndef LDOC_STATIC
+  // Modity DLL search path
+  SetupDeterministicDllResolution();
+#endif
+
+  // Determine path, where appName is currently located
+  WCHAR installPrefix[MAX_PATH_BUFFER];
+  if (!GetModuleFileNameW(NULL, installPrefix, MAX_PATH_BUFFER)) {
+    fprintf(stderr, "%s: Could not find executable path.\n", appName);
+    return 1;
+  }
+
+  // Navigate two levels up from <INSTALL_PREFIX>/bin/ldoc.exe to <INSTALL_PREFIX>
+#ifdef USE_PATHCCH
+  PathCchRemoveFileSpec(installPrefix, PATHCCH_MAX_CCH);
+  PathCchRemoveFileSpec(installPrefix, PATHCCH_MAX_CCH);
+#else
+  PathRemoveFileSpecW(installPrefix);
+  PathRemoveFileSpecW(installPrefix);
+#endif
+  utf8Prefix = WideCharToUTF8(installPrefix);
+#else
+  std::string exePath = ExecutablePath(argc > 0 ? argv[0] : NULL);
+  if (exePath.empty()) {
+    fprintf(stderr, "%s: Could not find executable path.\n", appName);
+    return 1;
+  }
+
+  // Likewise from <INSTALL_PREFIX>/bin/ldoc; file names are UTF-8 already
+  utf8Prefix = std::filesystem::path(exePath).parent_path().parent_path().string();
+#endif
+  std::vector<std::string> args(argv, argv + argc);
+
+  // Worker states for parallel parsing and rendering are set up the same way
+  ldoc_jobs_set_state_factory(NewWorkerState);
+
+  // ldoc --batch FILE: many runs in one process (--watch is refused there)
+  if (argc >= 2 && strcmp(argv[1], "--batch") == 0) {
+    return RunBatch(argv[0], argc >= 3 ? argv[2] : "-");
+  }
+
+  /* In watch mode (--watch), ldoc.lua runs again in a fresh state whenever its
+   * inputs change; every run starts in the directory the first one did. */
+  std::error_code ec;
+  std::filesystem::path startDir = std::filesystem::current_path(ec);
+  int status;
+  for (;;) {
+    status = RunLDoc(args);
+    if (status < 0) return 1;
+    if (!ldoc_watch_requested()) break;
+    printf("%s: waiting for changes (Ctrl+C to stop)\n", appName);
+    fflush(stdout);
+    if (!ldoc_watch_wait()) {
+      fprintf(stderr, "%s: nothing to watch.\n", appName);
+      return 1;
+    }
+    std::filesystem::current_path(startDir, ec);
+  }
+  return status;			// of the last run
 }
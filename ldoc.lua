@@ -19,7 +19,6 @@
 local class = require 'pl.class'
 local app = require 'pl.app'
 local path = require 'pl.path'
-local dir = require 'pl.dir'
 local utils = require 'pl.utils'
 local List = require 'pl.List'
 local stringx = require 'pl.stringx'
@@ -33,6 +32,7 @@ local version = '1.5.0'
 
 -- so we can find our private modules
 app.require_here()
+local jobs = require 'ldoc.jobs'
 
 --- @usage
 local usage = [[
@@ -53,7 +53,7 @@ ldoc, a documentation generator for Lua, v]]..version..[[
     -l,--template	(default !) directory for template (ldoc.ltp)
     -p,--project	(default ldoc) project name
     -t,--title		(default Reference) page title
-    -f,--format		(default plain) formatting - can be markdown, discount or plain
+    -f,--format		(default plain) formatting - can be markdown, native, discount or plain
     -b,--package	(default .) top-level package basename (needed for module(...))
     -x,--ext		(default html) output file extension
     -c,--config		(default config.ld) configuration name
@@ -69,6 +69,17 @@ ldoc, a documentation generator for Lua, v]]..version..[[
     -S,--simple		no return or params, no summary
     -O,--one		one-column output layout
     -V,--version	show version information
+    -j,--jobs		(default 1) number of files to parse or pages to render in parallel
+    --cache		(default none) directory for caching parsed files, e.g. .ldoc-cache
+    --incremental	only write pages whose sources or references have changed
+    --stream		write the index page while rendering it, e.g. for huge single-page output
+    --emit_index	(default none) also write a binary index of the API to this file (see native/ldoc_index.h)
+    --search		also write a search index and add a search box to the pages
+    -w,--watch		run again whenever the sources, config or templates change (implies --incremental and a --cache)
+    --profile		report where the time of the run goes
+    --profile_stacks	(default none) with --profile, write the sampled stacks to this file (for flamegraph tools)
+    --stats		(default none) report memory use and counts: 'table' or 'json' on stderr, or a .json file
+    --max_memory	(default 0) fail once the Lua states use more than this many MB (0: no limit)
     --date		(default system) use this date in generated doc, set to empty string to skip the timestamp
     --dump		debug output dump
     --filter		(default none) filter output as Lua data (e.g pl.pretty.dump)
@@ -90,9 +101,13 @@ local lfs = require 'lfs'
 local doc = require 'ldoc.doc'
 local lang = require 'ldoc.lang'
 local tools = require 'ldoc.tools'
-local global = require 'ldoc.builtin.globals'
 local markup = require 'ldoc.markup'
 local parse = require 'ldoc.parse'
+local cache = require 'ldoc.cache'
+local watch = require 'ldoc.watch'
+local profile = require 'ldoc.profile'
+local index = require 'ldoc.index'
+local stats = require 'ldoc.stats'
 local KindMap = tools.KindMap
 local Item,File = doc.Item,doc.File
 local quit = utils.quit
@@ -102,6 +117,35 @@ if args.version then
    os.exit(0)
 end
 
+if args.watch and not jobs.worker then
+   local ok, err = watch.start()
+   if ok then
+      watch.add(jobs.start_path(args.config))
+      if args.file and args.file ~= '.' then watch.add(args.file) end
+   elseif err then
+      quit(err)
+   end
+end
+
+if args.max_memory > 0 and not jobs.worker then
+   local ok, err = stats.limit(args.max_memory)
+   if not ok then io.stderr:write('ldoc: ', err, '\n') end
+end
+
+if args.stats ~= 'none' and not jobs.worker then
+   stats.start(args.stats:match '%.json$' and jobs.start_path(args.stats) or args.stats)
+end
+
+if args.profile and not jobs.worker then
+   profile.start(args.profile_stacks ~= 'none' and jobs.start_path(args.profile_stacks) or nil)
+end
+
+-- the phases, timed for --profile and with their allocations for --stats
+if (args.profile or stats.active()) and not jobs.worker then
+   File.finish = profile.wrap('File:finish', File.finish)
+   doc.Module.resolve_references = profile.wrap('resolve_references', doc.Module.resolve_references)
+end
+
 local isdir_old = path.isdir
 path.isdir = function(p)
 	p = tools.trim_path_slashes(p)
@@ -243,7 +287,7 @@ function ldoc.new_type (tag, header, project_level,subfield)
 end
 
 function ldoc.manual_url (url)
-   global.set_manual_url(url)
+   require('ldoc.builtin.globals').set_manual_url(url)
 end
 
 function ldoc.custom_see_handler(pat, handler)
@@ -262,7 +306,7 @@ local ldoc_contents = {
    'dont_escape_underscore','global_lookup','prettify_files','convert_opt', 'user_keywords',
    'postprocess_html',
    'custom_css','version',
-   'no_args_infer', 'multimodule', 'import'
+   'no_args_infer', 'multimodule', 'import', 'cache', 'incremental', 'search'
 }
 
 if args.unsafe_no_sandbox then
@@ -303,6 +347,12 @@ local function loadstr (ldoc,txt)
    return chunk, err
 end
 
+-- the contents of all configuration files read, for the parse cache
+local config_texts = {}
+-- and by full path, for the workers (see ldoc.jobs)
+local config_by_path = jobs.known 'configs' or {}
+jobs.tell('configs', config_by_path)
+
 -- any file called 'config.ld' found in the source tree will be
 -- handled specially. It will be loaded using 'ldoc' as the environment.
 local function read_ldoc_config (fname)
@@ -314,8 +364,15 @@ local function read_ldoc_config (fname)
    if args.filter == 'none' then
       print('reading configuration from '..fname)
    end
-   local txt,not_found = utils.readfile(fname)
+   local fullpath = tools.abspath(fname)
+   local txt,not_found = config_by_path[fullpath], nil
+   if not txt then
+      txt,not_found = utils.readfile(fname)
+   end
+   watch.add(fname)
    if txt then
+      config_texts[#config_texts+1] = txt
+      config_by_path[fullpath] = txt
       chunk, err = loadstr(ldoc,txt)
       if chunk then
          if args.define ~= 'none' then ldoc[args.define] = true end
@@ -330,6 +387,7 @@ local function read_ldoc_config (fname)
    end
    return directory, not_found
 end
+read_ldoc_config = profile.wrap('config', read_ldoc_config)
 
 local quote = tools.quote
 --- processing command line and preparing for output ---
@@ -345,7 +403,7 @@ local doc_path = ldoc_dir..'/ldoc/builtin/?.lua'
 -- ldoc -m is expecting a Lua package; this converts this to a file path
 if args.module then
    -- first check if we've been given a global Lua lib function
-   if args.file:match '^%a+$' and global.functions[args.file] then
+   if args.file:match '^%a+$' and require('ldoc.builtin.globals').functions[args.file] then
       args.file = 'global.'..args.file
    end
    local fullpath,mod,_ = tools.lookup_existing_module_or_function (args.file, doc_path)
@@ -367,10 +425,11 @@ end
 -- a special case: 'ldoc .' can get all its parameters from config.ld
 if args.file == '.' then
    local err
-   config_dir,err = read_ldoc_config(args.config)
+   config_dir,err = read_ldoc_config(jobs.start_path(args.config))
    if err then quit("no "..quote(args.config).." found") end
    local config_path = path.dirname(args.config)
-   if config_path ~= '' then
+   -- (workers already run in the directory the main state changed to)
+   if config_path ~= '' and not jobs.worker then
       print('changing to directory',config_path)
       lfs.chdir(config_path)
    end
@@ -404,6 +463,7 @@ local source_dir = args.file
 if ldoc.file then
 	args.file = ldoc.file
 end
+watch.add(args.file)
 
 if type(ldoc.custom_tags) == 'table' then -- custom tags
   for i, custom in ipairs(ldoc.custom_tags) do
@@ -461,13 +521,29 @@ end
 
 if ldoc.ignore then args.ignore = true end
 
+-- a worker rendering pages starts from the files as the main state scanned them
+local function scan_file (f, ftype)
+   if jobs.rendering then
+      local F, line = jobs.scanned_file(f)
+      if F then
+         parse.restore_file(F,ftype,args,line)
+         return F, nil, line
+      end
+   end
+   return cache.scan_file(f,ftype,args)
+end
+
 local function process_file (f, flist)
    local ext = path.extension(f)
    local ftype = file_types[ext]
    if ftype then
       if args.verbose then print(f) end
       ftype.extra = ldoc.parse_extra or {}
-      local F,err = parse.file(f,ftype,args)
+      local F,err,line = scan_file(f,ftype)
+      if F and not err then
+         jobs.scanned(f,F,line)
+         err = parse.finish_file(F)
+      end
       if err then
          if F then
             F:warning("internal LDoc error")
@@ -478,7 +554,37 @@ local function process_file (f, flist)
    end
 end
 
-local process_file_list = tools.process_file_list
+-- the first half of process_file, run on a worker state (see ldoc.jobs)
+local function parse_job (f)
+   local ftype = file_types[path.extension(f)]
+   ftype.extra = ldoc.parse_extra or {}
+   return cache.scan_file(f,ftype,args)
+end
+
+-- the second half, for the result of parse_job
+local function finish_parsed_file (f, res, flist)
+   local ftype = file_types[path.extension(f)]
+   if ftype then
+      if args.verbose then print(f) end
+      jobs.replay(res)
+      if res.err then
+         jobs.stop()
+         quit(res.err)
+      end
+      local F = res.file
+      if F then
+         parse.restore_file(F,ftype,args,res.line)
+         jobs.scanned(f,F,res.line)
+         local err = parse.finish_file(F)
+         if err then
+            F:warning("internal LDoc error")
+            jobs.stop()
+            quit(err)
+         end
+      end
+      flist:append(F)
+   end
+end
 
 setup_package_base()
 
@@ -490,9 +596,23 @@ override 'module_file'
 override 'boilerplate'
 override 'all'
 override 'multimodule'
+override ('cache','none')
+
+-- every run of --watch after the first only parses the files that changed
+if args.watch and args.cache == 'none' and watch.available() then
+   args.cache = '.ldoc-cache'
+end
 
 setup_kinds()
 
+if args.cache ~= 'none' then
+   local ok, err = cache.setup(args.cache, version, args, config_texts)
+   if ok == nil then quit("cannot create cache directory: "..err) end
+end
+
+-- with --jobs, the module pages are rendered in parallel as well (see ldoc.jobs)
+if args.jobs > 1 then jobs.keep_scanned() end
+
 -- LDoc is doing plain ole C, don't want random Lua references!
 if ldoc.parse_extra and ldoc.parse_extra.C then
    ldoc.no_lua_ref = true
@@ -519,14 +639,37 @@ end
 
 -- process files, optionally in order that respects master module files
 local function process_all_files(files)
-   local sortfn = reorder_module_file()
-   local files = tools.expand_file_list(files,'*.*')
-   if sortfn then files:sort(sortfn) end
-   for f in files:iter() do
-      process_file(f, file_list)
+   -- workers reading examples and topics need no source files
+   if jobs.preparing then return end
+   -- workers get the list the main state made
+   local list = jobs.known 'files'
+   if not list then
+      local sortfn = reorder_module_file()
+      list = tools.expand_file_list(files,'*.*')
+      if sortfn then list:sort(sortfn) end
+      jobs.tell('files', list)
+   end
+   files = list
+   if jobs.parsing then
+      jobs.serve(parse_job)
+   elseif args.jobs > 1 and jobs.available() then
+      -- only source files are worth handing out
+      local sources = files:filter(function(f)
+         return file_types[path.extension(f)] ~= nil
+      end)
+      jobs.process(sources, args.jobs, function(f)
+         process_file(f, file_list)
+      end, function(f,res)
+         finish_parsed_file(f, res, file_list)
+      end)
+   else
+      for f in files:iter() do
+         process_file(f, file_list)
+      end
    end
    if #file_list == 0 then quit "no source files found" end
 end
+process_all_files = profile.wrap('process_all_files', process_all_files)
 
 if type(args.file) == 'table' then
    -- this can only be set from config file so we can assume config is already read
@@ -535,10 +678,10 @@ if type(args.file) == 'table' then
 elseif path.isdir(args.file) then
    -- use any configuration file we find, if not already specified
    if not config_dir then
-      local files = List(dir.getallfiles(args.file,'*.*'))
-      local config_files = files:filter(function(f)
-         return path.basename(f) == args.config
-      end)
+      -- (natively, this walk also gives the files to process below)
+      local config_files = jobs.known 'config_files'
+         or tools.find_files(args.file,'*.*',args.config)
+      jobs.tell('config_files', config_files)
       if #config_files > 0 then
          config_dir = read_ldoc_config(config_files[1])
          if #config_files > 1 then
@@ -559,8 +702,10 @@ elseif path.isfile(args.file) then
          read_ldoc_config(config)
       end
    end
-   process_file(args.file, file_list)
-   if #file_list == 0 then quit "unsupported file extension" end
+   if not jobs.preparing then
+      process_file(args.file, file_list)
+      if #file_list == 0 then quit "unsupported file extension" end
+   end
 else
    quit ("file or directory does not exist: "..quote(args.file))
 end
@@ -570,7 +715,7 @@ end
 -- (this also will initialize the code prettifier used)
 override ('format','plain')
 override 'pretty'
-ldoc.markup = markup.create(ldoc, args.format, args.pretty, ldoc.user_keywords)
+ldoc.markup = profile.wrap('markup', markup.create(ldoc, args.format, args.pretty, ldoc.user_keywords))
 
 ------ 'Special' Project-level entities ---------------------------------------
 -- Examples and Topics do not contain code to be processed for doc comments.
@@ -580,10 +725,10 @@ ldoc.markup = markup.create(ldoc, args.format, args.pretty, ldoc.user_keywords)
 -- They define an item 'body' field (containing the file's text) and a 'postprocess'
 -- field which is used later to convert them into HTML. They may contain @{ref}s.
 
-local function add_special_project_entity (f,tags,process)
+local function add_special_project_entity (f,tags,process,text)
    local F = File(f)
    tags.name = path.basename(f)
-   local text = utils.readfile(f)
+   text = text or utils.readfile(f)
    local item = F:new_item(tags,1)
    if process then
       text = process(F, text)
@@ -594,39 +739,31 @@ local function add_special_project_entity (f,tags,process)
    return item, F
 end
 
-local function prettify_source_files(files,class,linemap)
-   local prettify = require 'ldoc.prettify'
+-- the entities in the order they are added, as {class, file}
+local special_files = List()
 
-   process_file_list (files, '*.*', function(f)
-      local ext = path.extension(f)
-      local ftype = file_types[ext]
-      if ftype then
-         local item = add_special_project_entity(f,{
-            class = class,
-         })
-         -- wrap prettify for this example so it knows which file to blame
-         -- if there's a problem
-         local lang = ext:sub(2)
-         item.postprocess = function(code)
-            return '<h2>'..path.basename(f)..'</h2>\n' ..
-                prettify.lua(lang,f,code,0,true,linemap and linemap[f])
-         end
+local function add_source_files (files,class)
+   for f in tools.expand_file_list(files, '*.*'):iter() do
+      if file_types[path.extension(f)] then
+         special_files:append {class, f}
       end
-   end)
+   end
 end
 
 if type(ldoc.examples) == 'string' then
    ldoc.examples = {ldoc.examples}
 end
 if type(ldoc.examples) == 'table' then
-   prettify_source_files(ldoc.examples,"example")
+   add_source_files(ldoc.examples,"example")
 end
 
 ldoc.is_file_prettified = {}
 
+-- the lines of the items of each prettified source file
+local linemap = {}
+
 if ldoc.prettify_files then
    local files = List()
-   local linemap = {}
    for F in file_list:iter() do
       files:append(F.filename)
       local mod = F.modules[1]
@@ -638,6 +775,11 @@ if ldoc.prettify_files then
         linemap[F.filename] = ls
       end
    end
+   -- the examples count as files here too
+   for s in special_files:iter() do
+      files:append(s[2])
+      linemap[s[2]] = List()
+   end
 
    if type(ldoc.prettify_files) == 'table' then
       files = tools.expand_file_list(ldoc.prettify_files, '*.*')
@@ -655,7 +797,7 @@ if ldoc.prettify_files then
    end
 
    ldoc.is_file_prettified = tablex.makeset(files)
-   prettify_source_files(files,"file",linemap)
+   add_source_files(files,"file")
 end
 
 if args.simple then
@@ -668,10 +810,55 @@ if type(ldoc.readme) == 'string' then
    ldoc.readme = {ldoc.readme}
 end
 if type(ldoc.readme) == 'table' then
-   process_file_list(ldoc.readme, '*.md', function(f)
+   for f in tools.expand_file_list(ldoc.readme, '*.md'):iter() do
+      special_files:append {'topic', f}
+   end
+end
+
+-- what a worker prepares of an example or topic (see ldoc.jobs): the text,
+-- and the sections and HTML of a topic or the prettified code of an example,
+-- whose @{refs} are resolved later by markup.resolve_deferred and
+-- prettify.resolve_deferred
+local function prepare_job (name)
+   local class, f = name:match '^(%a+):(.*)$'
+   local text = utils.readfile(f)
+   if class == 'topic' then
+      local titles, header = markup.section_titles(text)
+      local res = {body = text, titles = titles, header = header}
+      if markup.can_defer(text) then
+         local F = File(f)
+         markup.add_sections(F, text, titles, header)
+         markup.defer_references()
+         local ok, html = pcall(ldoc.markup, text, F)
+         local refs = markup.deferred_references()
+         if not ok then error(html, 0) end
+         res.html, res.refs = html, refs
+      end
+      return res
+   end
+   if text:find '[\1\2]' then return {body = text} end
+   local prettify = require 'ldoc.prettify'
+   local lines = class == 'file' and jobs.context.linemap[f] or nil
+   prettify.defer_references()
+   local ok, code = pcall(prettify.lua, path.extension(f):sub(2), f, text, 0, true, lines)
+   local refs = prettify.deferred_references()
+   if not ok then error(code, 0) end
+   return {body = text, code = code, refs = refs}
+end
+
+if jobs.preparing then
+   jobs.serve_special(prepare_job)
+end
+
+-- `prepared` is what a worker prepared of the entity, if anything
+local function add_special (class, f, prepared)
+   prepared = prepared or {}
+   if class == 'topic' then
       local item, F = add_special_project_entity(f,{
          class = 'topic'
-      }, markup.add_sections)
+      }, function(F, text)
+         return markup.add_sections(F, text, prepared.titles, prepared.header)
+      end, prepared.body)
       -- add_sections above has created sections corresponding to the 2nd level
       -- headers in the readme, which are attached to the File. So
       -- we pass the File to the postprocesser, which will insert the section markers
@@ -679,9 +866,58 @@ if type(ldoc.readme) == 'table' then
       if ldoc.use_markdown_titles then
          item.display_name = F.display_name
       end
-      item.postprocess = function(txt) return ldoc.markup(txt,F) end
-   end)
+      item.postprocess = function(txt)
+         if prepared.html then
+            local html = markup.resolve_deferred(prepared.html, prepared.refs)
+            if html then return html end
+         end
+         return ldoc.markup(txt,F)
+      end
+   else
+      local prettify = require 'ldoc.prettify'
+      local item = add_special_project_entity(f,{
+         class = class,
+      }, nil, prepared.body)
+      -- wrap prettify for this example so it knows which file to blame
+      -- if there's a problem
+      local lang = path.extension(f):sub(2)
+      local lines = class == 'file' and linemap[f] or nil
+      item.postprocess = function(code)
+         if type(prepared.code) == 'string' then
+            code = prettify.resolve_deferred(prepared.code, prepared.refs)
+         else
+            code = prettify.lua(lang,f,code,0,true,lines)
+         end
+         return '<h2>'..path.basename(f)..'</h2>\n' .. code
+      end
+   end
+end
+
+-- with --jobs, workers read the files and prettify the examples (see ldoc.jobs)
+local function add_special_files ()
+   local names = special_files:map(function(s) return s[1]..':'..s[2] end)
+   local prepared
+   if args.jobs > 1 and jobs.available() then
+      prepared = jobs.prepare(names, args.jobs, linemap)
+   end
+   for i, s in ipairs(special_files) do
+      local res
+      if prepared then
+         res = prepared(i)
+         if res then
+            jobs.replay(res)
+            res = res.special
+         end
+      else
+         res = jobs.prepared(names[i])
+      end
+      add_special(s[1], s[2], res)
+   end
+   jobs.stop()
 end
+add_special_files = profile.wrap('special_files', add_special_files)
+
+add_special_files()
 
 -- extract modules from the file objects, resolve references and sort appropriately ---
 
@@ -701,6 +937,9 @@ for F in file_list:iter() do
    end
 end
 
+-- all files are finished, so references can be looked up by index
+doc.index_symbols(module_list)
+
 for mod in module_list:iter() do
    if not args.module then -- no point if we're just showing docs on the console
       mod:resolve_references(module_list)
@@ -708,11 +947,28 @@ for mod in module_list:iter() do
    project:add(mod,module_list)
 end
 
+if stats.active() then
+   local files = {}
+   for mod in module_list:iter() do
+      if mod.file and not files[mod.file] then
+         files[mod.file] = true
+         stats.count('files')
+      end
+      stats.count('modules')
+      stats.count('items', #mod.items)
+      stats.count('references', mod.see and #mod.see or 0)
+      for item in mod.items:iter() do
+         if item.see then stats.count('references', #item.see) end
+      end
+   end
+end
+
 
 if ldoc.sort_modules then
    table.sort(module_list,function(m1,m2)
       return m1.name < m2.name
    end)
+   doc.index_symbols(module_list) -- global lookups go by module order
 end
 
 ldoc.single = modcount == 1 and first_module or nil
@@ -764,6 +1020,13 @@ if args.filter ~= 'none' then
    os.exit()
 end
 
+-- ldoc --emit_index FILE writes the modules, items and resolved references for
+-- other tools (see ldoc.index), besides generating the documentation
+if args.emit_index ~= 'none' and not jobs.worker then
+   local ok, err = index.write(module_list, jobs.start_path(args.emit_index))
+   if not ok then quit(err) end
+end
+
 -- can specify format, output, dir and ext in config.ld
 override ('output','index')
 override ('dir','doc')
@@ -832,40 +1095,40 @@ end
 
 local builtin_style, builtin_template = match_bang(args.style),match_bang(args.template)
 if builtin_style or builtin_template then
-   -- '!' here means 'use built-in templates'
-   local user = path.expanduser('~'):gsub('[/\\: ]','_')
-   local tmpdir = path.join(path.is_windows and os.getenv('TMP') or (os.getenv('TMPDIR') or '/tmp'),'ldoc'..user)
-   if not path.isdir(tmpdir) then
-      lfs.mkdir(tmpdir)
-   end
-   local function tmpwrite (name)
+   -- '!' here means 'use built-in templates'. They are the ldoc.html modules,
+   -- which html.generate_output reads directly; args.style and args.template
+   -- keep the '!' to tell it so.
+   local function check_builtin (name)
       local ok,text = pcall(require,'ldoc.html.'..name:gsub('%.','_'))
       if not ok then
          quit("cannot find builtin template "..name.." ("..text..")")
       end
-      if not utils.writefile(path.join(tmpdir,name),text) then
-         quit("cannot write to temp directory "..tmpdir)
-      end
    end
    if builtin_style then
       if builtin_style ~= '' then
          ldoc.css = 'ldoc_'..builtin_style..'.css'
       end
-      tmpwrite(ldoc.css)
-      args.style = tmpdir
+      check_builtin(ldoc.css)
    end
    if builtin_template then
       if builtin_template ~= '' then
          ldoc.templ = 'ldoc_'..builtin_template..'.ltp'
       end
-      tmpwrite(ldoc.templ)
-      args.template = tmpdir
+      check_builtin(ldoc.templ)
    end
 end
 
 -- default icon to nil
 if args.icon == 'none' then args.icon = nil end
 
+-- (the builtin ones cannot change)
+if not builtin_style then watch.add(args.style) end
+if not builtin_template then watch.add(args.template) end
+watch.add(ldoc.examples)
+watch.add(ldoc.readme)
+watch.ignore(args.dir)
+if args.cache ~= 'none' then watch.ignore(args.cache) end
+
 ldoc.log = print
 ldoc.kinds = project
 ldoc.modules = module_list
@@ -892,16 +1155,27 @@ elseif source_date_epoch == nil then
 else
   ldoc.updatetime = os.date("!%Y-%m-%d %H:%M:%S",source_date_epoch)
 end
+if jobs.rendering then
+   ldoc.updatetime = jobs.context.updatetime
+end
 
 local html = require 'ldoc.html'
 
-html.generate_output(ldoc, args, project)
+override 'incremental'
+override 'search'
+-- and only writes the pages affected
+if args.watch and watch.available() then args.incremental = true end
+
+html.generate_output(ldoc, args, project, version..'\0'..table.concat(config_texts,'\0'))
 
 if args.verbose then
    print 'modules'
    for k in pairs(module_list.by_name) do print(k) end
 end
 
+profile.report()
+stats.report()
+
 if args.fatalwarnings and Item.had_warning then
    os.exit(1)
 end
@@ -117,6 +117,24 @@ local file_methods = {
 local xlibs = {
    lfs='lfs.html', lpeg='lpeg.html',
 }
+
+-- the functions of their stubs ldoc/builtin/lfs.lua and lpeg.lua; a reference
+-- is checked against these, so that the stubs are only loaded for `ldoc -m`
+local xlib_functions = {
+   lfs = 'attributes chdir currentdir dir lock lock_dir mkdir rmdir setmode symlinkattributes touch unlock',
+   lpeg = 'match type version setmaxstack P R S V locale C Carg Cb Cc Cf Cg Cp Cs Ct Cmt',
+}
+
+local function xlib_function (tbl, name)
+   local names = xlib_functions[tbl]
+   if type(names) == 'string' then
+      local set = {}
+      for n in names:gmatch '%S+' do set[n] = true end
+      names = set
+      xlib_functions[tbl] = set
+   end
+   return names[name]
+end
 local xlib_url = 'http://stevedonovan.github.io/lua-stdlibs/'
 
 local tables = globals.tables
@@ -144,8 +162,7 @@ local function function_ref (name,tbl)
       name = tbl..'.'..name
       href = fun_ref..name
    elseif xlibs[tbl] then -- in external libs, use LDoc style
-      local t = require('ldoc.builtin.'..tbl)
-      if not rawget(t,name) then
+      if not xlib_function(tbl,name) then
          return nil
       end
       href = xlib_url..xlibs[tbl]..'#'..name
@@ -0,0 +1,115 @@
+--------------
+-- Persistent cache of parsed source files (`--cache DIR`).
+--
+-- Every source file gets one entry, which holds the scanned `File` (before
+-- `File:finish`) together with the hash of the file contents and a key made
+-- from the LDoc version, the sources of LDoc's own modules, the command line
+-- and the configuration files. If all of these still match, the file is not
+-- parsed at all.
+--
+-- Hashing and reading/writing entries is done by the native `ldoc_cache`
+-- module of the launcher; without it, files are always parsed.
+
+local doc = require 'ldoc.doc'
+local parse = require 'ldoc.parse'
+local List = require 'pl.List'
+local tablex = require 'pl.tablex'
+local path = require 'pl.path'
+local dir = require 'pl.dir'
+local Item = doc.Item
+
+local ok, native = pcall(require, 'ldoc_cache')
+if not ok then native = nil end
+
+local cache = {}
+
+if native then
+   -- the classes entries may contain
+   native.set_classes {List = List, File = doc.File, Item = doc.Item}
+end
+
+local cache_dir, cache_key
+-- an entry could not be written, which is only reported once
+local store_failed
+
+-- options that only affect the output, not what is parsed
+local ignored_args = tablex.makeset {
+   'jobs','cache','verbose','quiet','dir','output','ext','style','template',
+   'project','title','format','unqualified','one','date','dump','filter','tags',
+   'fatalwarnings','testing','icon','stream','emit_index','search',
+   'stats','max_memory','watch','incremental',
+}
+
+--- use the cache in the directory `cdir`.
+-- `configs` are the texts of all configuration files that were read.
+-- Returns false if there is no native support.
+function cache.setup (cdir, version, args, configs)
+   if not native then return false end
+   if not path.isdir(cdir) then
+      local ok, err = dir.makepath(cdir)
+      if not ok then return nil, err end
+   end
+   local key = List{version}
+   -- the launcher knows the sources of the LDoc modules loaded so far (by
+   -- any state, so only those this one has loaded count)
+   local sources = native.sources()
+   local modules = List()
+   for m in pairs(sources) do
+      if m == 'ldoc' or package.loaded[m] then modules:append(m) end
+   end
+   modules:sort()
+   for m in modules:iter() do
+      key:append(m..'@'..sources[m])
+   end
+   local names = {}
+   for k, v in pairs(args) do
+      if type(k) == 'string' and type(v) ~= 'table' and not ignored_args[k] then
+         names[#names+1] = k
+      end
+   end
+   table.sort(names)
+   for _, k in ipairs(names) do
+      key:append(k..'='..tostring(args[k]))
+   end
+   key:extend(configs)
+   cache_dir, store_failed = cdir, false
+   cache_key = native.hash(key:concat '\0')
+   return true
+end
+
+--- like `parse.scan_file`, but take the file from the cache if possible.
+function cache.scan_file (fname, lang, args)
+   if not cache_dir then
+      return parse.scan_file(fname,lang,args)
+   end
+   local hash = native.hash_file(fname)
+   local entry = path.join(cache_dir, native.hash(fname)..'.entry')
+   local res = hash and native.load(entry)
+   if res and res.key == cache_key and res.name == fname and res.hash == hash then
+      parse.restore_file(res.file,lang,args,res.line)
+      return res.file, nil, res.line
+   end
+
+   local had_warning = Item.had_warning
+   local acount, ecount = doc.sequence_counters()
+   Item.had_warning = nil
+   local F, err, line = parse.scan_file(fname,lang,args)
+   local warned = Item.had_warning
+   Item.had_warning = had_warning or warned
+   local acount2, ecount2 = doc.sequence_counters()
+   -- only files that parse the same whatever came before them, and that have
+   -- no warnings which would have to be repeated
+   if hash and F and not err and not warned and acount2 == acount and ecount2 == ecount then
+      local fargs, flang, warning, error = F.args, F.lang, F.warning, F.error
+      F.args, F.lang, F.warning, F.error = nil, nil, nil, nil
+      local ok, err = native.store(entry, {key = cache_key, name = fname, hash = hash, file = F, line = line})
+      if not ok and not store_failed then
+         store_failed = true
+         io.stderr:write('could not write to the cache ', cache_dir, ': ', err, '\n')
+      end
+      F.args, F.lang, F.warning, F.error = fargs, flang, warning, error
+   end
+   return F, err, line
+end
+
+return cache
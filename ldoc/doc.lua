@@ -9,7 +9,6 @@ local Map = require 'pl.Map'
 local text = require 'pl.stringx'
 
 local doc = {}
-local global = require 'ldoc.builtin.globals'
 local tools = require 'ldoc.tools'
 local split_dotted_name = tools.split_dotted_name
 
@@ -970,6 +969,11 @@ end
 
 local ecount = 0
 
+-- the counters above depend on the order in which files are parsed (see ldoc.jobs)
+function doc.sequence_counters ()
+   return acount, ecount
+end
+
 -- this alias macro implements @error.
 -- Alias macros need to return the same results as Item:check_tags...
 function doc.error_macro(tags,value,modifiers)
@@ -1041,6 +1045,78 @@ Module.warning, Module.error = Item.warning, Item.error
 
 -------- Resolving References -----------------
 
+-- Resolving a reference by an unqualified name used to scan all the items of
+-- a module (or of every module, with `global_lookup`). Instead, each module
+-- gets an index of its items by name and by last name component, and the
+-- list of modules an index over all of them. These are built on first use,
+-- i.e. once all files are finished, and kept aside so that they do not show
+-- up in the object graph.
+local module_symbols = setmetatable({}, {__mode = 'k'})
+local global_symbols = setmetatable({}, {__mode = 'k'})
+
+local function symbols_of (mod)
+   local symbols = module_symbols[mod]
+   if not symbols then
+      -- `position`: first item of the list with that name, for `lookup_class_item`.
+      -- `last`: first of the names in `by_name` ending in '.NAME', ':NAME' or
+      -- '\NAME', for `get_fun_ref`
+      local position, last = {}, {}
+      local by_name = mod.items.by_name
+      local function add_last (qname, ref)
+         local name = qname:match '[.:\\]([^.:\\]+)$'
+         if name and last[name] == nil then last[name] = ref end
+      end
+      for i, item in ipairs(mod.items) do
+         local name = item.name
+         if name ~= nil then
+            if position[name] == nil then position[name] = i end
+            if by_name[name] then add_last(name, by_name[name]) end
+         end
+      end
+      for qname, ref in pairs(by_name) do
+         if position[qname] == nil then add_last(qname, ref) end
+      end
+      symbols = {position = position, last = last}
+      module_symbols[mod] = symbols
+   end
+   return symbols
+end
+
+--- (re)build the symbol indexes for reference lookups in `modules`.
+-- Called once all files are finished, and again if the modules are reordered.
+function doc.index_symbols (modules)
+   global_symbols[modules] = nil
+   for mod in modules:iter() do
+      module_symbols[mod] = nil
+      symbols_of(mod)
+   end
+end
+
+-- `global_lookup`: the first module with `get_fun_ref(name)`, and that item
+local function global_lookup (modules, name)
+   local symbols = global_symbols[modules]
+   if not symbols then
+      symbols = {}
+      for m in modules:iter() do
+         for qname, ref in pairs(m.items.by_name) do
+            if symbols[qname] == nil then symbols[qname] = {m, ref} end
+         end
+         for lname in pairs(symbols_of(m).last) do
+            if symbols[lname] == nil then symbols[lname] = {m, m:get_fun_ref(lname)} end
+         end
+      end
+      global_symbols[modules] = symbols
+   end
+   local entry = symbols[name]
+   if entry then return entry[1], entry[2] end
+   if name:find '[.:\\%-]' then -- not a plain name: be exact about it
+      for m in modules:iter() do
+         local fun_ref = m:get_fun_ref(name)
+         if fun_ref then return m, fun_ref end
+      end
+   end
+end
+
 function Module:hunt_for_reference (packmod, modules)
    local mod_ref
    local package = self.package or ''
@@ -1077,11 +1153,13 @@ function Module:lookup_class_item (packmod, s)
    local qs = klass..':'..s
    local klass_section = self.sections.by_name[klass]
    if not klass_section then return nil end -- no such class
-   for item in self.items:iter() do
-      --print('item',qs,item.name)
-      if s == item.name or qs == item.name then
-         return reference(s,self,item)
-      end
+   -- the first item called either way
+   local position = symbols_of(self).position
+   local i, j = position[s], position[qs]
+   if i and j then i = math.min(i,j) end
+   i = i or j
+   if i then
+      return reference(s,self,self.items[i])
    end
    return nil
 end
@@ -1111,7 +1189,10 @@ function Module:process_see_reference (s,modules,istype)
    if ldoc and ldoc.no_lua_ref then
       lua_manual_ref = function(s) return false end
    else
-      lua_manual_ref = global.lua_manual_ref
+      -- the builtin globals are loaded for the first reference that needs them
+      lua_manual_ref = function(s)
+         return require('ldoc.builtin.globals').lua_manual_ref(s)
+      end
    end
    -- pure C projects use global lookup (no namespaces)
    if ldoc and ldoc.global_lookup == nil then
@@ -1161,10 +1242,9 @@ function Module:process_see_reference (s,modules,istype)
       end
    else -- plain jane name; module in this package, function in this module
       if ldoc and ldoc.global_lookup then
-        for m in modules:iter() do
-            fun_ref = m:get_fun_ref(s)
-            if fun_ref then return reference(s,m,fun_ref) end
-        end
+        local m
+        m, fun_ref = global_lookup(modules, s)
+        if fun_ref then return reference(s,m,fun_ref) end
         return nil,"function: "..s.." not found globally"
       end
       mod_ref = modules.by_name[self.package..'.'..s]
@@ -1187,6 +1267,9 @@ function Module:get_fun_ref(s)
    local fun_ref = self.items.by_name[s]
    -- did not get an exact match, so try to match by the unqualified fun name
    if not fun_ref then
+      fun_ref = symbols_of(self).last[s]
+   end
+   if not fun_ref and s:find '[.:\\%-]' then -- not a plain name: match as before
       local patt = '[.:\\]'..s..'$'
       for qname,ref in pairs(self.items.by_name) do
          if qname:match(patt) then
@@ -1219,8 +1302,9 @@ function Module:resolve_references(modules)
             if href then
                item.see:append (href)
                found:append{item,s}
-            elseif err then
-               item:warning(err)
+            else
+               self.unresolved_refs = true -- (see ldoc.manifest)
+               if err then item:warning(err) end
             end
          end
       end
@@ -24,9 +24,24 @@ local tools = require 'ldoc.tools'
 local markup = require 'ldoc.markup'
 local prettify = require 'ldoc.prettify'
 local doc = require 'ldoc.doc'
+local manifest = require 'ldoc.manifest'
+local profile = require 'ldoc.profile'
+local stream = require 'ldoc.stream'
+local search = require 'ldoc.search'
+local stats = require 'ldoc.stats'
+local jobs = require 'ldoc.jobs'
 local unpack = utils.unpack
+local Item = doc.Item
 local html = {}
 
+-- pages are written on a background thread by the launcher, if it can
+local ok, native_output = pcall(require, 'ldoc_output')
+if not ok then native_output = nil end
+
+-- and escaping and cleaning up whitespace is done natively
+local ok, native_html = pcall(require, 'ldoc_html')
+if not ok then native_html = nil end
+
 
 local quit = utils.quit
 
@@ -38,6 +53,7 @@ local function cleanup_whitespaces(text)
    lines[#lines + 1] = "" -- Little trick: file should end with newline
    return table.concat(lines, "\n")
 end
+if native_html then cleanup_whitespaces = native_html.cleanup end
 
 local function get_module_info(m)
    local info = OrderedMap()
@@ -56,9 +72,27 @@ end
 
 local escape_table = { ["'"] = "&apos;", ["\""] = "&quot;", ["<"] = "&lt;", [">"] = "&gt;", ["&"] = "&amp;" }
 
-function html.generate_output(ldoc, args, project)
-   local check_directory, check_file, writefile = tools.check_directory, tools.check_file, tools.writefile
+-- `build_key` identifies the LDoc version and configuration, for `--incremental`
+function html.generate_output(ldoc, args, project, build_key)
+   local check_directory, check_file = tools.check_directory, tools.check_file
+   local writer = native_output and not jobs.rendering and native_output.open()
+   local writefile = tools.writefile
+   if writer then
+      -- unchanged files are left alone; errors are reported when all is written
+      writefile = function(name,text)
+         writer:write(name,text)
+      end
+   end
+   if stats.active() then
+      local write = writefile
+      writefile = function(name,text)
+         stats.count('output_bytes', #text)
+         return write(name,text)
+      end
+   end
+   writefile = profile.wrap('writefile', writefile)
    local original_ldoc
+   local pages -- the dependency manifest, if incremental
 
    local function save_and_set_ldoc (set)
       if not set then return end
@@ -83,8 +117,13 @@ function html.generate_output(ldoc, args, project)
       end
    end
 
+   -- numbers are escaped as strings, as by the native escape
    function ldoc.escape(str)
-      return (str:gsub("['&<>\"]", escape_table))
+      return (string.gsub(str, "['&<>\"]", escape_table))
+   end
+
+   if native_html then
+      ldoc.escape = native_html.escape
    end
 
    function ldoc.prettify(str)
@@ -115,8 +154,10 @@ function html.generate_output(ldoc, args, project)
       if see.href then -- explicit reference, e.g. to Lua manual
          return see.href
       elseif doc.Module:class_of(see) then
+         if pages then pages:link(see) end
          return ldoc.ref_to_module(see)
       else
+         if pages then pages:link(see.mod) end
          return ldoc.ref_to_module(see.mod)..'#'..see.name
       end
    end
@@ -274,18 +315,58 @@ function ldoc.source_ref (fun)
       ldoc.doc_charset = (m and m.tags.charset) or ldoc.charset
    end
 
-   local module_template,_ = utils.readfile (path.join(args.template,ldoc.templ))
+   -- the builtin templates and style sheets are modules, which never go
+   -- through a file; args.template and args.style are '!...' for them
+   local function builtin (dir)
+      return type(dir) == 'string' and dir:match '^!' ~= nil
+   end
+
+   -- a template or style sheet from `dir`
+   local function resource (dir, name)
+      if builtin(dir) then
+         local ok, text = pcall(require, 'ldoc.html.'..name:gsub('%.','_'))
+         return ok and text or nil
+      end
+      return utils.readfile(path.join(dir,name))
+   end
+
+   local module_template,_ = resource(args.template,ldoc.templ)
    if not module_template then
       quit("template not found at '"..args.template.."' Use -l to specify directory containing ldoc.ltp")
    end
 
+   -- The template is compiled only once for all pages (once per escape character,
+   -- which can be changed with @set). Penlight before 1.6 only has substitute().
+   local compiled = {}
+   local function compile(template_str, escape)
+      local key = escape or ''
+      local ct = compiled[key]
+      if not ct then
+         local err
+         ct, err = template.compile(template_str, {escape = escape})
+         if not ct then return nil, err end
+         compiled[key] = ct
+      end
+      return ct
+   end
+
    -- Runs a template on a module to generate HTML page.
    local function templatize(template_str, ldoc, module)
-      local out, err = template.substitute(template_str, {
+      local env = {
          ldoc = ldoc,
          module = module,
          _escape = ldoc.template_escape
-      })
+      }
+      local out, err
+      if template.compile then
+         local ct
+         ct, err = compile(template_str, ldoc.template_escape)
+         if ct then
+            out, err = ct:render(env)
+         end
+      else
+         out, err = template.substitute(template_str, env)
+      end
       if not out then
          quit(("template failed for %s: %s"):format(
                module and module.name or ldoc.output or "index",
@@ -296,13 +377,112 @@ function ldoc.source_ref (fun)
       end
       return cleanup_whitespaces(out)
    end
+   templatize = profile.wrap('templatize', templatize)
+
+   -- With --stream, the index page (the whole documentation in single mode)
+   -- goes to its file while it is being rendered; it is never one string.
+   -- postprocess_html needs that string, so it rules out streaming.
+   local function stream_page (template_str, ldoc, module, file)
+      local render, err = stream.compile(template_str, ldoc.template_escape)
+      local ok
+      if render then
+         ok, err = stream.write(render, {
+            ldoc = ldoc,
+            module = module,
+            _escape = ldoc.template_escape
+         }, file)
+      end
+      if not ok then
+         quit(("template failed for %s: %s"):format(
+               module and module.name or ldoc.output or "index",
+               err))
+      end
+   end
+   stream_page = profile.wrap('templatize', stream_page)
+   local search_index = profile.wrap('search_index', search.index)
 
    local css, custom_css = ldoc.css, ldoc.custom_css
+   local search_js = args.search and args.ext ~= '.md' and 'search.js'
+   ldoc.search_script = search_js
    ldoc.output = args.output
    ldoc.ipairs = ipairs
    ldoc.pairs = pairs
    ldoc.print = print
 
+   -- in incremental mode, a page is only rendered if anything it depends on has changed
+   local all_modules = List()
+   if args.incremental and jobs.rendering then
+      -- the main state keeps the manifest; a worker only notes the dependencies
+      pages = manifest.recorder()
+   elseif args.incremental then
+      local key = List{build_key or '', module_template, tostring(css), tostring(custom_css)}
+      local names = tablex.keys(args)
+      table.sort(names, function(a,b) return tostring(a) < tostring(b) end)
+      for _, k in ipairs(names) do
+         if type(args[k]) ~= 'table' then key:append(tostring(k)..'='..tostring(args[k])) end
+      end
+      -- the navigation list
+      for kind, modules in project() do
+         key:append(kind)
+         for m in modules() do
+            all_modules:append(m)
+            key:append(m.name)
+            key:append(ldoc.display_name(m))
+         end
+      end
+      pages = manifest.open(path.join(args.dir,'.ldoc-manifest'), key:concat '\0', all_modules)
+   end
+   if pages then
+      local process_reference = markup.process_reference
+      markup.process_reference = function(...)
+         local ref, err = process_reference(...)
+         if not ref then pages:unresolved() end
+         return ref, err
+      end
+   end
+
+   local function unresolved_refs (modules)
+      for _, m in ipairs(modules) do
+         if m.unresolved_refs then return true end
+      end
+      return false
+   end
+
+   -- can the existing `file` of the page `name`, showing `modules`, stay?
+   -- (a worker renders whatever it is handed)
+   local function page_fresh (name, file, modules)
+      if not pages or jobs.rendering then return false end
+      return pages:fresh(name, file, modules, unresolved_refs(modules))
+   end
+
+   -- the page `name`, showing `modules`, is going to be rendered
+   local had_warning
+   local function page_start (name, modules)
+      if pages then
+         pages:start(name, modules, unresolved_refs(modules))
+         had_warning, Item.had_warning = Item.had_warning, nil
+      end
+   end
+
+   -- is the page `name`, showing `modules`, to be written to `file`?
+   local function render_page (name, file, modules)
+      if page_fresh(name, file, modules) then
+         return false
+      end
+      page_start(name, modules)
+      return true
+   end
+
+   -- the page render_page agreed to has been written
+   local function page_done ()
+      stats.count('pages')
+      if pages then
+         local warned = Item.had_warning
+         pages:finish(not warned)
+         Item.had_warning = had_warning or warned
+      end
+   end
+
    -- Bang out the index.
    -- in single mode there is one module and the 'index' is the
    -- documentation for that module.
@@ -311,45 +491,81 @@ function ldoc.source_ref (fun)
       ldoc.kinds_allowed = {module = true, topic = true}
       ldoc.one = true
    end
-   ldoc.root = true
-   if ldoc.module then
-      ldoc.module.info = get_module_info(ldoc.module)
-      ldoc.module.ldoc = ldoc
-      save_and_set_ldoc(ldoc.module.tags.set)
+   local index = args.output..args.ext
+   local out -- nil if the existing index can stay
+   if not jobs.rendering and render_page(index, path.join(args.dir,index), all_modules) then
+      ldoc.root = true
+      if ldoc.module then
+         ldoc.module.info = get_module_info(ldoc.module)
+         ldoc.module.ldoc = ldoc
+         save_and_set_ldoc(ldoc.module.tags.set)
+      end
+      set_charset(ldoc)
+      if args.stream and stream.available() and not ldoc.postprocess_html then
+         check_directory(args.dir)
+         stream_page(module_template, ldoc, ldoc.module, path.join(args.dir,index))
+      else
+         out = templatize(module_template, ldoc, ldoc.module)
+      end
+      ldoc.root = false
+      restore_ldoc()
+      page_done()
+   end
+
+   -- a worker only renders pages; all files are written by the main state
+   if not jobs.rendering then
+      check_directory(args.dir) -- make sure output directory is ok
+
+      -- project icon
+      if ldoc.icon then
+         local dir_data = args.dir .. '/data'
+         if not path.isdir(dir_data) then
+             -- luacheck: push ignore lfs
+             lfs.mkdir(dir_data)
+             -- luacheck: pop
+         end
+         local file = require 'pl.file'
+         file.copy(ldoc.icon, dir_data)
+      end
    end
-   set_charset(ldoc)
-   local out = templatize(module_template, ldoc, ldoc.module)
-   ldoc.root = false
-   restore_ldoc()
 
-   check_directory(args.dir) -- make sure output directory is ok
+   args.dir = args.dir .. path.sep
 
-   -- project icon
-   if ldoc.icon then
-      local dir_data = args.dir .. '/data'
-      if not path.isdir(dir_data) then
-          -- luacheck: push ignore lfs
-          lfs.mkdir(dir_data)
-          -- luacheck: pop
+   if not jobs.rendering then
+      if css then -- has CSS been copied?
+         if builtin(args.style) then
+            -- only written if it differs, e.g. after an update of LDoc
+            local text = resource(args.style,css)
+            if utils.readfile(args.dir..css,true) ~= text then
+               writefile(args.dir..css,text)
+            end
+         else
+            check_file(args.dir..css, path.join(args.style,css))
+         end
       end
-      local file = require 'pl.file'
-      file.copy(ldoc.icon, dir_data)
-   end
 
-   args.dir = args.dir .. path.sep
+      if custom_css then -- has custom CSS been copied?
+         check_file(args.dir..custom_css, custom_css)
+      end
 
-   if css then -- has CSS been copied?
-      check_file(args.dir..css, path.join(args.style,css))
-   end
+      -- the search index, with the links from the index page, and its lookup script
+      if search_js then
+         ldoc.root = true
+         writefile(args.dir..'search_index.js', search_index(search.entries(project, ldoc.ref_to_module)))
+         ldoc.root = false
+         local text = resource('!',search_js)
+         if utils.readfile(args.dir..search_js,true) ~= text then
+            writefile(args.dir..search_js,text)
+         end
+      end
 
-   if custom_css then -- has custom CSS been copied?
-      check_file(args.dir..custom_css, custom_css)
+      -- write out the module index
+      if out then
+         out = cleanup_whitespaces(out)
+         writefile(args.dir..index,out)
+      end
    end
 
-   -- write out the module index
-   out = cleanup_whitespaces(out)
-   writefile(args.dir..args.output..args.ext,out)
-
    -- in single mode, we exclude any modules since the module has been done;
    -- ext step is then only for putting out any examples or topics
    local mods = List()
@@ -369,27 +585,95 @@ function ldoc.source_ref (fun)
    if custom_css then
       ldoc.custom_css = '../'..custom_css
    end
+   if search_js then
+      ldoc.search_script = '../'..search_js
+   end
+
+   -- render the page of module `m`
+   local function module_page (m)
+      ldoc.module = m
+      ldoc.body = m.body
+      m.ldoc = ldoc
+      if m.tags.set then
+         save_and_set_ldoc(m.tags.set)
+      end
+      set_charset(ldoc)
+      m.info = get_module_info(m)
+      if ldoc.body and m.postprocess then
+         ldoc.body = m.postprocess(ldoc.body)
+      end
+      local out = templatize(module_template, ldoc, m)
+      restore_ldoc()
+      return out
+   end
+
+   -- the pages to be rendered, per kind
+   local names, by_name = List(), {}
+   for i, m in ipairs(mods) do
+      local lkind, modules = m[2], m[3]
+      local todo = List()
+      for mod in modules() do
+         local page = lkind..'/'..mod.name..args.ext
+         if not page_fresh(page, args.dir..page, {mod}) then
+            todo:append(page)
+            names:append(page)
+            by_name[page] = {module = mod, kind = i}
+         end
+      end
+      m[4] = todo
+   end
+
+   if jobs.rendering then
+      -- the pages are handed out in order, so the kinds only ever move on
+      local kinds_done = 0
+      jobs.serve_pages(function(page)
+         local p = by_name[page]
+         while kinds_done < p.kind do
+            kinds_done = kinds_done + 1
+            project:put_kind_first(mods[kinds_done][1])
+         end
+         if pages then pages:start() end
+         local out = module_page(p.module)
+         return out, pages and pages:dependencies()
+      end)
+   end
+
+   -- with --jobs, workers render the pages (see ldoc.jobs). Not so in single
+   -- mode, where rendering the index affects the other pages.
+   local rendered
+   if args.jobs > 1 and not ldoc.single then
+      rendered = jobs.render(names, args.jobs, {updatetime = ldoc.updatetime})
+   end
+   local n = 0
    for m in mods:iter() do
-      local kind, lkind, modules = unpack(m)
+      local kind, lkind, _, todo = unpack(m)
       check_directory(args.dir..lkind)
       project:put_kind_first(kind)
-      for m in modules() do
-         ldoc.module = m
-         ldoc.body = m.body
-         m.ldoc = ldoc
-         if m.tags.set then
-            save_and_set_ldoc(m.tags.set)
-         end
-         set_charset(ldoc)
-         m.info = get_module_info(m)
-         if ldoc.body and m.postprocess then
-            ldoc.body = m.postprocess(ldoc.body)
+      for page in todo:iter() do
+         local mod = by_name[page].module
+         n = n + 1
+         page_start(page, {mod})
+         local res = rendered and rendered(n)
+         local out
+         if res then
+            jobs.replay(res)
+            if pages and res.deps then pages:replay(res.deps) end
+            out = res.page
+         else
+            out = module_page(mod)
          end
-         local out = templatize(module_template, ldoc, m)
-         writefile(args.dir..lkind..'/'..m.name..args.ext,out)
-         restore_ldoc()
+         writefile(args.dir..page,out)
+         page_done()
+      end
+   end
+   jobs.stop()
+   if writer then
+      local res = writer:finish()
+      if #res.errors > 0 then
+         quit(table.concat(res.errors,'\n'))
       end
    end
+   if pages then pages:save() end
    if not args.quiet then print('output written to '..tools.abspath(args.dir)) end
 end
 
@@ -12,6 +12,9 @@ return [==[
 # if ldoc.favicon then
     <link rel="icon" href="$(ldoc.favicon)" type="image/png" />
 # end
+# if ldoc.search_script then -- search box, with --search
+    <script src="$(ldoc.search_script)" type="text/javascript" defer="defer"></script>
+# end
 </head>
 <body>
 
@@ -0,0 +1,130 @@
+return [==[
+/* Search box of LDoc (--search): looks up names, parameters and summaries
+   in search_index.js, which is next to this script (see ldoc/search.lua). */
+(function () {
+    var script = document.currentScript;
+    var base = script ? script.src.replace(/[^\/]*$/, '') : '';
+    var index, children, box, list;
+    var MAX_RESULTS = 50;
+
+    function lowerBound(terms, word) {
+        var lo = 0, hi = terms.length;
+        while (lo < hi) {
+            var mid = (lo + hi) >> 1;
+            if (terms[mid] < word) lo = mid + 1; else hi = mid;
+        }
+        return lo;
+    }
+
+    /* the entries with a term starting with word, as a set */
+    function matching(word) {
+        var set = {}, terms = index.terms;
+        for (var i = lowerBound(terms, word); i < terms.length && terms[i].lastIndexOf(word, 0) === 0; i++) {
+            var posting = index.postings[i], e = 0;
+            for (var j = 0; j < posting.length; j++) {
+                e += posting[j];
+                set[e] = true;
+            }
+        }
+        return set;
+    }
+
+    /* an entry matches a word if it or its module does */
+    function matches(set, e) {
+        var m = index.entries[e][1];
+        return set[e] || (m >= 0 && set[m]);
+    }
+
+    function rank(e, query) {
+        var name = index.entries[e][0].toLowerCase();
+        if (name === query) return 0;
+        var last = name.replace(/^.*[.:]/, '');
+        if (last === query) return 1;
+        if (name.lastIndexOf(query, 0) === 0 || last.lastIndexOf(query, 0) === 0) return 2;
+        if (name.indexOf(query) >= 0) return 3;
+        return 4;
+    }
+
+    function lookup(query) {
+        var words = query.toLowerCase().match(/[a-z0-9_\u0080-\uffff]+/g);
+        if (!words) return [];
+        var sets = words.map(matching);
+        /* candidates: the entries of the first word and the items of its modules */
+        var found = [], seen = {};
+        for (var k in sets[0]) {
+            var e = +k, cands = [e].concat(children[e] || []);
+            for (var c = 0; c < cands.length; c++) {
+                var x = cands[c];
+                if (seen[x]) continue;
+                seen[x] = true;
+                var all = true;
+                for (var w = 1; w < sets.length && all; w++) all = matches(sets[w], x);
+                if (all) found.push(x);
+            }
+        }
+        var q = words[words.length - 1];
+        var ranks = {};
+        found.forEach(function (e) { ranks[e] = rank(e, q); });
+        found.sort(function (a, b) {
+            return ranks[a] - ranks[b] || index.entries[a][0].length - index.entries[b][0].length || a - b;
+        });
+        return found.slice(0, MAX_RESULTS);
+    }
+
+    function show() {
+        list.innerHTML = '';
+        if (!index || !box.value.trim()) { list.style.display = 'none'; return; }
+        lookup(box.value).forEach(function (e) {
+            var entry = index.entries[e], li = document.createElement('li');
+            var a = document.createElement('a');
+            a.href = base + entry[3];
+            a.textContent = entry[0];
+            li.appendChild(a);
+            var about = index.kinds[entry[2]];
+            if (entry[1] >= 0) about += ' in ' + index.entries[entry[1]][0];
+            var small = document.createElement('small');
+            small.textContent = ' ' + about;
+            li.appendChild(small);
+            if (entry[4]) li.title = entry[4];
+            list.appendChild(li);
+        });
+        list.style.display = list.firstChild ? 'block' : 'none';
+    }
+
+    window.ldoc_search_index = function (data) {
+        index = data;
+        children = {};
+        data.entries.forEach(function (entry, e) {
+            if (entry[1] >= 0) (children[entry[1]] = children[entry[1]] || []).push(e);
+        });
+        show();
+    };
+
+    function setup() {
+        var place = document.getElementById('ldoc_search') || document.getElementById('navigation') || document.body;
+        var div = document.createElement('div');
+        box = document.createElement('input');
+        box.type = 'search';
+        box.placeholder = 'Search';
+        box.style.width = '90%';
+        box.style.margin = '0.5em 0';
+        list = document.createElement('ul');
+        list.className = 'nowrap';
+        list.style.display = 'none';
+        box.addEventListener('input', show);
+        box.addEventListener('keydown', function (ev) {
+            if (ev.key === 'Enter' && list.firstChild) window.location = list.firstChild.firstChild.href;
+            if (ev.key === 'Escape') { box.value = ''; show(); }
+        });
+        div.appendChild(box);
+        div.appendChild(list);
+        place.insertBefore(div, place.firstChild);
+        var data = document.createElement('script');
+        data.src = base + 'search_index.js';
+        document.head.appendChild(data);
+    }
+
+    if (document.readyState === 'loading') document.addEventListener('DOMContentLoaded', setup);
+    else setup();
+})();
+]==]
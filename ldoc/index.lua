@@ -0,0 +1,159 @@
+--------------
+-- Binary index of the documented API (`--emit_index FILE`).
+--
+-- Tools like editor plugins can load this file instead of running LDoc or
+-- scraping its HTML. It holds the modules, their items, parameters, return
+-- values and resolved `@see` references, with all texts as they are in the
+-- comments (i.e. not rendered).
+--
+-- The layout is fixed-size records of little-endian 32-bit words, which refer
+-- to each other by index and to texts by their offset in a pool of
+-- length-prefixed strings, so that a mapped file can be used as it is. It is
+-- described in native/ldoc_index.h, which is also a reader for C++.
+
+local List = require 'pl.List'
+local utils = require 'pl.utils'
+
+local index = {}
+
+local MAGIC, VERSION = 'LDOCIDX1', 1
+local HEADER_SIZE = 64
+local NONE = 0xFFFFFFFF
+local PARAM_OPTIONAL, PARAM_READONLY = 1, 2
+
+local function words (n)
+   return '<'..('I4'):rep(n)
+end
+
+local MODULE, ITEM, PARAM, RETURN, REF = words(10), words(15), words(5), words(3), words(4)
+
+-- the string pool; every text is stored once, "" at offset 0
+local function string_pool ()
+   local parts, offsets, size = List(), {}, 0
+   local function add (s)
+      if s == nil then s = '' end
+      if type(s) ~= 'string' then s = tostring(s) end
+      local offset = offsets[s]
+      if not offset then
+         offset = size
+         offsets[s] = offset
+         local pad = (4 - (#s + 5) % 4) % 4
+         parts:append(string.pack('<I4', #s)..s..('\0'):rep(pad + 1))
+         size = size + 4 + #s + 1 + pad
+      end
+      return offset
+   end
+   add ''
+   return add, parts, function() return size end
+end
+
+--- write the index of `modules` to the file `fname`.
+-- Returns true, or nil and an error.
+function index.write (modules, fname)
+   if not string.pack then
+      return nil, '--emit_index needs Lua 5.3 or later'
+   end
+   local str, pool, pool_size = string_pool()
+   local mods, items, params, rets, refs = List(), List(), List(), List(), List()
+
+   -- modules and items are numbered first, for the references between them
+   local module_index, item_index = {}, {}
+   local nitems = 0
+   for i, m in ipairs(modules) do
+      module_index[m] = i - 1
+      for item in m.items:iter() do
+         item_index[item] = nitems
+         nitems = nitems + 1
+      end
+   end
+
+   local function add_refs (item)
+      local first = #refs
+      if item.see then
+         for ref in item.see:iter() do
+            local mod, target = NONE, NONE
+            if ref.mod then
+               mod = module_index[ref.mod] or NONE
+               local target_item = ref.name ~= '' and ref.mod.items.by_name[ref.name]
+               if target_item then target = item_index[target_item] or NONE end
+            end
+            refs:append(string.pack(REF, str(ref.label), mod, target, str(ref.href)))
+         end
+      end
+      return first, #refs - first
+   end
+
+   local function add_param (item, p)
+      local def = item:default_of_param(p)
+      local flags = 0
+      if def then flags = flags + PARAM_OPTIONAL end
+      if item:readonly(p) then flags = flags + PARAM_READONLY end
+      params:append(string.pack(PARAM, str(p), str(item:type_of_param(p)),
+         str(item.params.map[p]), str(def ~= true and def or ''), flags))
+   end
+
+   -- a table parameter is followed by its fields, named 'table.field'
+   local function add_params (item)
+      local first = #params
+      if item.params then
+         for parm in item.params:iter() do
+            local param, sublist = item:subparam(parm)
+            if sublist then add_param(item, sublist) end
+            for _, p in ipairs(param) do
+               add_param(item, p)
+            end
+         end
+      end
+      return first, #params - first
+   end
+
+   local function add_returns (item)
+      local first = #rets
+      if item.retgroups then
+         for g, group in ipairs(item.retgroups) do
+            for r in group:iter() do
+               rets:append(string.pack(RETURN, g - 1, str(r.type), str(r.text)))
+            end
+         end
+      end
+      return first, #rets - first
+   end
+
+   for i, m in ipairs(modules) do
+      local first_ref, nrefs = add_refs(m)
+      local first_item = #items
+      for item in m.items:iter() do
+         local first_param, nparams = add_params(item)
+         local first_ret, nrets = add_returns(item)
+         local first_iref, nirefs = add_refs(item)
+         items:append(string.pack(ITEM, str(item.name), str(item.type), str(item.summary),
+            str(item.description), str(item.args), str(item.section), str(item.file and item.file.filename),
+            tonumber(item.lineno) or 0, i - 1, first_param, nparams, first_ret, nrets, first_iref, nirefs))
+      end
+      mods:append(string.pack(MODULE, str(m.name), str(m.type), str(m.summary), str(m.description),
+         str(m.file and m.file.filename), tonumber(m.lineno) or 0, first_item, #items - first_item,
+         first_ref, nrefs))
+   end
+
+   local offset = HEADER_SIZE
+   local function table_at (list, record)
+      local at = offset
+      offset = offset + #list * string.packsize(record)
+      return #list, at
+   end
+   local header = List{VERSION, 0}
+   for _, t in ipairs {{mods, MODULE}, {items, ITEM}, {params, PARAM}, {rets, RETURN}, {refs, REF}} do
+      header:extend {table_at(t[1], t[2])}
+   end
+   header:extend {offset, pool_size()}
+   header = MAGIC..string.pack(words(#header), utils.unpack(header))
+
+   local out = List{header}
+   out:extend(mods); out:extend(items); out:extend(params); out:extend(rets); out:extend(refs)
+   out:extend(pool)
+   local ok, err = utils.writefile(fname, out:concat())
+   if not ok then return nil, err end
+   return true
+end
+
+return index
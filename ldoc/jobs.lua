@@ -0,0 +1,339 @@
+--------------
+-- Parsing source files and rendering pages in parallel (`ldoc --jobs N`).
+--
+-- The launcher provides the native `ldoc_jobs` module, which runs ldoc.lua
+-- again on worker states, each on its own thread. A worker reads the same
+-- configuration as the main state, but when it reaches the parsing stage
+-- it only scans the files it is handed and sends the resulting `File`
+-- objects back, together with anything it wrote to stdout or stderr.
+-- The main state picks up these results strictly in the original file order
+-- and finishes them itself, so the output is the same as for a serial run.
+--
+-- The module pages are rendered the same way. The main state keeps a copy of
+-- every file as it was scanned, and workers for rendering get these copies
+-- instead of parsing the files again; from there on they build the project
+-- just like the main state did. Each then renders the pages it is handed out
+-- and sends back their text, which the main state writes in order.
+--
+-- Examples, prettified files and topics are read on workers as well, between
+-- parsing and rendering. A worker prettifies each example with its @{refs}
+-- left as placeholders, which are resolved in a final pass when the page is
+-- rendered, and formats the Markdown of each topic the same way (unless the
+-- topic or the formatter rule that out, see `markup.can_defer`). Workers
+-- rendering pages get these results too, and do not prettify or format again.
+--
+-- Workers do not look for the configuration and the source files again: the
+-- main state passes on what it found (see `jobs.tell`).
+--
+-- Anything a worker cannot do exactly like the main state (e.g. a file whose
+-- items depend on the order of parsing) is simply parsed again in the main state.
+
+local doc = require 'ldoc.doc'
+local List = require 'pl.List'
+local path = require 'pl.path'
+local lfs = require 'lfs'
+local Item = doc.Item
+
+local ok, native = pcall(require, 'ldoc_jobs')
+if not ok then native = nil end
+
+local jobs = {}
+
+if native then
+   -- the classes results may contain
+   native.set_classes {List = List, File = doc.File, Item = doc.Item}
+end
+
+jobs.context = native and native.context()
+jobs.worker = jobs.context ~= nil
+-- a worker that renders pages, rather than parsing files
+jobs.rendering = jobs.worker and jobs.context.scanned ~= nil
+-- a worker that reads examples and topics
+jobs.preparing = jobs.worker and jobs.context.special ~= nil
+-- a worker that parses files
+jobs.parsing = jobs.worker and not jobs.rendering and not jobs.preparing
+
+-- the directory ldoc was started in; the main state may change directory later
+jobs.start_dir = jobs.worker and jobs.context.dir or lfs.currentdir()
+
+--- can files be handed out to workers?
+function jobs.available ()
+   return native ~= nil and not jobs.worker
+end
+
+--- a path given on the command line, as seen from the current directory.
+-- Workers start after the main state may have changed directory.
+function jobs.start_path (p)
+   if jobs.worker and not path.isabs(p) then
+      return path.join(jobs.start_dir, p)
+   end
+   return p
+end
+
+-- what the main state found out before starting workers, for them to reuse
+local known = {}
+
+--- in the main state: pass `value` on to the workers as what is known of `key`.
+-- A table is passed on as it is when the workers start.
+function jobs.tell (key, value)
+   if not jobs.worker then known[key] = value end
+end
+
+--- on a worker: what the main state told of `key`, if anything.
+function jobs.known (key)
+   return jobs.worker and jobs.context.known and jobs.context.known[key] or nil
+end
+
+local EXIT = {}
+local output, exit_code
+
+if jobs.worker then
+   -- a worker never writes anything itself; the main state replays its output
+   output = {}
+   local function capture (name)
+      return {
+         write = function(self,...)
+            for i = 1, select('#',...) do
+               local s = select(i,...)
+               if math.type and math.type(s) == 'float' then
+                  s = ('%.14g'):format(s)
+               end
+               output[#output+1] = name
+               output[#output+1] = tostring(s)
+            end
+            return self
+         end,
+         flush = function(self) return self end,
+         setvbuf = function() return true end,
+         close = function() return true end,
+      }
+   end
+   io.stdout = capture 'stdout'
+   io.stderr = capture 'stderr'
+   function io.write (...)
+      return io.stdout:write(...)
+   end
+   function print (...)
+      local n = select('#',...)
+      for i = 1, n do
+         io.stdout:write(tostring((select(i,...))), i < n and '\t' or '\n')
+      end
+      if n == 0 then io.stdout:write '\n' end
+   end
+   function os.exit (code)
+      if code == nil or code == true then code = 0
+      elseif code == false then code = 1
+      end
+      exit_code = code
+      error(EXIT,0)
+   end
+end
+
+--- worker loop: parse each file handed out by the main state.
+-- `parse` returns the scanned file, any error and the last line of the file.
+-- Never returns.
+function jobs.serve (parse)
+   for idx, fname in native.next do
+      local acount, ecount = doc.sequence_counters()
+      output, exit_code = {}, nil
+      Item.had_warning = nil
+      local ok, F, err, line = pcall(parse, fname)
+      local res
+      if (not ok and F == EXIT) or err == EXIT then
+         res = {output = output, had_warning = Item.had_warning, exit = true, code = exit_code}
+      elseif not ok then
+         res = {serial = true}
+      elseif err then
+         if F then
+            F:warning("internal LDoc error")
+         end
+         res = {output = output, had_warning = Item.had_warning, err = err}
+      else
+         local acount2, ecount2 = doc.sequence_counters()
+         if acount2 ~= acount or ecount2 ~= ecount then
+            res = {serial = true}
+         end
+      end
+      if not res then
+         if F then
+            F.args, F.lang, F.warning, F.error = nil, nil, nil, nil
+         end
+         res = {output = output, had_warning = Item.had_warning, file = F, line = line}
+      end
+      if not native.submit(idx,res) then
+         native.submit(idx,{serial = true})
+      end
+   end
+   coroutine.yield()
+end
+
+-- worker loop for jobs giving a value: `result(...)` makes the result of
+-- `job(name)` into what is submitted
+local function serve_values (job, result)
+   for idx, name in native.next do
+      output, exit_code = {}, nil
+      Item.had_warning = nil
+      local ok, value, extra = pcall(job, name)
+      local res
+      if not ok and value == EXIT then
+         res = {output = output, had_warning = Item.had_warning, exit = true, code = exit_code}
+      elseif not ok then
+         res = {serial = true}
+      else
+         res = result(value, extra)
+         res.output, res.had_warning = output, Item.had_warning
+      end
+      if not native.submit(idx,res) then
+         native.submit(idx,{serial = true})
+      end
+   end
+   coroutine.yield()
+end
+
+--- worker loop for rendering: `render(name)` returns the text of the page
+-- `name` and any dependencies of it to pass on. Never returns.
+function jobs.serve_pages (render)
+   serve_values(render, function(text, deps)
+      return {page = text, deps = deps}
+   end)
+end
+
+--- worker loop for examples and topics: `prepare(name)` returns what the main
+-- state needs of the file (see `jobs.prepare`). Never returns.
+function jobs.serve_special (prepare)
+   serve_values(prepare, function(special)
+      return {special = special}
+   end)
+end
+
+--- parse `files` using up to `n` workers.
+-- `process(f)` handles a file in the main state, `finish(f,res)` a file
+-- scanned by a worker; either way, files are handled in the given order.
+function jobs.process (files, n, process, finish)
+   local pool = native.start(n, files, {dir = jobs.start_dir, known = known})
+   if not pool then
+      for _, f in ipairs(files) do process(f) end
+      return
+   end
+   jobs.pool = pool
+   for i, f in ipairs(files) do
+      local res = pool:result(i)
+      if res == nil or res.serial then
+         process(f)
+      else
+         finish(f,res)
+      end
+   end
+   jobs.stop()
+end
+
+-- the files as scanned by the main state, if rendering is to be handed out
+local scanned
+
+--- keep a copy of each file the main state scans from now on (see `jobs.scanned`).
+function jobs.keep_scanned ()
+   if jobs.available() then scanned = {} end
+end
+
+--- the file `F` has been scanned from `fname`, with `line` its last line,
+-- and is about to be finished.
+function jobs.scanned (fname, F, line)
+   if not scanned then return end
+   local fargs, flang, warning, error = F.args, F.lang, F.warning, F.error
+   F.args, F.lang, F.warning, F.error = nil, nil, nil, nil
+   local data = native.pack(F)
+   F.args, F.lang, F.warning, F.error = fargs, flang, warning, error
+   if data then
+      scanned[#scanned+1] = {name = fname, line = line, data = data}
+   else -- the pages cannot be rendered elsewhere
+      scanned = nil
+   end
+end
+
+local scanned_by_name
+if jobs.rendering then
+   scanned_by_name = {}
+   for _, s in ipairs(jobs.context.scanned) do
+      scanned_by_name[s.name] = s
+   end
+end
+
+--- on a worker rendering pages: a copy of the file `fname` as the main state
+-- scanned it, and its last line; nil if the worker has to scan it itself.
+function jobs.scanned_file (fname)
+   local s = scanned_by_name and scanned_by_name[fname]
+   if s then
+      return native.unpack(s.data), s.line
+   end
+end
+
+-- what workers prepared of the examples and topics, by job name
+local prepared = {}
+
+--- read the examples and topics `names` using up to `n` workers, where a
+-- name is the class and file of the entity, as in 'example:FILE'. `linemap`
+-- gives the lines of the items of prettified source files. Returns a function
+-- giving the result for `names[i]`, which must be asked for in order, or nil
+-- if the main state has to read the file itself; or nil if the files cannot
+-- be handed out.
+function jobs.prepare (names, n, linemap)
+   if #names < 2 then return nil end
+   local pool = native.start(n, names, {
+      dir = jobs.start_dir, known = known, special = true, linemap = linemap
+   })
+   if not pool then return nil end
+   jobs.pool = pool
+   return function(i)
+      local res = pool:result(i)
+      if res and not res.serial then
+         if scanned then prepared[names[i]] = res.special end
+         return res
+      end
+   end
+end
+
+--- on a worker rendering pages: what was prepared for the example or topic
+-- `name`, if anything.
+function jobs.prepared (name)
+   return jobs.rendering and jobs.context.prepared and jobs.context.prepared[name]
+end
+
+--- render the pages `names` using up to `n` workers. `context` is passed on
+-- to them. Returns a function giving the result for `names[i]`, which must be
+-- asked for in order, or nil if the main state has to render the page itself;
+-- or nil if the pages cannot be handed out.
+function jobs.render (names, n, context)
+   if not scanned or #names < 2 then return nil end
+   context.dir, context.known = jobs.start_dir, known
+   context.scanned, context.prepared = scanned, prepared
+   local pool = native.start(n, names, context)
+   if not pool then return nil end
+   jobs.pool = pool
+   return function(i)
+      local res = pool:result(i)
+      if res and not res.serial then return res end
+   end
+end
+
+--- write out what the worker wrote, and exit if it did.
+function jobs.replay (res)
+   local out = res.output
+   for i = 1, #out, 2 do
+      io[out[i]]:write(out[i+1])
+   end
+   if res.had_warning then Item.had_warning = true end
+   if res.exit then
+      jobs.stop()
+      os.exit(res.code)
+   end
+end
+
+--- wait for all workers to finish.
+function jobs.stop ()
+   if jobs.pool then
+      jobs.pool:stop()
+      jobs.pool = nil
+   end
+end
+
+return jobs
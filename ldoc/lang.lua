@@ -80,9 +80,9 @@ function Lua:_init()
 end
 
 function Lua.lexer(fname)
-   local f,e = io.open(fname)
-   if not f then quit(e) end
-   return lexer.lua(f,{}),f
+   local tok,f = lexer.lua_file(fname,{})
+   if tok == false then quit(f) end
+   return tok,f
 end
 
 function Lua:grab_block_comment(v,tok)
@@ -262,11 +262,10 @@ function CC:_init()
    self:finalize()
 end
 
-function CC.lexer(f)
-   local err
-   f,err = utils.readfile(f)
-   if not f then quit(err) end
-   return lexer.cpp(f,{},nil,true)
+function CC.lexer(fname)
+   local tok,err = lexer.cpp_file(fname,{},nil,true)
+   if tok == false then quit(err) end
+   return tok
 end
 
 function CC:grab_block_comment(v,tok)
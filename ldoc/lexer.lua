@@ -32,6 +32,17 @@ end
 
 local lexer = {}
 
+-- native token streams, available when running under the ldoc launcher
+local ok, native = pcall(require, 'ldoc_lexer')
+if not ok then native = nil end
+
+-- the native streams only do the unfiltered case (which is all that LDoc needs),
+-- for strings and real files
+local function use_native (s,filter)
+    return native and not (filter.space or filter.comments)
+        and (type(s) == 'string' or io.type(s) == 'file')
+end
+
 local NUMBER1 = '^[%+%-]?%d+%.?%d*[eE][%+%-]?%d+'
 local NUMBER2 = '^[%+%-]?%d+%.?%d*'
 local NUMBER3 = '^0x[%da-fA-F]+'
@@ -291,6 +302,9 @@ end
 -- which means convert numbers and strip string quotes.
 function lexer.lua(s,filter,options)
     filter = filter or {space=true,comments=true}
+    if use_native(s,filter) then
+        return native.lua(s,options)
+    end
     lexer.get_keywords()
     if not lua_matches then
         lua_matches = {
@@ -327,6 +341,9 @@ end
 -- which means convert numbers and strip string quotes.
 function lexer.cpp(s,filter,options,no_string)
     filter = filter or {comments=true}
+    if use_native(s,filter) then
+        return native.cpp(s,options,no_string)
+    end
     if not cpp_keyword then
         cpp_keyword = {
             ["class"] = true, ["break"] = true,  ["do"] = true, ["sizeof"] = true,
@@ -412,6 +429,50 @@ function lexer.cpp(s,filter,options,no_string)
       filter,options)
 end
 
+--- create a Lua token iterator for a source file.
+-- Natively, the file is memory-mapped instead of read line by line.
+-- @param fname the file name
+-- @param filter as for `lexer.lua`
+-- @param options as for `lexer.lua`
+-- @return the token iterator (nil for an empty file), and an open file handle
+-- that must be closed when done; or false and an error message.
+function lexer.lua_file(fname,filter,options)
+    filter = filter or {space=true,comments=true}
+    if native and not (filter.space or filter.comments) then
+        local tok,err = native.lua_file(fname,options)
+        if err then return false,err end
+        return tok
+    end
+    local f,err = io.open(fname)
+    if not f then return false,err end
+    return lexer.lua(f,filter,options),f
+end
+
+--- create a C/C++ token iterator for a source file, as if for its contents
+-- (without a UTF-8 BOM).
+-- Natively, the file is memory-mapped instead of read into a string.
+-- @param fname the file name
+-- @param filter as for `lexer.cpp`
+-- @param options as for `lexer.cpp`
+-- @param no_string as for `lexer.cpp`
+-- @return the token iterator (nil for an empty file); or false and an error message.
+function lexer.cpp_file(fname,filter,options,no_string)
+    filter = filter or {comments=true}
+    if native and not (filter.space or filter.comments) then
+        local tok,err = native.cpp_file(fname,options,no_string)
+        if err then return false,err end
+        return tok
+    end
+    local f,err = io.open(fname)
+    if not f then return false,err end
+    local s = f:read('*a')
+    f:close()
+    if s:sub(1,3) == '\239\187\191' then -- UTF-8 BOM, as stripped natively
+        s = s:sub(4)
+    end
+    return lexer.cpp(s,filter,options,no_string)
+end
+
 --- get a list of parameters separated by a delimiter from a stream.
 -- @param tok the token stream
 -- @param endtoken end of list (default ')'). Can be '\n'
@@ -0,0 +1,277 @@
+--------------
+-- Dependency manifest for incremental output (`--incremental`).
+--
+-- For every page written, the manifest records what went into it:
+--
+--  * the contents of the source files of the modules shown on the page
+--    (the page's own module, or every module for the index);
+--  * the 'shape' of every module it links to, i.e. the names that links can
+--    refer to;
+--  * a key for everything all pages share: the template, the options, the
+--    configuration and the navigation list.
+--
+-- A page whose references could not all be resolved also depends on the shape
+-- of all modules, since any new name might resolve them. On the next run, a
+-- page where none of this changed is not rendered again, and its file is not
+-- touched. Pages that gave warnings are always rendered, so that the warnings
+-- are not lost. Pages of the last run that are not part of this one, e.g. of a
+-- module that was removed, are deleted.
+--
+-- The manifest uses the hashing and the entry files of the native `ldoc_cache`
+-- module; without it, slower stand-ins in Lua, which only need to give the
+-- same hash for the same text from one run to the next.
+
+local List = require 'pl.List'
+local tablex = require 'pl.tablex'
+local path = require 'pl.path'
+local utils = require 'pl.utils'
+local pretty = require 'pl.pretty'
+
+local ok, cache = pcall(require, 'ldoc_cache')
+if not ok then
+   -- two 32-bit polynomial hashes of `s` and its length, as hex digits
+   local function hash (s)
+      local h1, h2 = 0, 0
+      for i = 1, #s, 256 do
+         local bytes = {s:byte(i, i + 255)}
+         for j = 1, #bytes do
+            local b = bytes[j]
+            h1 = (h1 * 31 + b) % 4294967296
+            h2 = (h2 * 65599 + b) % 4294967291
+         end
+      end
+      return ('%08x%08x%x'):format(h1, h2, #s)
+   end
+   cache = {
+      hash = hash,
+      hash_file = function (fname)
+         local text = utils.readfile(fname, true)
+         return text and hash(text)
+      end,
+      -- the manifest is written as a Lua table
+      load = function (fname)
+         local text = utils.readfile(fname, true)
+         local chunk = text and utils.load('return '..text, fname, 't', {})
+         if not chunk then return nil end
+         local loaded, value = pcall(chunk)
+         return loaded and value or nil
+      end,
+      store = function (fname, value)
+         return utils.writefile(fname, pretty.write(value, ''), true)
+      end,
+   }
+end
+
+local manifest = {}
+
+local Manifest = {}
+Manifest.__index = Manifest
+
+local function module_key (m)
+   return (m.kind or '')..':'..m.name
+end
+
+--- open the manifest in `fname`.
+-- `key` stands for everything all pages depend on, `modules` is the list of
+-- all modules of the project.
+function manifest.open (fname, key, modules)
+   key = cache.hash(key)
+   local old = cache.load(fname)
+   if type(old) ~= 'table' or type(old.pages) ~= 'table' then
+      old = {pages = {}}
+   end
+   -- whatever the key, these are the pages the last run left behind
+   local last = old.pages
+   if old.key ~= key then
+      old = {pages = {}}
+   end
+   local by_key = {}
+   for _, m in ipairs(modules) do
+      by_key[module_key(m)] = m
+   end
+   return setmetatable({
+      fname = fname, key = key, modules = modules, by_key = by_key,
+      old = old.pages, pages = {}, last = last, seen = {},
+      file_hashes = {}, shapes = {}, contents = {},
+   }, Manifest)
+end
+
+--- the names in a module that links can refer to.
+function Manifest:shape (m)
+   local key = module_key(m)
+   local shape = self.shapes[key]
+   if not shape then
+      local names = List{m.kind or '', m.name, m.type or ''}
+      for item in m.items:iter() do
+         names:append(item.name or '')
+         names:append(item.type or '')
+      end
+      if m.sections then
+         for section in m.sections:iter() do
+            names:append(section.name or '')
+         end
+      end
+      shape = cache.hash(names:concat '\0')
+      self.shapes[key] = shape
+   end
+   return shape
+end
+
+--- the contents of the source files a module was made from.
+function Manifest:content (m)
+   local key = module_key(m)
+   local content = self.contents[key]
+   if not content then
+      local files = {}
+      local function add (F)
+         if F and F.filename then files[F.filename] = true end
+      end
+      add(m.file)
+      for item in m.items:iter() do
+         add(item.file)
+      end
+      local names = tablex.keys(files)
+      table.sort(names)
+      local parts = List()
+      for _, f in ipairs(names) do
+         local hash = self.file_hashes[f]
+         if not hash then
+            hash = cache.hash_file(f) or ''
+            self.file_hashes[f] = hash
+         end
+         parts:append(f)
+         parts:append(hash)
+      end
+      content = cache.hash(parts:concat '\0')
+      self.contents[key] = content
+   end
+   return content
+end
+
+function Manifest:inputs (modules, unresolved)
+   local parts = List()
+   for _, m in ipairs(modules) do
+      parts:append(module_key(m))
+      parts:append(self:content(m))
+   end
+   if unresolved then
+      if not self.all_shapes then
+         local shapes = List()
+         for _, m in ipairs(self.modules) do
+            shapes:append(module_key(m))
+            shapes:append(self:shape(m))
+         end
+         self.all_shapes = cache.hash(shapes:concat '\0')
+      end
+      parts:append(self.all_shapes)
+   end
+   return cache.hash(parts:concat '\0')
+end
+
+--- can the existing file of `page`, showing `modules`, be left alone?
+-- `unresolved` is true if the modules have unresolved @see references.
+function Manifest:fresh (page, file, modules, unresolved)
+   self.seen[page] = true
+   local old = self.old[page]
+   if not old or not path.isfile(file) then return false end
+   if old.inputs ~= self:inputs(modules, unresolved or old.unresolved) then
+      return false
+   end
+   for key, shape in pairs(old.links) do
+      local m = self.by_key[key]
+      if not m or self:shape(m) ~= shape then return false end
+   end
+   self.pages[page] = old
+   return true
+end
+
+--- start recording the dependencies of `page`.
+function Manifest:start (page, modules, unresolved)
+   self.seen[page] = true
+   self.current = {page = page, modules = modules, unresolved = unresolved, links = {}}
+end
+
+--- the page being rendered links to module `m`.
+function Manifest:link (m)
+   local current = self.current
+   if current and m and m.name then
+      current.links[module_key(m)] = self:shape(m)
+   end
+end
+
+--- the page being rendered has a reference that cannot be resolved.
+function Manifest:unresolved ()
+   if self.current then self.current.unresolved = true end
+end
+
+--- done with the page; `keep` is false if it has to be rendered next time anyway.
+function Manifest:finish (keep)
+   local current = self.current
+   self.current = nil
+   if keep then
+      self.pages[current.page] = {
+         inputs = self:inputs(current.modules, current.unresolved),
+         unresolved = current.unresolved,
+         links = current.links,
+      }
+   else -- still a page of the project, which is never fresh
+      self.pages[current.page] = {links = {}}
+   end
+end
+
+--- add the dependencies a recorder noted for the current page.
+function Manifest:replay (deps)
+   local current = self.current
+   if not current then return end
+   for _, key in ipairs(deps.links) do
+      local m = self.by_key[key]
+      -- a module outside the project never leaves the page alone
+      current.links[key] = m and self:shape(m) or false
+   end
+   if deps.unresolved then current.unresolved = true end
+end
+
+local Recorder = {}
+Recorder.__index = Recorder
+
+--- a stand-in for the manifest on a worker state rendering pages (see ldoc.jobs),
+-- which notes the dependencies of each page for `Manifest:replay` in the main
+-- state.
+function manifest.recorder ()
+   return setmetatable({links = List()}, Recorder)
+end
+
+--- start noting the dependencies of a page.
+function Recorder:start ()
+   self.links, self.has_unresolved = List(), false
+end
+
+function Recorder:link (m)
+   if m and m.name then self.links:append(module_key(m)) end
+end
+
+function Recorder:unresolved ()
+   self.has_unresolved = true
+end
+
+--- the dependencies noted since `start`.
+function Recorder:dependencies ()
+   return {links = self.links, unresolved = self.has_unresolved}
+end
+
+--- write the manifest, with the pages rendered or left alone in this run,
+-- and remove the pages of the last run that are gone.
+function Manifest:save ()
+   local dir = path.dirname(self.fname)
+   for page in pairs(self.last) do
+      if not self.seen[page] and type(page) == 'string' and not page:find '%.%.' then
+         os.remove(path.join(dir, page))
+      end
+   end
+   local ok, err = cache.store(self.fname, {key = self.key, pages = self.pages})
+   if not ok then
+      io.stderr:write('could not write ', self.fname, ': ', err, '\n')
+   end
+end
+
+return manifest
@@ -11,9 +11,37 @@ local concat = table.concat
 local markup = {}
 
 local backtick_references
+local global_context, local_context
+
+-- the references left for a final pass (see markup.defer_references)
+local deferred
+
+-- each reference in `txt` becomes a placeholder with the tags of the link it
+-- will be resolved to, so that the formatter treats the two alike
+local function defer_inline_references (txt, plain)
+   local function placeholder (text)
+      deferred[#deferred+1] = {text = text, context = local_context, plain = plain}
+      return '<a>\1'..#deferred..'\2</a>'
+   end
+   local res = txt:gsub('@{([^}]-)}',function (name)
+      if name:match '^\\' then return '@{'..name:sub(2)..'}' end
+      return placeholder('@{'..name..'}')
+   end)
+   if backtick_references then
+      res = res:gsub('`([^`]+)`',function(name)
+         -- references inside are resolved together with the code
+         name = name:gsub('<a>\1(%d+)\2</a>',function(i)
+            return deferred[tonumber(i)].text
+         end)
+         return placeholder('`'..name..'`')
+      end)
+   end
+   return res
+end
 
 -- inline <references> use same lookup as @see
 local function resolve_inline_references (ldoc, txt, item, plain)
+   if deferred then return defer_inline_references(txt, plain) end
    local do_escape = not plain and not ldoc.dont_escape_underscore
    local res = (txt:gsub('@{([^}]-)}',function (name)
       if name:match '^\\' then return '@{'..name:sub(2)..'}' end
@@ -71,13 +99,15 @@ end
 
 -- for readme text, the idea here is to create module sections at ## so that
 -- they can appear in the contents list as a ToC.
-function markup.add_sections(F, txt)
-   local sections, L, first = {}, 1, true
-   local title_pat
+-- The titles of these sections as {line, title}, and the first header.
+function markup.section_titles(txt)
+   local titles, L, first = {}, 1, true
+   local title_pat, header
    local lstrip = stringx.lstrip
    for line in stringx.lines(txt) do
       if first then
-         local level,header = line:match '^(#+)%s*(.+)'
+         local level
+         level,header = line:match '^(#+)%s*(.+)'
          if level then
             level = level .. '#'
          else
@@ -86,7 +116,6 @@ function markup.add_sections(F, txt)
          title_pat = '^'..level..'([^#]%s*.+)'
          title_pat = lstrip(title_pat)
          first = false
-         F.display_name = header
       end
       local title = line:match (title_pat)
       if title then
@@ -94,10 +123,23 @@ function markup.add_sections(F, txt)
          title = title:gsub('\r$','')
          -- Markdown allows trailing '#'...
          title = title:gsub('%s*#+$','')
-         sections[L] = F:add_document_section(lstrip(title))
+         titles[#titles+1] = {L, lstrip(title)}
       end
       L = L + 1
    end
+   return titles, header
+end
+
+-- `titles` and `header` may already be known from `markup.section_titles`.
+function markup.add_sections(F, txt, titles, header)
+   local sections = {}
+   if not titles then
+      titles, header = markup.section_titles(txt)
+   end
+   F.display_name = header
+   for _, t in ipairs(titles) do
+      sections[t[1]] = F:add_document_section(t[2])
+   end
    F.sections = sections
    return txt
 end
@@ -112,8 +154,6 @@ local function blank (line)
    return not line:find '%S'
 end
 
-local global_context, local_context
-
 -- before we pass Markdown documents to markdown/discount, we need to do three things:
 -- - resolve any @{refs} and (optionally) `refs`
 -- - any @lookup directives that set local context for ref lookup
@@ -220,6 +260,15 @@ end
 -- Try to get the one the user has asked for, but if it's not available,
 -- try all the others we know about.  If they don't work, fall back to text.
 
+-- the formatter topics may be formatted with, before their references are
+-- resolved (see markup.defer_references); it must leave the placeholders be
+local inline_formatter
+
+-- the HTML of a reference resolved after formatting, formatted on its own
+local function format_inline (html)
+   return (inline_formatter(html):gsub('^%s*<p>(.+)</p>%s*$','%1'))
+end
+
 local function generic_formatter(format)
    local ok, f = pcall(require, format)
    return ok and f
@@ -280,6 +329,16 @@ local formatters =
          return function(text) return parse(text) end
       end
    end,
+   native = function(format)
+      -- the Markdown renderer built into the launcher
+      local ok, markdown = pcall(require, 'ldoc_markdown')
+      if ok then
+         return markdown.render
+      end
+      print('format: using built-in markdown')
+      ok, markdown = pcall(require, 'ldoc.markdown')
+      return ok and markdown
+   end,
    commonmark = function(format)
      local ok, cmark = pcall(require, 'cmark')
      if ok then
@@ -359,6 +418,9 @@ local function get_processor(ldoc, format)
       if ldoc.dont_escape_underscore ~= nil then
          ldoc.dont_escape_underscore = actual_format ~= 'markdown'
       end
+      if actual_format == 'markdown' or actual_format == 'native' then
+         inline_formatter = formatter
+      end
       return markdown_processor(ldoc, formatter)
    end
 
@@ -416,7 +478,58 @@ function markup.create (ldoc, format, pretty, user_keywords)
    prettify.resolve_inline_references = function(txt, errfn)
       return resolve_inline_references(ldoc, txt, errfn, true)
    end
+
+   --- the final pass over a topic formatted with its references deferred:
+   -- resolve them in `html` as if they had been resolved before formatting.
+   -- Returns nil if a reference cannot be resolved, or was not formatted as
+   -- expected; the topic must then be formatted again, which reports it.
+   markup.resolve_deferred = function(html, refs)
+      local failed
+      local reporter = {warning = function() failed = true end}
+      local formatted = {}
+      html = html:gsub('<a>\1(%d+)\2</a>', function(i)
+         local ref = refs[tonumber(i)]
+         local_context = ref.context
+         local res = resolve_inline_references(ldoc, ref.text, reporter, ref.plain)
+         if not ref.plain then
+            formatted[res] = formatted[res] or format_inline(res)
+            res = formatted[res]
+         end
+         return res
+      end)
+      local_context = refs.context
+      if failed or html:find '[\1\2]' then return nil end
+      return html
+   end
    return processor
 end
 
+--- can the topic text `txt` be formatted before the project is known, with
+-- its references deferred? Not with a formatter that might not leave the
+-- placeholders be, nor where a reference is not formatted like the text
+-- around it: in raw HTML blocks, or in code spans when backticks are not
+-- references.
+function markup.can_defer (txt)
+   return inline_formatter ~= nil and not txt:find '[\1\2]'
+      and not ('\n'..txt):find '\n<'
+      and (backtick_references or not txt:find '`')
+end
+
+--- format from now on with placeholders in place of the references, for
+-- `markup.resolve_deferred`; they need the project, which workers of `--jobs`
+-- preparing topics do not have. A reference resolves to a link, or to code
+-- for backticks, which the formatter handles like the placeholder's tags.
+function markup.defer_references ()
+   deferred = {}
+end
+
+--- stop deferring references, and return those deferred.
+function markup.deferred_references ()
+   local refs = deferred
+   deferred = nil
+   -- the lookup context the topic leaves behind
+   refs.context = local_context
+   return refs
+end
+
 return markup
@@ -10,6 +10,10 @@ local doc = require 'ldoc.doc'
 local Item,File = doc.Item,doc.File
 local unpack = utils.unpack
 
+-- the launcher splits comments into tags natively (see native/ldoc_tags.cpp)
+local ok, native = pcall(require, 'ldoc_tags')
+if not ok then native = nil end
+
 ------ Parsing the Source --------------
 -- This uses the lexer from PL, but it should be possible to use Peter Odding's
 -- excellent Lpeg based lexer instead.
@@ -177,9 +181,15 @@ local function extract_tags (s,args)
    local preamble,tag_items
    if s:match '^%s*$' then return {} end
    if args.colon then --and s:match ':%s' and not s:match '@%a' then
-      preamble,tag_items = parse_colon_tags(s)
+      if native then
+         preamble,tag_items = native.scan(s,true)
+      else
+         preamble,tag_items = parse_colon_tags(s)
+      end
    elseif args.lls then
       preamble, tag_items = parse_lls_tags(s)
+   elseif native then
+      preamble,tag_items = native.scan(s,false)
    else
       preamble,tag_items = parse_at_tags(s)
    end
@@ -214,6 +224,21 @@ end
 -- encountered, then ldoc looks for a call to module() to find the name of the
 -- module if there isn't an explicit module name specified.
 
+-- warnings and errors refer to the current line of the file being parsed
+local function add_file_handlers (F,fname,lineno)
+   function F:warning (msg,kind,line)
+      line = line or lineno()
+      Item.had_warning = true
+      io.stderr:write(fname..':'..line..': '..msg,'\n')
+   end
+
+   function F:error (msg)
+      self:warning(msg,'error')
+      io.stderr:write('LDoc error\n')
+      os.exit(1)
+   end
+end
+
 local function parse_file(fname, lang, package, args)
    local F = File(fname)
    local module_found, first_comment = false,true
@@ -230,17 +255,7 @@ local function parse_file(fname, lang, package, args)
       return tok:lineno()
    end
 
-   function F:warning (msg,kind,line)
-      line = line or lineno()
-      Item.had_warning = true
-      io.stderr:write(fname..':'..line..': '..msg,'\n')
-   end
-
-   function F:error (msg)
-      self:warning(msg,'error')
-      io.stderr:write('LDoc error\n')
-      os.exit(1)
-   end
+   add_file_handlers(F,fname,lineno)
 
    local function add_module(tags,module_found,old_style)
       tags:add('name',module_found)
@@ -461,14 +476,32 @@ local function parse_file(fname, lang, package, args)
    end,debug.traceback)
    if not ok then return F, err end
    if f then f:close() end
-   return F
+   return F, nil, lineno()
+end
+
+-- The two halves of `parse.file`, so that the scanning can happen elsewhere
+-- (see ldoc.jobs). `scan_file` also returns the last line of the file.
+function parse.scan_file(name,lang,args)
+   return parse_file(name,lang,args.package,args)
+end
+
+function parse.finish_file(F)
+   local ok,err = xpcall(function() F:finish() end,debug.traceback)
+   if not ok then return err end
+end
+
+-- reattach what a scanned file cannot carry over from another state
+function parse.restore_file(F,lang,args,line)
+   F.args = args
+   F.lang = lang
+   add_file_handlers(F,F.filename,function() return line end)
 end
 
 function parse.file(name,lang, args)
-   local F,err = parse_file(name,lang,args.package,args)
+   local F,err = parse.scan_file(name,lang,args)
    if err or not F then return F,err end
-   local ok,err = xpcall(function() F:finish() end,debug.traceback)
-   if not ok then return F,err end
+   err = parse.finish_file(F)
+   if err then return F,err end
    return F
 end
 
@@ -5,7 +5,7 @@
 -- `@{example:test-fun}`.
 local List = require 'pl.List'
 local tablex = require 'pl.tablex'
-local globals = require 'ldoc.builtin.globals'
+local globals -- ldoc.builtin.globals, loaded when code is first prettified
 local prettify = {}
 
 local user_keywords = {}
@@ -25,9 +25,17 @@ local escaped_chars = {
 local escape_pat = '[&<>]'
 
 local function escape(str)
-   return (str:gsub(escape_pat,escaped_chars))
+   return (string.gsub(str,escape_pat,escaped_chars))
 end
 
+local ok, native_html = pcall(require, 'ldoc_html')
+if ok then escape = native_html.escape_code end
+
+-- the launcher's lexer can also do the highlighting, straight into one string
+local native
+ok, native = pcall(require, 'ldoc_lexer')
+if not ok or not native.highlight then native = nil end
+
 local function span(t,val)
    return ('<span class="%s">%s</span>'):format(t,val)
 end
@@ -36,7 +44,70 @@ local spans = {keyword=true,number=true,string=true,comment=true,global=true,bac
 
 local cpp_lang = {C = true, c = true, cpp = true, cxx = true, h = true}
 
+-- the @{refs} left for a final pass (see prettify.defer_references)
+local deferred
+
+local function resolve (val, reporter)
+   if not deferred then
+      return prettify.resolve_inline_references(val,reporter)
+   end
+   if not val:find '@{' and not val:find '`' then return val end
+   -- line ends stay, so that the last comment can be trimmed as usual
+   local text, eol = val:match '^(.-)([\r\n]*)$'
+   deferred[#deferred+1] = {text = text, where = reporter:where()}
+   return '\1'..#deferred..'\2'..eol
+end
+
+--- leave the @{refs} in the code prettified from now on as placeholders,
+-- for `prettify.resolve_deferred`; they need the project, which workers of
+-- `--jobs` preparing examples do not have. The code must not contain the
+-- bytes 1 and 2.
+function prettify.defer_references ()
+   deferred = {}
+end
+
+--- stop deferring @{refs}, and return those deferred.
+function prettify.deferred_references ()
+   local refs = deferred
+   deferred = nil
+   return refs
+end
+
+--- the final pass: resolve the `refs` deferred in `html`, as if they had been
+-- resolved while prettifying.
+function prettify.resolve_deferred (html, refs)
+   return (html:gsub('\1(%d+)\2', function(i)
+      local ref = refs[tonumber(i)]
+      return prettify.resolve_inline_references(ref.text, {
+         warning = function (self,msg)
+            io.stderr:write(ref.where..': '..msg,'\n')
+         end
+      })
+   end))
+end
+
+local function highlight (lang, fname, code, initial_lineno, pre, linenos)
+   local lineno
+   local error_reporter = {
+      where = function ()
+         return fname..':'..lineno+initial_lineno
+      end,
+      warning = function (self,msg)
+         io.stderr:write(self:where()..': '..msg,'\n')
+      end
+   }
+   return native.highlight(code, cpp_lang[lang], pre, linenos, globals, user_keywords,
+      function (val, line)
+         lineno = line
+         return resolve(val,error_reporter)
+      end)
+end
+
 function prettify.lua (lang, fname, code, initial_lineno, pre, linenos)
+   globals = globals or require 'ldoc.builtin.globals'
+   if native and type(code) == 'string' then
+      return highlight(lang, fname, code, initial_lineno or 0, pre, linenos)
+   end
    local res, lexer = List(), require 'ldoc.lexer'
    local tokenizer
    local ik = 1
@@ -53,8 +124,11 @@ function prettify.lua (lang, fname, code, initial_lineno, pre, linenos)
 
    local tok = tokenizer(code,{},{})
    local error_reporter = {
+      where = function ()
+         return fname..':'..tok:lineno()+initial_lineno
+      end,
       warning = function (self,msg)
-         io.stderr:write(fname..':'..tok:lineno()+initial_lineno..': '..msg,'\n')
+         io.stderr:write(self:where()..': '..msg,'\n')
       end
    }
    local last_t, last_val
@@ -75,7 +149,7 @@ function prettify.lua (lang, fname, code, initial_lineno, pre, linenos)
          res:append(span('user-keyword keyword-' .. val,val))
       elseif spans[t] then
          if t == 'comment' or t == 'backtick' then -- may contain @{ref} or `..`
-            val = prettify.resolve_inline_references(val,error_reporter)
+            val = resolve(val,error_reporter)
          end
          res:append(span(t,val))
       else
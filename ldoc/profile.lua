@@ -0,0 +1,144 @@
+--------------
+-- Profiling a run (`--profile`).
+--
+-- The main phases of a run are timed by wrapping the functions that do them
+-- (see `profile.wrap`); a phase that runs inside another one is only counted
+-- as 'self' time of the inner phase. At the same time the native
+-- `ldoc_profile` module of the launcher samples the Lua call stack, which
+-- gives the time spent per function. When the run ends, both are reported on
+-- stderr, and with `--profile_stacks FILE` the samples are also written in the
+-- collapsed form used by flamegraph tools.
+--
+-- Without the native module, phases are timed with `os.clock` and there are no
+-- samples.
+--
+-- The phases are also what `--stats` reports the allocations of (see
+-- ldoc.stats); then they are tracked without being timed or reported here.
+
+local List = require 'pl.List'
+local utils = require 'pl.utils'
+
+local ok, native = pcall(require, 'ldoc_profile')
+if not ok then native = nil end
+
+local profile = {}
+
+local clock = native and native.clock or os.clock
+local active, timing, reported = false, false, false
+local started, sampler, stacks_file
+local memory -- the native ldoc_stats, if allocations are counted
+local phases, order = {}, List()
+local running = {}
+
+--- start profiling; `stacks` is a file for the sampled stacks, or nil.
+function profile.start (stacks)
+   active = true
+   timing = true
+   stacks_file = stacks
+   started = clock()
+   if native then sampler = native.start() end
+   local exit = os.exit
+   function os.exit (...)
+      profile.report()
+      return exit(...)
+   end
+end
+
+--- track the phases for `--stats` as well; `stats` is the native ldoc_stats.
+function profile.count_memory (stats)
+   active = true
+   memory = stats
+end
+
+local function enter (name)
+   local phase = phases[name]
+   if not phase then
+      phase = {total = 0, self = 0, calls = 0, depth = 0, allocations = 0, bytes = 0, peak = 0}
+      phases[name] = phase
+      order:append(name)
+   end
+   phase.depth = phase.depth + 1
+   local frame = {phase = phase, start = clock(), inner = 0}
+   if memory then
+      frame.allocations, frame.bytes = memory.memory()
+      frame.peak = memory.reset_peak()
+   end
+   running[#running+1] = frame
+end
+
+local function leave (...)
+   local frame = table.remove(running)
+   local phase, t = frame.phase, clock() - frame.start
+   phase.depth = phase.depth - 1
+   -- a phase that calls itself only counts once
+   if phase.depth == 0 then phase.total = phase.total + t end
+   if memory then
+      local allocations, bytes, _, peak = memory.memory()
+      if phase.depth == 0 then
+         phase.allocations = phase.allocations + allocations - frame.allocations
+         phase.bytes = phase.bytes + bytes - frame.bytes
+      end
+      phase.peak = math.max(phase.peak, peak)
+      memory.raise_peak(frame.peak)
+   end
+   phase.self = phase.self + t - frame.inner
+   phase.calls = phase.calls + 1
+   local outer = running[#running]
+   if outer then outer.inner = outer.inner + t end
+   return ...
+end
+
+--- `f`, timed as part of the phase `name` if profiling.
+function profile.wrap (name, f)
+   if not active then return f end
+   return function(...)
+      enter(name)
+      return leave(f(...))
+   end
+end
+
+local function write_stacks (stacks)
+   local lines = List()
+   for stack, n in pairs(stacks) do
+      lines:append(stack..' '..n)
+   end
+   lines:sort()
+   lines:append ''
+   if not utils.writefile(stacks_file, lines:concat '\n') then
+      io.stderr:write('profile: cannot write ', stacks_file, '\n')
+   end
+end
+
+--- the names of the phases in the order they were entered, and the phases by
+-- name, each with `total`, `self` and `calls`, and `allocations`, `bytes` and
+-- `peak` if allocations are counted.
+function profile.phases ()
+   return order, phases
+end
+
+--- print the report; called when the run is over.
+function profile.report ()
+   if not timing or reported then return end
+   reported = true
+   local out = io.stderr
+   local total = clock() - started
+   out:write(('profile: %.3f s\n'):format(total))
+   out:write(('  %-24s %10s %10s %8s\n'):format('phase', 'total s', 'self s', 'calls'))
+   for name in order:iter() do
+      local phase = phases[name]
+      out:write(('  %-24s %10.3f %10.3f %8d\n'):format(name, phase.total, phase.self, phase.calls))
+   end
+   if not sampler then return end
+   local samples = sampler:stop()
+   local n = samples.samples
+   if n == 0 then return end
+   out:write(('  %d samples, one per %g ms\n'):format(n, samples.interval * 1000))
+   out:write(('  %7s %7s  %s\n'):format('self', 'total', 'function'))
+   for i = 1, math.min(25, #samples.functions) do
+      local f = samples.functions[i]
+      out:write(('  %6.1f%% %6.1f%%  %s\n'):format(100*f.self/n, 100*f.total/n, f.name))
+   end
+   if stacks_file then write_stacks(samples.stacks) end
+end
+
+return profile
@@ -0,0 +1,145 @@
+--------------
+-- Client-side search of the generated pages (`--search`).
+--
+-- The modules and items of the project are written to `search_index.js` in
+-- the output directory, which the builtin lookup script `search.js` (see
+-- ldoc/html/search_js.lua) loads into a search box on every page. So the
+-- pages can be searched without any server, also from disk.
+--
+-- The index is a call `ldoc_search_index{...}` with a JSON object of
+--
+--  * `kinds`: the distinct kinds of the entries, e.g. 'module', 'function';
+--  * `entries`: `[name, module, kind, href, summary]` per module and item, where
+--    `module` is the index of the entry of an item's module (or -1), `kind` is
+--    an index into `kinds` and `href` is relative to the output directory;
+--  * `terms`: the sorted words of the names, parameters and summaries, all in
+--    lower case; names with underscores also give their parts;
+--  * `postings`: for every term, the entries it occurs in, as the first index
+--    followed by the differences to the previous one.
+--
+-- Lookups go by prefix, which the sorted terms allow by binary search.
+-- The index is built by the native `ldoc_search` module if it is there; the
+-- Lua version here gives the same text.
+
+local List = require 'pl.List'
+
+local ok, native = pcall(require, 'ldoc_search')
+if not ok then native = nil end
+
+local search = {}
+
+local SUMMARY_LENGTH = 120
+
+-- the summary of a module or item as plain text
+local function plain (text)
+   if type(text) ~= 'string' then return '' end
+   text = text:gsub('@{([^}|]*)|?([^}]*)}', function(ref, label)
+      return label ~= '' and label or ref
+   end)
+   text = text:gsub('<[^>]*>', ''):gsub('[`*]', ''):gsub('%s+', ' ')
+   text = text:match '^%s*(.-)%s*$'
+   if #text > SUMMARY_LENGTH then
+      local cut = text:sub(1, SUMMARY_LENGTH)
+      text = (cut:match '^(.*%S)%s+%S*$' or cut)..'...'
+   end
+   return text
+end
+
+--- the entries for the modules of `project`, in the order of the index page.
+-- `href(mod)` is the link to the page of `mod` from the index page.
+function search.entries (project, href)
+   local entries = List()
+   for _, modules in project() do
+      for m in modules() do
+         local page = href(m)
+         entries:append {name = m.name, kind = m.type, href = page, summary = plain(m.summary)}
+         local mod = #entries
+         for item in m.items:iter() do
+            local params = {}
+            if item.params then
+               for p in item.params:iter() do params[#params+1] = tostring(p) end
+            end
+            entries:append {
+               name = item.name, kind = item.type, href = page..'#'..item.name,
+               summary = plain(item.summary), module = mod, params = params,
+            }
+         end
+      end
+   end
+   return entries
+end
+
+local function json_string (s)
+   return '"'..s:gsub('[%c"\\]', function(c)
+      if c == '"' or c == '\\' then return '\\'..c end
+      return ('\\u%04x'):format(c:byte())
+   end)..'"'
+end
+
+-- the terms of `s` with at least `min` bytes
+local function add_terms (postings, s, entry, min)
+   local function add (term)
+      if #term < min then return end
+      local list = postings[term]
+      if not list then
+         list = {}
+         postings[term] = list
+      end
+      if list[#list] ~= entry then list[#list+1] = entry end
+   end
+   for word in s:lower():gmatch '[%w_\128-\255]+' do
+      add(word)
+      if word:find '_' then
+         for part in word:gmatch '[^_]+' do add(part) end
+      end
+   end
+end
+
+local function build (entries)
+   local kinds, kind_index = {}, {}
+   local postings = {}
+   local out = List{'ldoc_search_index({"version":1,\n"entries":['}
+   for i, e in ipairs(entries) do
+      local kind = kind_index[e.kind]
+      if not kind then
+         kinds[#kinds+1] = e.kind
+         kind = #kinds - 1
+         kind_index[e.kind] = kind
+      end
+      out:append((i > 1 and ',\n' or '\n')..('[%s,%d,%d,%s,%s]'):format(json_string(e.name),
+         e.module and e.module - 1 or -1, kind, json_string(e.href), json_string(e.summary or '')))
+      add_terms(postings, e.name, i - 1, 1)
+      for _, p in ipairs(e.params or {}) do add_terms(postings, p, i - 1, 1) end
+      add_terms(postings, e.summary or '', i - 1, 2)
+   end
+   local terms = {}
+   for t in pairs(postings) do terms[#terms+1] = t end
+   table.sort(terms)
+   for i, k in ipairs(kinds) do kinds[i] = json_string(k) end
+   local lists = {}
+   for i, t in ipairs(terms) do
+      local list, deltas, last = postings[t], {}, 0
+      for j, entry in ipairs(list) do
+         deltas[j] = entry - last
+         last = entry
+      end
+      lists[i] = '['..table.concat(deltas, ',')..']'
+      terms[i] = json_string(t)
+   end
+   out:append '],\n"kinds":['
+   out:append(table.concat(kinds, ','))
+   out:append '],\n"terms":['
+   out:append(table.concat(terms, ','))
+   out:append '],\n"postings":['
+   out:append(table.concat(lists, ','))
+   out:append ']});\n'
+   return out:concat()
+end
+
+--- the text of `search_index.js` for `entries` (see `search.entries`).
+function search.index (entries)
+   if native then return native.build(entries) end
+   return build(entries)
+end
+
+return search
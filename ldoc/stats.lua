@@ -0,0 +1,161 @@
+--------------
+-- Memory use and counts of a run (`--stats`), and the memory cap (`--max_memory`).
+--
+-- The launcher counts every allocation of its Lua states (the workers of
+-- `--jobs` included), which the native `ldoc_stats` module reads. The phases
+-- of ldoc.profile show where the memory goes: for each, the allocations and
+-- bytes allocated while it ran, and the peak of the bytes in use. Besides, the
+-- run counts its files, modules, items, resolved references, rendered pages
+-- and the bytes of output written.
+--
+-- `--stats table` prints all this on stderr; `--stats json` prints it as JSON,
+-- and `--stats FILE.json` writes that to a file.
+--
+-- Without the native module there are only the counts and the memory of the
+-- Lua state at the end, and `--max_memory` cannot be enforced.
+
+local List = require 'pl.List'
+local utils = require 'pl.utils'
+local profile = require 'ldoc.profile'
+
+local ok, native = pcall(require, 'ldoc_stats')
+if not ok then native = nil end
+
+local stats = {}
+
+local format, reported
+local counts, count_order = {}, List()
+
+local MB = 1024 * 1024
+
+--- limit the memory of all Lua states to `mb` megabytes.
+-- Returns true, or nil and an error.
+function stats.limit (mb)
+   if not native then return nil, '--max_memory needs the ldoc launcher' end
+   native.set_limit(math.floor(mb * MB))
+   return true
+end
+
+--- start counting; `fmt` is 'table', 'json' or the name of a JSON file.
+function stats.start (fmt)
+   if fmt ~= 'table' and fmt ~= 'json' and not fmt:match '%.json$' then
+      utils.quit("--stats must be 'table', 'json' or a .json file")
+   end
+   format = fmt
+   if native then profile.count_memory(native) end
+   local exit = os.exit
+   function os.exit (...)
+      stats.report()
+      return exit(...)
+   end
+end
+
+--- are the stats being collected?
+function stats.active ()
+   return format ~= nil
+end
+
+--- add `n` (default 1) to the count `name`.
+function stats.count (name, n)
+   if not format then return end
+   if not counts[name] then
+      counts[name] = 0
+      count_order:append(name)
+   end
+   counts[name] = counts[name] + (n or 1)
+end
+
+-- all of it as one table
+local function collect ()
+   local res = {counts = {}, phases = {}}
+   for name in count_order:iter() do res.counts[name] = counts[name] end
+   if native then
+      local allocations, bytes, current, peak = native.memory()
+      res.memory = {allocations = allocations, bytes = bytes, current = current, peak = peak}
+      local order, phases = profile.phases()
+      for name in order:iter() do
+         local p = phases[name]
+         res.phases[#res.phases+1] = {name = name, calls = p.calls,
+            allocations = p.allocations, bytes = p.bytes, peak = p.peak}
+      end
+   else
+      res.memory = {current = math.floor(collectgarbage 'count' * 1024)}
+   end
+   if #res.phases == 0 then res.phases = nil end
+   return res
+end
+
+local function json (v, out)
+   local t = type(v)
+   if t == 'table' then
+      if #v > 0 then
+         out:append '['
+         for i, x in ipairs(v) do
+            if i > 1 then out:append ',' end
+            json(x, out)
+         end
+         out:append ']'
+      else
+         local keys = {}
+         for k in pairs(v) do keys[#keys+1] = k end
+         table.sort(keys)
+         out:append '{'
+         for i, k in ipairs(keys) do
+            if i > 1 then out:append ',' end
+            json(k, out)
+            out:append ':'
+            json(v[k], out)
+         end
+         out:append '}'
+      end
+   elseif t == 'string' then
+      out:append('"'..v:gsub('[%c"\\]', function(c)
+         return ('\\u%04x'):format(c:byte())
+      end)..'"')
+   else
+      out:append(tostring(v))
+   end
+end
+
+local function mb (bytes)
+   return ('%.1f'):format(bytes / MB)
+end
+
+local function write_table (res, out)
+   local parts = List()
+   for name in count_order:iter() do parts:append(res.counts[name]..' '..name:gsub('_', ' ')) end
+   out:write('stats: ', parts:concat ', ', '\n')
+   local m = res.memory
+   if not m.peak then
+      out:write(('  memory: %s MB in use\n'):format(mb(m.current)))
+      return
+   end
+   out:write(('  memory: %s MB peak, %s MB in use, %d allocations of %s MB\n'):format(
+      mb(m.peak), mb(m.current), m.allocations, mb(m.bytes)))
+   if not res.phases then return end
+   out:write(('  %-24s %12s %12s %10s\n'):format('phase', 'allocations', 'alloc MB', 'peak MB'))
+   for _, p in ipairs(res.phases) do
+      out:write(('  %-24s %12d %12s %10s\n'):format(p.name, p.allocations, mb(p.bytes), mb(p.peak)))
+   end
+end
+
+--- print or write the stats; called when the run is over.
+function stats.report ()
+   if not format or reported then return end
+   reported = true
+   local res = collect()
+   if format == 'table' then
+      write_table(res, io.stderr)
+      return
+   end
+   local out = List()
+   json(res, out)
+   out:append '\n'
+   if format == 'json' then
+      io.stderr:write(out:concat())
+   elseif not utils.writefile(format, out:concat()) then
+      io.stderr:write('stats: cannot write ', format, '\n')
+   end
+end
+
+return stats
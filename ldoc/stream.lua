@@ -0,0 +1,94 @@
+--------------
+-- Streaming output of the index page (`--stream`).
+--
+-- Normally a page is rendered into one string by `pl.template`, which is then
+-- cleaned up and written. For a single-page output of a big project these
+-- strings get huge, so with `--stream` the template is compiled here instead,
+-- into a function that hands every piece of text to a sink as soon as it is
+-- produced. The sink is a file stream of the native `ldoc_output` module,
+-- which also does the cleanup of `cleanup_whitespaces` on the way.
+--
+-- The template syntax is that of `pl.template`: lines starting with the escape
+-- character (`#`, or `template_escape`) are Lua code, and `$(expr)` inserts
+-- the value of an expression. As there, the code only sees the names of the
+-- environment it is rendered in.
+--
+-- Without the native module, `--stream` is ignored.
+
+local utils = require 'pl.utils'
+
+local ok, native = pcall(require, 'ldoc_output')
+if not ok or not native.stream then native = nil end
+
+local stream = {}
+
+local PUT = '\n__R_put('
+
+local function parse_dollar_paren (pieces, chunk, exec_pat)
+   local s = 1
+   for term, executed, e in chunk:gmatch(exec_pat) do
+      executed = '('..executed:sub(2,-2)..')'
+      pieces[#pieces+1] = PUT..('%q'):format(chunk:sub(s, term - 1))..')'
+      pieces[#pieces+1] = PUT..'__tostring('..executed.." or ''))"
+      s = e
+   end
+   local r = ('%q'):format(chunk:sub(s))
+   if r ~= '""' then
+      pieces[#pieces+1] = PUT..r..')'
+   end
+end
+
+local function parse_hash_lines (chunk, esc)
+   local exec_pat = '()$(%b())()'
+   local esc_pat = esc..'+([^\n]*\n?)'
+   local esc_pat1, esc_pat2 = '^'..esc_pat, '\n'..esc_pat
+   local pieces, s = {'local __R_put, __tostring = ...'}, 1
+   while true do
+      local _, e, lua = chunk:find(esc_pat1, s)
+      if not e then
+         local ss
+         ss, e, lua = chunk:find(esc_pat2, s)
+         parse_dollar_paren(pieces, chunk:sub(s, ss), exec_pat)
+         if not e then break end
+      end
+      if lua:sub(-1) == '\n' then lua = lua:sub(1,-2) end
+      pieces[#pieces+1] = '\n'..lua
+      s = e + 1
+   end
+   return table.concat(pieces)
+end
+
+--- is streaming possible?
+function stream.available ()
+   return native ~= nil
+end
+
+--- compile the template `str` with escape character `escape` (default '#').
+-- Returns a function `render(env, put)` that calls `put` with the pieces of
+-- the output, and returns true or nil and an error; or nil and an error.
+function stream.compile (str, escape)
+   local code = parse_hash_lines(str, escape or '#')
+   local _, err = utils.load(code, 'TMP', 't', {})
+   if err then return nil, err end
+   return function (env, put)
+      local fn = utils.load(code, 'TMP', 't', setmetatable({}, {__index = env}))
+      local ok, err = pcall(fn, put, tostring)
+      if not ok then return nil, err end
+      return true
+   end
+end
+
+--- render the compiled template `render` in `env` straight into the file `fname`.
+-- Returns true, or nil and an error.
+function stream.write (render, env, fname)
+   local sink, err = native.stream(fname)
+   if not sink then return nil, err end
+   local ok
+   ok, err = render(env, function (s) sink:write(s) end)
+   local closed, cerr = sink:close()
+   if not ok then return nil, err end
+   if not closed then return nil, cerr end
+   return true
+end
+
+return stream
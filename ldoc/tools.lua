@@ -15,6 +15,10 @@ local append = table.insert
 local lexer = require 'ldoc.lexer'
 local quit = utils.quit
 
+-- directories are walked natively by the launcher, if it can
+local ok, native_dir = pcall(require, 'ldoc_dir')
+if not ok then native_dir = nil end
+
 -- at rendering time, can access the ldoc table from any module item,
 -- or the item itself if it's a module
 function M.item_ldoc (item)
@@ -494,24 +498,74 @@ function M.abspath (f)
    return res
 end
 
-function M.getallfiles(root,mask)
+-- the last walk of find_files, which getallfiles of the same directory can use
+local last_walk
+
+local function walk_key (root, mask)
+   return path.currentdir()..'\0'..root..'\0'..mask
+end
+
+-- the files below `root` matching `mask`, sorted. The directories `prune`
+-- (relative to `root`) need not be walked, since all their files are excluded.
+function M.getallfiles(root,mask,prune)
+   if last_walk and last_walk.key == walk_key(root,mask) then
+      local files = last_walk.files
+      last_walk = nil
+      return List(files)
+   end
+   if native_dir then
+      local files = native_dir.walk(root,mask,prune)
+      if files then return List(files) end
+   end
    local res = List(dir.getallfiles(root,mask))
    res:sort()
    return res
 end
 
+-- the files below `root` matching `mask` that are called `name`, in the order
+-- they are found. Natively, the files to process are listed in the same walk.
+function M.find_files(root,mask,name)
+   if native_dir then
+      local files, found = native_dir.walk(root,mask,nil,name)
+      if files then
+         last_walk = {key = walk_key(root,mask), files = files}
+         return List(found)
+      end
+   end
+   return List(dir.getallfiles(root,mask)):filter(function(f)
+      return path.basename(f) == name
+   end)
+end
+
+-- the directories of `dirs` below `root`, relative to it
+local function dirs_below (root, dirs)
+   local base = M.abspath(root):gsub('[\\/]$','')..path.sep
+   local res = List()
+   for _, d in ipairs(dirs) do
+      local p = M.abspath(d)
+      if p:sub(1,#base) == base then
+         res:append(p:sub(#base+1))
+      end
+   end
+   return res
+end
+
 function M.expand_file_list (list, mask)
-   local exclude_list = list.exclude and M.files_from_list(list.exclude, mask)
+   local exclude_set, exclude_dirs
+   if list.exclude then
+      exclude_set = tablex.makeset(M.files_from_list(list.exclude, mask))
+      exclude_dirs = List(list.exclude):filter(path.isdir)
+   end
    local files = List()
    local function process (f)
       f = M.abspath(f)
-      if not exclude_list or exclude_list and exclude_list:index(f) == nil then
+      if not exclude_set or not exclude_set[f] then
          files:append(f)
       end
    end
    for _,f in ipairs(list) do
       if path.isdir(f) then
-         local dfiles = M.getallfiles(f,mask)
+         local dfiles = M.getallfiles(f,mask,exclude_dirs and dirs_below(f,exclude_dirs))
          for f in dfiles:iter() do
             process(f)
          end
@@ -0,0 +1,70 @@
+--------------
+-- Watch mode (`--watch`).
+--
+-- While ldoc.lua runs, it tells the launcher which files and directories the
+-- output depends on; when the run is over, the launcher waits until one of them
+-- changes and then simply runs ldoc.lua again. A file changed while a run is
+-- going on counts as well. `--watch` implies `--incremental` and, unless given,
+-- `--cache .ldoc-cache`, so that a run only parses the changed files and only
+-- writes the affected pages.
+--
+-- The native `ldoc_watch` module of the launcher does the waiting; without it,
+-- `--watch` is ignored. It is refused in batch mode, where the launcher does
+-- not run the same arguments again.
+
+local List = require 'pl.List'
+local path = require 'pl.path'
+
+local ok, native = pcall(require, 'ldoc_watch')
+if not ok then native = nil end
+
+local watch = {}
+
+local paths, ignored = List(), List()
+local active = false
+
+local function update ()
+   native.watch(paths, ignored)
+end
+
+local function add_to (list, p)
+   if type(p) == 'table' then
+      for _, f in ipairs(p) do add_to(list, f) end
+   elseif type(p) == 'string' and p ~= '' then
+      list:append(path.abspath(p))
+   end
+end
+
+--- can this run watch its inputs? Returns false if there is no native
+-- support, or false and a message if the launcher cannot run again.
+function watch.available ()
+   if not native then return false end
+   return native.available()
+end
+
+--- start watching. From now on, ending this run with os.exit only ends this
+-- run, not the launcher, since the errors may be fixed by the next change.
+-- Returns like `watch.available`.
+function watch.start ()
+   local ok, err = watch.available()
+   if not ok then return false, err end
+   active = true
+   update()
+   return true
+end
+
+--- run again when `p` (a file or directory, or a list of them) changes.
+function watch.add (p)
+   if not active then return end
+   add_to(paths, p)
+   update()
+end
+
+--- but not for changes below the directory `p`.
+function watch.ignore (p)
+   if not active then return end
+   add_to(ignored, p)
+   update()
+end
+
+return watch
@@ -0,0 +1,224 @@
+/**
+ * @file ldoc_cache.cpp
+ * @brief Content hashes and entries of the parse cache (see ldoc/cache.lua).
+ *
+ * An entry is a single value in the format of ldoc_serialize.cpp, behind a
+ * header that identifies the format and its native layout. Entries written by
+ * a different build are therefore just cache misses.
+ *
+ * Interface:
+ * - ldoc_cache.hash(s) -> hash of the string s, as hex digits
+ * - ldoc_cache.hash_file(name) -> hash of the contents of the file, or nil and a
+ *   message
+ * - ldoc_cache.load(name) -> value stored in the entry; nil if there is no
+ *   usable entry, and nil and "invalid entry" if it cannot be read back
+ * - ldoc_cache.store(name, value) -> true, or nil and a message
+ * - ldoc_cache.sources() -> {name = hash} of the sources of LDoc's own chunks
+ *   the launcher loaded (see ldoc_cache_note_source)
+ * - ldoc_cache.set_classes{name = metatable, ...}
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "ldoc_native.h"
+
+#define ENTRY_MAGIC "LDocCache1"	// change whenever the entry format changes
+
+/* 64 bit FNV-1a: fast, and plenty for telling apart versions of the same file
+ * (the cache also compares the file name and size) */
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+static uint64_t Hash(uint64_t h, const char *s, size_t len) {
+  const unsigned char *p = (const unsigned char *)s;
+  for (size_t i = 0; i < len; ++i) {
+    h = (h ^ p[i]) * FNV_PRIME;
+  }
+  return h;
+}
+
+static std::string HashText(uint64_t h, uint64_t size) {
+  char hex[40];
+  snprintf(hex, sizeof(hex), "%016llx-%llx", (unsigned long long)h, (unsigned long long)size);
+  return hex;
+}
+
+static bool HashFile(const char *name, std::string *hash) {
+  FILE *f = fopen(name, "rb");
+  if (f == NULL) return false;
+  char buffer[65536];
+  uint64_t h = FNV_OFFSET, size = 0;
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    h = Hash(h, buffer, n);
+    size += n;
+  }
+  bool failed = ferror(f) != 0;
+  fclose(f);
+  if (failed) return false;
+  *hash = HashText(h, size);
+  return true;
+}
+
+static int CacheHash(lua_State *L) {
+  size_t len;
+  const char *s = luaL_checklstring(L, 1, &len);
+  lua_pushstring(L, HashText(Hash(FNV_OFFSET, s, len), len).c_str());
+  return 1;
+}
+
+static int CacheHashFile(lua_State *L) {
+  const char *name = luaL_checkstring(L, 1);
+  std::string hash;
+  if (!HashFile(name, &hash)) return luaL_fileresult(L, 0, name);
+  lua_pushstring(L, hash.c_str());
+  return 1;
+}
+
+/* -----------------------------------------------------------------------------
+ * The sources of LDoc itself, shared by all states of the process
+ */
+
+static std::mutex sourcesMutex;	// worker states load modules concurrently
+static std::map<std::string, std::string> sourceHashes;
+
+void ldoc_cache_note_source(const char *name, const char *source, size_t len) {
+  {
+    // embedded sources never change, so each is only hashed once
+    std::lock_guard<std::mutex> lock(sourcesMutex);
+    if (sourceHashes.count(name)) return;
+  }
+  std::string hash = HashText(Hash(FNV_OFFSET, source, len), len);
+  std::lock_guard<std::mutex> lock(sourcesMutex);
+  sourceHashes[name] = hash;
+}
+
+void ldoc_cache_note_file(const char *name, const char *filename) {
+  std::string hash;
+  if (!HashFile(filename, &hash)) hash = std::string("?") + filename;
+  std::lock_guard<std::mutex> lock(sourcesMutex);
+  sourceHashes[name] = hash;
+}
+
+static int CacheSources(lua_State *L) {
+  std::lock_guard<std::mutex> lock(sourcesMutex);
+  lua_createtable(L, 0, (int)sourceHashes.size());
+  for (const auto &s : sourceHashes) {
+    lua_pushstring(L, s.second.c_str());
+    lua_setfield(L, -2, s.first.c_str());
+  }
+  return 1;
+}
+
+static std::string EntryHeader() {
+  // magic, then the layout of the values written by ldoc_serialize()
+  std::string header(ENTRY_MAGIC);
+  header.push_back((char)sizeof(lua_Integer));
+  header.push_back((char)sizeof(lua_Number));
+  header.push_back((char)sizeof(size_t));
+  lua_Integer order = 0x0102;
+  header.append((const char *)&order, sizeof(order));
+  return header;
+}
+
+static bool ReadFile(const char *name, std::string *data) {
+  FILE *f = fopen(name, "rb");
+  if (f == NULL) return false;
+  char buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    data->append(buffer, n);
+  }
+  bool failed = ferror(f) != 0;
+  fclose(f);
+  return !failed;
+}
+
+static int CacheLoad(lua_State *L) {
+  const char *name = luaL_checkstring(L, 1);
+  std::string data;
+  std::string header = EntryHeader();
+  if (!ReadFile(name, &data) || data.compare(0, header.size(), header) != 0) {
+    lua_pushnil(L);
+    return 1;
+  }
+  // damaged or cut short: the file is parsed again (see ldoc/cache.lua)
+  if (!ldoc_deserialize(L, data.data() + header.size(), data.size() - header.size(), true)) {
+    lua_pushnil(L);
+    lua_pushliteral(L, "invalid entry");
+    return 2;
+  }
+  return 1;
+}
+
+static int CacheStore(lua_State *L) {
+  const char *name = luaL_checkstring(L, 1);
+  luaL_checkany(L, 2);
+  std::string data = EntryHeader();
+  const char *error = NULL;
+  if (!ldoc_serialize(L, 2, true, &data, &error)) {
+    lua_pushnil(L);
+    lua_pushfstring(L, "cannot store %s", error);
+    return 2;
+  }
+  /* Write to a temporary file first, so that an interrupted run leaves no
+   * truncated entry behind (rename() does not replace files on Windows) */
+  std::string temp = std::string(name) + ".tmp";
+  FILE *f = fopen(temp.c_str(), "wb");
+  if (f == NULL) return luaL_fileresult(L, 0, temp.c_str());
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  ok = fclose(f) == 0 && ok;
+  if (ok) {
+    remove(name);
+    ok = rename(temp.c_str(), name) == 0;
+  }
+  if (!ok) {
+    int result = luaL_fileresult(L, 0, name);
+    remove(temp.c_str());
+    return result;
+  }
+  lua_pushboolean(L, 1);
+  return 1;
+}
+
+int luaopen_ldoc_cache(lua_State *L) {
+  static const luaL_Reg functions[] = {
+    {"hash", CacheHash},
+    {"hash_file", CacheHashFile},
+    {"load", CacheLoad},
+    {"store", CacheStore},
+    {"sources", CacheSources},
+    {"set_classes", ldoc_set_classes},
+    {NULL, NULL}
+  };
+  luaL_newlib(L, functions);
+  return 1;
+}
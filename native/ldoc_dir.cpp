@@ -0,0 +1,240 @@
+/**
+ * @file ldoc_dir.cpp
+ * @brief Listing the files below a directory in one native walk.
+ *
+ * tools.expand_file_list used to go through dir.getallfiles, which walks the
+ * tree in Lua, and ldoc.lua walked it once more to look for config.ld. Here the
+ * walk is done natively and gives the same files: the mask is matched on the
+ * whole path, and the list is sorted. Directories that are excluded as a
+ * whole are not entered at all, and files with a given name (the config file)
+ * are collected on the way, in the order they are found.
+ *
+ * On Windows the directories are listed with FindFirstFileExA and
+ * FIND_FIRST_EX_LARGE_FETCH; the names are in the same code page as for lfs.
+ *
+ * Interface:
+ * - ldoc_dir.walk(root, mask [, prune [, name]]) -> files, found; or nil and
+ *   a message. `prune` is a list of directories below `root`, as relative
+ *   paths, which are skipped; `found` are the files called `name`.
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "ldoc_native.h"
+
+#ifdef _WIN32
+#define SEPARATOR '\\'
+#else
+#define SEPARATOR '/'
+#endif
+
+struct Walk {
+  std::string mask;		// normalized like the paths it is matched against
+  std::unordered_set<std::string> prune;
+  std::string name;		// files called like this are collected as well
+  size_t rootLen;		// the relative part of a path starts after this
+  std::vector<std::string> files;
+  std::vector<std::string> found;
+};
+
+// path.normcase: case and separators do not matter on Windows
+static std::string NormCase(const std::string &s) {
+#ifdef _WIN32
+  std::string res(s);
+  for (char &c : res) {
+    if (c == '/') c = '\\';
+    else if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+  }
+  return res;
+#else
+  return s;
+#endif
+}
+
+// the shell pattern of dir.getallfiles: '*' is any text, '?' any character
+static bool MatchMask(const char *m, const char *mEnd, const char *s, const char *sEnd) {
+  const char *star = NULL, *resume = NULL;
+  while (s < sEnd) {
+    if (m < mEnd && (*m == '?' || (*m != '*' && *m == *s))) {
+      ++m;
+      ++s;
+    }
+    else if (m < mEnd && *m == '*') {
+      star = m++;
+      resume = s;
+    }
+    else if (star) {
+      m = star + 1;
+      s = ++resume;
+    }
+    else {
+      return false;
+    }
+  }
+  while (m < mEnd && *m == '*') ++m;
+  return m == mEnd;
+}
+
+static void AddFile(Walk *w, const std::string &file, const char *name) {
+  std::string norm = NormCase(file);
+  if (!MatchMask(w->mask.data(), w->mask.data() + w->mask.size(), norm.data(), norm.data() + norm.size())) {
+    return;
+  }
+  w->files.push_back(file);
+  if (!w->name.empty() && w->name == name) w->found.push_back(file);
+}
+
+static bool Pruned(Walk *w, const std::string &dir) {
+  return !w->prune.empty() && w->prune.count(NormCase(dir.substr(w->rootLen))) > 0;
+}
+
+/* The same walk as dir.dirtree: depth first in the order the system lists the
+ * entries, following links, and leaving out links that lead nowhere. */
+#ifdef _WIN32
+
+static void WalkDir(Walk *w, const std::string &dir) {
+  WIN32_FIND_DATAA data;
+  HANDLE find = FindFirstFileExA((dir + "\\*").c_str(), FindExInfoBasic, &data,
+				 FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+  if (find == INVALID_HANDLE_VALUE) return;
+  do {
+    const char *name = data.cFileName;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+    std::string entry = dir + SEPARATOR + name;
+    bool isDir = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+      struct _stat64 st;
+      if (_stat64(entry.c_str(), &st) != 0) continue;
+      isDir = (st.st_mode & _S_IFDIR) != 0;
+    }
+    if (!isDir) AddFile(w, entry, name);
+    else if (!Pruned(w, entry)) WalkDir(w, entry);
+  } while (FindNextFileA(find, &data));
+  FindClose(find);
+}
+
+#else
+
+static void WalkDir(Walk *w, const std::string &dir) {
+  DIR *d = opendir(dir.c_str());
+  if (d == NULL) return;
+  while (struct dirent *e = readdir(d)) {
+    const char *name = e->d_name;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+    std::string entry = dir + SEPARATOR + name;
+    bool isDir;
+#ifdef DT_DIR
+    if (e->d_type == DT_DIR) isDir = true;
+    else if (e->d_type == DT_REG) isDir = false;
+    else
+#endif
+    {
+      struct stat st;
+      if (stat(entry.c_str(), &st) != 0) continue;
+      isDir = S_ISDIR(st.st_mode);
+    }
+    if (!isDir) AddFile(w, entry, name);
+    else if (!Pruned(w, entry)) WalkDir(w, entry);
+  }
+  closedir(d);
+}
+
+#endif
+
+static bool IsDir(const std::string &p) {
+#ifdef _WIN32
+  struct _stat64 st;
+  return _stat64(p.c_str(), &st) == 0 && (st.st_mode & _S_IFDIR) != 0;
+#else
+  struct stat st;
+  return stat(p.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+static void PushList(lua_State *L, const std::vector<std::string> &list) {
+  lua_createtable(L, (int)list.size(), 0);
+  for (size_t i = 0; i < list.size(); ++i) {
+    lua_pushlstring(L, list[i].data(), list[i].size());
+    lua_rawseti(L, -2, (lua_Integer)i + 1);
+  }
+}
+
+static int DirWalk(lua_State *L) {
+  size_t len;
+  const char *root = luaL_checklstring(L, 1, &len);
+  Walk w;
+  w.mask = NormCase(luaL_optstring(L, 2, "*"));
+  if (!lua_isnoneornil(L, 3)) {
+    luaL_checktype(L, 3, LUA_TTABLE);
+    lua_Integer n = (lua_Integer)lua_rawlen(L, 3);
+    for (lua_Integer i = 1; i <= n; ++i) {
+      lua_rawgeti(L, 3, i);
+      size_t plen;
+      const char *p = lua_tolstring(L, -1, &plen);
+      if (p) w.prune.insert(NormCase(std::string(p, plen)));
+      lua_pop(L, 1);
+    }
+  }
+  w.name = luaL_optstring(L, 4, "");
+
+  // like dir.dirtree, a trailing separator is dropped
+  std::string dir(root, len);
+  if (!dir.empty() && (dir.back() == '/' || dir.back() == SEPARATOR)) dir.pop_back();
+  if (!IsDir(dir)) {
+    lua_pushnil(L);
+    lua_pushfstring(L, "%s is not a directory", root);
+    return 2;
+  }
+  w.rootLen = dir.size() + 1;
+  WalkDir(&w, dir);
+
+  std::sort(w.files.begin(), w.files.end());
+  PushList(L, w.files);
+  PushList(L, w.found);
+  return 2;
+}
+
+int luaopen_ldoc_dir(lua_State *L) {
+  static const luaL_Reg functions[] = {
+    {"walk", DirWalk},
+    {NULL, NULL}
+  };
+  luaL_newlib(L, functions);
+  return 1;
+}
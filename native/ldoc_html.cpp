@@ -0,0 +1,182 @@
+/**
+ * @file ldoc_html.cpp
+ * @brief HTML escaping and whitespace cleanup of the pages (see ldoc/html.lua).
+ *
+ * Most strings a template escapes contain nothing to escape, and most lines of
+ * a rendered page have no trailing white space. Both are found by a scan that
+ * compares 16 bytes at a time where SSE2 is available; when nothing has to
+ * change, the functions return their argument itself instead of a copy.
+ *
+ * Interface:
+ * - ldoc_html.escape(s) -> s with &<>'" replaced by entities (ldoc.escape)
+ * - ldoc_html.escape_code(s) -> s with &<> replaced by entities (prettify)
+ * - ldoc_html.cleanup(s) -> s with all line ends as '\n', no white space at
+ *   the end of a line, and a final '\n' (cleanup_whitespaces)
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LDOC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include "ldoc_native.h"
+
+static const char ESCAPED[] = "&<>'\"";
+static const int ESCAPED_ALL = 5;	// ldoc.escape
+static const int ESCAPED_CODE = 3;	// prettify: only &<>
+
+// position of the first of the n characters in set, or len
+static size_t FindAny(const char *s, size_t len, const char *set, int n) {
+  size_t i = 0;
+#ifdef LDOC_SSE2
+  __m128i needles[5];
+  for (int k = 0; k < n; ++k) needles[k] = _mm_set1_epi8(set[k]);
+  for (; i + 16 <= len; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(s + i));
+    __m128i hit = _mm_cmpeq_epi8(chunk, needles[0]);
+    for (int k = 1; k < n; ++k) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(chunk, needles[k]));
+    unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+    if (mask) {
+      while (!(mask & 1)) {
+	mask >>= 1;
+	++i;
+      }
+      return i;
+    }
+  }
+#endif
+  for (; i < len; ++i)
+    if (memchr(set, s[i], n)) return i;
+  return len;
+}
+
+static const char *Entity(char c) {
+  switch (c) {
+  case '&': return "&amp;";
+  case '<': return "&lt;";
+  case '>': return "&gt;";
+  case '\'': return "&apos;";
+  default: return "&quot;";
+  }
+}
+
+// appends the rest of s to out, from s[i], the first character to escape
+static void AppendEscapedFrom(std::string *out, const char *s, size_t len, int n, size_t i) {
+  while (i < len) {
+    out->append(Entity(s[i]));
+    ++i;
+    size_t j = i + FindAny(s + i, len - i, ESCAPED, n);
+    out->append(s + i, j - i);
+    i = j;
+  }
+}
+
+// false if there is nothing to escape; out is only set otherwise
+static bool Escape(const char *s, size_t len, int n, std::string *out) {
+  size_t i = FindAny(s, len, ESCAPED, n);
+  if (i == len) return false;
+  out->assign(s, i);
+  AppendEscapedFrom(out, s, len, n, i);
+  return true;
+}
+
+void ldoc_html_append_escaped(std::string *out, const char *s, size_t len, bool code) {
+  int n = code ? ESCAPED_CODE : ESCAPED_ALL;
+  size_t i = FindAny(s, len, ESCAPED, n);
+  out->append(s, i);
+  AppendEscapedFrom(out, s, len, n, i);
+}
+
+static int EscapeArg(lua_State *L, int n) {
+  // like string.gsub: a number becomes a string (in place, so the argument
+  // returned is one too), anything else is an error
+  size_t len;
+  const char *s = luaL_checklstring(L, 1, &len);
+  std::string out;
+  if (!Escape(s, len, n, &out)) {
+    lua_settop(L, 1);
+    return 1;
+  }
+  lua_pushlstring(L, out.data(), out.size());
+  return 1;
+}
+
+static int HtmlEscape(lua_State *L) { return EscapeArg(L, ESCAPED_ALL); }
+static int HtmlEscapeCode(lua_State *L) { return EscapeArg(L, ESCAPED_CODE); }
+
+// the white space stringx.rstrip removes, apart from line ends
+static inline bool IsLineSpace(char c) { return c == ' ' || c == '\t' || c == '\v' || c == '\f'; }
+
+// unchanged: no '\r', nothing to strip before a '\n', and a final '\n' unless empty
+static bool IsClean(const char *s, size_t len) {
+  if (len == 0) return true;
+  if (s[len - 1] != '\n') return false;
+  size_t i = 0;
+  while ((i += FindAny(s + i, len - i, "\r\n", 2)) < len) {
+    if (s[i] == '\r' || (i > 0 && IsLineSpace(s[i - 1]))) return false;
+    ++i;
+  }
+  return true;
+}
+
+static int HtmlCleanup(lua_State *L) {
+  size_t len;
+  const char *s = luaL_checklstring(L, 1, &len);
+  if (IsClean(s, len)) {
+    lua_settop(L, 1);
+    return 1;
+  }
+  // lines end at '\r\n', '\r' or '\n', like stringx.splitlines
+  std::string out;
+  out.reserve(len + 1);
+  size_t i = 0;
+  while (i < len) {
+    size_t end = i + FindAny(s + i, len - i, "\r\n", 2);
+    size_t stop = end;
+    while (stop > i && IsLineSpace(s[stop - 1])) --stop;
+    out.append(s + i, stop - i);
+    out.push_back('\n');
+    if (end < len && s[end] == '\r' && end + 1 < len && s[end + 1] == '\n') ++end;
+    i = end + 1;
+  }
+  lua_pushlstring(L, out.data(), out.size());
+  return 1;
+}
+
+int luaopen_ldoc_html(lua_State *L) {
+  static const luaL_Reg functions[] = {
+    {"escape", HtmlEscape},
+    {"escape_code", HtmlEscapeCode},
+    {"cleanup", HtmlCleanup},
+    {NULL, NULL}
+  };
+  luaL_newlib(L, functions);
+  return 1;
+}
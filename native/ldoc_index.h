@@ -0,0 +1,204 @@
+/**
+ * @file ldoc_index.h
+ * @brief Reader for the binary API index written by 'ldoc --emit_index FILE'.
+ *
+ * Header-only and independent of Lua and the launcher, so that other tools can
+ * simply include it. The index is meant to be memory-mapped (or read) as a
+ * whole and used in place; Index::open() checks that every table and every
+ * string reference lies within the data.
+ *
+ * Layout (see ldoc/index.lua), all words little-endian uint32_t:
+ * - header, 64 bytes: magic "LDOCIDX1", version, flags, then count and offset
+ *   of the modules, items, params, returns and refs tables, then offset and
+ *   size of the string pool
+ * - the tables, arrays of the records below
+ * - the string pool: every string is its length, the bytes and a '\0',
+ *   padded to a multiple of 4; a string is referred to by the offset of its
+ *   length in the pool, and offset 0 is ""
+ *
+ * Items of a module, and the params, returns and refs of an item, are
+ * consecutive ranges of their tables. Texts are the raw comment texts, not
+ * rendered HTML.
+ *
+ * tests/index/index_test.cpp (ctest) checks this reader against the layout.
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string_view>
+
+namespace ldoc_index {
+
+const uint32_t VERSION = 1;
+const uint32_t NONE = 0xFFFFFFFF;	// no module or item
+
+// Param::flags
+const uint32_t PARAM_OPTIONAL = 1;
+const uint32_t PARAM_READONLY = 2;
+
+struct Header {
+  char magic[8];
+  uint32_t version, flags;
+  uint32_t moduleCount, modulesOffset;
+  uint32_t itemCount, itemsOffset;
+  uint32_t paramCount, paramsOffset;
+  uint32_t returnCount, returnsOffset;
+  uint32_t refCount, refsOffset;
+  uint32_t stringsOffset, stringsSize;
+};
+
+struct Module {
+  uint32_t name, kind, summary, description, file, lineno;
+  uint32_t firstItem, itemCount;
+  uint32_t firstRef, refCount;
+};
+
+struct Item {
+  uint32_t name, kind, summary, description, args, section, file, lineno;
+  uint32_t module;
+  uint32_t firstParam, paramCount;
+  uint32_t firstReturn, returnCount;
+  uint32_t firstRef, refCount;
+};
+
+struct Param {
+  uint32_t name, type, description;
+  uint32_t defaultValue;	// "" if there is none (e.g. just optional)
+  uint32_t flags;
+};
+
+struct Return {
+  uint32_t group;		// alternative return groups, numbered from 0
+  uint32_t type, description;
+};
+
+// a resolved @see reference: to a module or an item of it, or else to href
+struct Ref {
+  uint32_t label, module, item, href;
+};
+
+static_assert(sizeof(Header) == 64 && sizeof(Module) == 40 && sizeof(Item) == 60 &&
+	      sizeof(Param) == 20 && sizeof(Return) == 12 && sizeof(Ref) == 16,
+	      "records must match the file layout");
+
+class Index {
+public:
+  /* data must stay valid while the index is used, and be 4-byte aligned (as
+   * mapped files are); false if it is not a valid index of this version. This
+   * reader assumes a little-endian machine. */
+  bool open(const void *data, size_t size) {
+    base_ = (const char *)data;
+    size_ = size;
+    if (size < sizeof(Header) || ((uintptr_t)data & 3) != 0) return false;
+    header_ = (const Header *)base_;
+    if (memcmp(header_->magic, "LDOCIDX1", 8) != 0 || header_->version != VERSION) return false;
+    if (!fits(header_->modulesOffset, header_->moduleCount, sizeof(Module)) ||
+	!fits(header_->itemsOffset, header_->itemCount, sizeof(Item)) ||
+	!fits(header_->paramsOffset, header_->paramCount, sizeof(Param)) ||
+	!fits(header_->returnsOffset, header_->returnCount, sizeof(Return)) ||
+	!fits(header_->refsOffset, header_->refCount, sizeof(Ref)) ||
+	!fits(header_->stringsOffset, header_->stringsSize, 1) || (header_->stringsOffset & 3) != 0) {
+      return false;
+    }
+    return checkRanges();
+  }
+
+  uint32_t moduleCount() const { return header_->moduleCount; }
+  uint32_t itemCount() const { return header_->itemCount; }
+  const Module &module(uint32_t i) const { return table<Module>(header_->modulesOffset)[i]; }
+  const Item &item(uint32_t i) const { return table<Item>(header_->itemsOffset)[i]; }
+  const Param &param(uint32_t i) const { return table<Param>(header_->paramsOffset)[i]; }
+  const Return &ret(uint32_t i) const { return table<Return>(header_->returnsOffset)[i]; }
+  const Ref &ref(uint32_t i) const { return table<Ref>(header_->refsOffset)[i]; }
+
+  // the string at offset s of the pool; "" if s is not a valid string reference
+  std::string_view str(uint32_t s) const {
+    const char *pool = base_ + header_->stringsOffset;
+    uint32_t poolSize = header_->stringsSize;
+    if ((s & 3) != 0 || s > poolSize || poolSize - s < 5) return std::string_view();
+    uint32_t len = *(const uint32_t *)(pool + s);
+    if (len > poolSize - s - 5) return std::string_view();
+    return std::string_view(pool + s + 4, len);
+  }
+
+  // the first module called name, or NONE
+  uint32_t findModule(std::string_view name) const {
+    for (uint32_t i = 0; i < moduleCount(); ++i)
+      if (str(module(i).name) == name) return i;
+    return NONE;
+  }
+
+  // the first item of module m called name, or NONE
+  uint32_t findItem(uint32_t m, std::string_view name) const {
+    const Module &mod = module(m);
+    for (uint32_t i = mod.firstItem; i < mod.firstItem + mod.itemCount; ++i)
+      if (str(item(i).name) == name) return i;
+    return NONE;
+  }
+
+private:
+  const char *base_ = NULL;
+  size_t size_ = 0;
+  const Header *header_ = NULL;
+
+  template <class T> const T *table(uint32_t offset) const { return (const T *)(base_ + offset); }
+
+  bool fits(uint32_t offset, uint32_t count, size_t recordSize) const {
+    return (offset & 3) == 0 && offset <= size_ && (size_ - offset) / recordSize >= count;
+  }
+
+  static bool inRange(uint32_t first, uint32_t count, uint32_t total) {
+    return first <= total && count <= total - first;
+  }
+
+  // the ranges and indexes of all records point into their tables
+  bool checkRanges() const {
+    for (uint32_t i = 0; i < header_->moduleCount; ++i) {
+      const Module &m = module(i);
+      if (!inRange(m.firstItem, m.itemCount, header_->itemCount) ||
+	  !inRange(m.firstRef, m.refCount, header_->refCount)) return false;
+    }
+    for (uint32_t i = 0; i < header_->itemCount; ++i) {
+      const Item &it = item(i);
+      if (it.module >= header_->moduleCount ||
+	  !inRange(it.firstParam, it.paramCount, header_->paramCount) ||
+	  !inRange(it.firstReturn, it.returnCount, header_->returnCount) ||
+	  !inRange(it.firstRef, it.refCount, header_->refCount)) return false;
+    }
+    for (uint32_t i = 0; i < header_->refCount; ++i) {
+      const Ref &r = ref(i);
+      if ((r.module != NONE && r.module >= header_->moduleCount) ||
+	  (r.item != NONE && r.item >= header_->itemCount)) return false;
+    }
+    return true;
+  }
+};
+
+}  // namespace ldoc_index
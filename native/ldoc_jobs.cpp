@@ -0,0 +1,323 @@
+/**
+ * @file ldoc_jobs.cpp
+ * @brief Thread pool of worker Lua states for parallel parsing and rendering (--jobs).
+ *
+ * The main state hands out a list of jobs (files to parse, or pages to render)
+ * with ldoc_jobs.start(). Every worker thread gets its own state from the
+ * launcher and runs ldoc.lua in it, which then serves the jobs (see
+ * ldoc/jobs.lua). Results travel between the states
+ * as serialized Lua values (see ldoc_serialize.cpp); tables may be shared or
+ * cyclic and keep their metatable, as long as it is one of the classes made
+ * known by set_classes().
+ *
+ * Interface (main state):
+ * - ldoc_jobs.start(n, jobs, context) -> pool (nil if no workers can be created)
+ * - pool:result(i) -> value submitted for jobs[i], or nil if the main state
+ *   has to do the job itself. Must be called in order; a job no worker has
+ *   taken yet is never handed out afterwards.
+ * - pool:stop() - waits for the workers to finish their current job and quit
+ *
+ * Interface (worker state):
+ * - ldoc_jobs.context() -> context table passed to start(), nil in the main state
+ * - ldoc_jobs.next() -> index, name of the next job, or nothing
+ * - ldoc_jobs.submit(i, value) -> true, or false and a message
+ *
+ * Both:
+ * - ldoc_jobs.set_classes{name = metatable, ...}
+ * - ldoc_jobs.pack(value) -> string, or nil and a message
+ * - ldoc_jobs.unpack(s) -> value packed by pack(), in this or another state
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ldoc_native.h"
+
+#define POOL_TYPE "ldoc_jobs.pool"
+#define WORKER_KEY "ldoc_jobs.worker"		// registry: Worker* of a worker state
+
+static LDocStateFactory stateFactory = NULL;
+
+void ldoc_jobs_set_state_factory(LDocStateFactory factory) {
+  stateFactory = factory;
+}
+
+/* -----------------------------------------------------------------------------
+ * Job pool
+ */
+
+enum JobState {
+  JOB_QUEUED,
+  JOB_CLAIMED,			// a worker is parsing it
+  JOB_DONE,			// result available
+  JOB_MAIN			// to be done by the main state
+};
+
+struct JobPool {
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::vector<std::string> files;
+  std::vector<JobState> states;
+  std::vector<std::string> results;
+  size_t next;			// all jobs before this one are taken
+  std::string context;
+  std::vector<std::string> args;	// of the run, for the worker states
+  bool stopping;
+  std::vector<std::thread> threads;
+};
+
+struct Worker {
+  JobPool *pool;
+  long job;			// job the worker has taken, -1 if none
+};
+
+static int Resume(lua_State *co, lua_State *from) {
+#if LUA_VERSION_NUM >= 504
+  int nres;
+  return lua_resume(co, from, 0, &nres);
+#else
+  return lua_resume(co, from, 0);
+#endif
+}
+
+static void RunWorker(JobPool *pool) {
+  Worker worker = {pool, -1};
+  lua_State *L = stateFactory(pool->args);
+  if (L) {
+    lua_pushlightuserdata(L, &worker);
+    lua_setfield(L, LUA_REGISTRYINDEX, WORKER_KEY);
+    /* ldoc.lua runs as a coroutine, which yields as soon as there are no more
+     * jobs. Ending in an error instead just means that this worker stops taking
+     * jobs (e.g. the configuration could not be processed). */
+    lua_State *co = lua_newthread(L);
+    lua_pushvalue(L, -2);
+    lua_xmove(L, co, 1);
+    Resume(co, L);
+    lua_close(L);
+  }
+  std::lock_guard<std::mutex> lock(pool->mutex);
+  if (worker.job >= 0) pool->states[worker.job] = JOB_MAIN;
+  pool->changed.notify_all();
+}
+
+static void StopPool(JobPool *pool) {
+  {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    pool->stopping = true;
+  }
+  for (std::thread &t : pool->threads) {
+    if (t.joinable()) t.join();
+  }
+  pool->threads.clear();
+}
+
+static JobPool **CheckPool(lua_State *L) {
+  JobPool **pool = (JobPool **)luaL_checkudata(L, 1, POOL_TYPE);
+  if (*pool == NULL) luaL_error(L, "job pool already closed");
+  return pool;
+}
+
+static int PoolResult(lua_State *L) {
+  JobPool *pool = *CheckPool(L);
+  lua_Integer i = luaL_checkinteger(L, 2);
+  luaL_argcheck(L, i >= 1 && (size_t)i <= pool->files.size(), 2, "job index out of range");
+  size_t job = (size_t)(i - 1);
+  std::string result;
+  {
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    if (pool->states[job] == JOB_QUEUED) pool->states[job] = JOB_MAIN;
+    pool->changed.wait(lock, [&] { return pool->states[job] != JOB_CLAIMED; });
+    if (pool->states[job] == JOB_MAIN) return 0;
+    result.swap(pool->results[job]);
+  }
+  if (!ldoc_deserialize(L, result.data(), result.size(), true)) return 0;
+  return 1;
+}
+
+static int PoolStop(lua_State *L) {
+  JobPool **pool = (JobPool **)luaL_checkudata(L, 1, POOL_TYPE);
+  if (*pool) {
+    StopPool(*pool);
+    delete *pool;
+    *pool = NULL;
+  }
+  return 0;
+}
+
+static int JobsStart(lua_State *L) {
+  lua_Integer n = luaL_checkinteger(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  if (stateFactory == NULL || n < 1) return 0;
+
+  JobPool *pool = new JobPool();
+  pool->next = 0;
+  pool->stopping = false;
+  lua_Integer count = (lua_Integer)lua_rawlen(L, 2);
+  for (lua_Integer i = 1; i <= count; ++i) {
+    lua_rawgeti(L, 2, i);
+    size_t len;
+    const char *file = lua_tolstring(L, -1, &len);
+    pool->files.push_back(file ? std::string(file, len) : std::string());
+    lua_pop(L, 1);
+  }
+  lua_getfield(L, LUA_REGISTRYINDEX, LDOC_ARGS_KEY);
+  const std::vector<std::string> *args = (const std::vector<std::string> *)lua_touserdata(L, -1);
+  lua_pop(L, 1);
+  if (args) pool->args = *args;
+  pool->states.assign(pool->files.size(), JOB_QUEUED);
+  pool->results.resize(pool->files.size());
+  const char *error = NULL;
+  if (!lua_isnoneornil(L, 3) && !ldoc_serialize(L, 3, false, &pool->context, &error)) {
+    delete pool;
+    return luaL_error(L, "bad job context (%s)", error);
+  }
+
+  JobPool **ud = (JobPool **)lua_newuserdatauv(L, sizeof(JobPool *), 0);
+  *ud = pool;
+  luaL_setmetatable(L, POOL_TYPE);
+  if (n > count) n = count;
+  try {
+    for (lua_Integer i = 0; i < n; ++i) pool->threads.emplace_back(RunWorker, pool);
+  }
+  catch (const std::system_error &) {
+    // fewer workers than requested; the main state takes over the rest anyway
+  }
+  return 1;
+}
+
+static Worker *GetWorker(lua_State *L) {
+  lua_getfield(L, LUA_REGISTRYINDEX, WORKER_KEY);
+  Worker *worker = (Worker *)lua_touserdata(L, -1);
+  lua_pop(L, 1);
+  return worker;
+}
+
+static int JobsContext(lua_State *L) {
+  Worker *worker = GetWorker(L);
+  if (worker == NULL) return 0;
+  if (worker->pool->context.empty()) {
+    lua_newtable(L);
+    return 1;
+  }
+  return ldoc_deserialize(L, worker->pool->context.data(), worker->pool->context.size(), false) ? 1 : 0;
+}
+
+static int JobsNext(lua_State *L) {
+  Worker *worker = GetWorker(L);
+  if (worker == NULL) return luaL_error(L, "not a worker state");
+  JobPool *pool = worker->pool;
+  std::lock_guard<std::mutex> lock(pool->mutex);
+  if (pool->stopping) return 0;
+  while (pool->next < pool->states.size() && pool->states[pool->next] != JOB_QUEUED) {
+    ++pool->next;
+  }
+  if (pool->next == pool->states.size()) return 0;
+  worker->job = (long)pool->next;
+  pool->states[pool->next] = JOB_CLAIMED;
+  lua_pushinteger(L, (lua_Integer)pool->next + 1);
+  lua_pushlstring(L, pool->files[pool->next].data(), pool->files[pool->next].size());
+  return 2;
+}
+
+static int JobsSubmit(lua_State *L) {
+  Worker *worker = GetWorker(L);
+  if (worker == NULL) return luaL_error(L, "not a worker state");
+  lua_Integer i = luaL_checkinteger(L, 1);
+  luaL_argcheck(L, i - 1 == worker->job, 1, "not the current job");
+  luaL_checkany(L, 2);
+  std::string result;
+  const char *error = NULL;
+  if (!ldoc_serialize(L, 2, true, &result, &error)) {
+    lua_pushboolean(L, 0);
+    lua_pushfstring(L, "cannot transfer %s", error);
+    return 2;
+  }
+  JobPool *pool = worker->pool;
+  {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    pool->results[worker->job].swap(result);
+    pool->states[worker->job] = JOB_DONE;
+    worker->job = -1;
+  }
+  pool->changed.notify_all();
+  lua_pushboolean(L, 1);
+  return 1;
+}
+
+/* A copy of a value that outlives changes to it, e.g. a scanned file before it
+ * is finished, which can be carried over to the workers in the job context. */
+static int JobsPack(lua_State *L) {
+  luaL_checkany(L, 1);
+  std::string packed;
+  const char *error = NULL;
+  if (!ldoc_serialize(L, 1, true, &packed, &error)) {
+    lua_pushnil(L);
+    lua_pushfstring(L, "cannot pack %s", error);
+    return 2;
+  }
+  lua_pushlstring(L, packed.data(), packed.size());
+  return 1;
+}
+
+static int JobsUnpack(lua_State *L) {
+  size_t len;
+  const char *packed = luaL_checklstring(L, 1, &len);
+  if (!ldoc_deserialize(L, packed, len, true)) return luaL_error(L, "corrupt packed value");
+  return 1;
+}
+
+int luaopen_ldoc_jobs(lua_State *L) {
+  static const luaL_Reg methods[] = {
+    {"result", PoolResult},
+    {"stop", PoolStop},
+    {NULL, NULL}
+  };
+  static const luaL_Reg functions[] = {
+    {"start", JobsStart},
+    {"context", JobsContext},
+    {"next", JobsNext},
+    {"submit", JobsSubmit},
+    {"set_classes", ldoc_set_classes},
+    {"pack", JobsPack},
+    {"unpack", JobsUnpack},
+    {NULL, NULL}
+  };
+  if (luaL_newmetatable(L, POOL_TYPE)) {
+    luaL_newlib(L, methods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, PoolStop);
+    lua_setfield(L, -2, "__gc");
+  }
+  lua_pop(L, 1);
+  luaL_newlib(L, functions);
+  return 1;
+}
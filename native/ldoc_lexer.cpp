@@ -0,0 +1,840 @@
+/**
+ * @file ldoc_lexer.cpp
+ * @brief Native token streams for Lua and C/C++ sources.
+ *
+ * This is a drop-in replacement for the token streams created by
+ * 'lexer.lua()' and 'lexer.cpp()' in ldoc/lexer.lua. The Lua implementation
+ * tries every pattern of a match table in turn at each position; here the
+ * first character selects the (few) candidate rules directly, which are then
+ * tried in exactly the order of the Lua match tables. The produced tokens,
+ * values and line numbers are identical, including the quirks of the Lua
+ * version (e.g. how line numbers are counted in string mode).
+ *
+ * Interface:
+ * - ldoc_lexer.lua(s [, options])
+ * - ldoc_lexer.cpp(s [, options [, no_string]])
+ *   's' is either a string or an open file handle, 'options' defaults to
+ *   {number=true, string=true}. Both return a callable token stream with the
+ *   methods 'lineno', 'getline' and 'next', or nil for empty input.
+ * - ldoc_lexer.lua_file(name [, options])
+ * - ldoc_lexer.cpp_file(name [, options [, no_string]])
+ *   The same for the named file, which is memory-mapped (see ldoc_source.cpp):
+ *   like reading it from a file handle for Lua, and like passing its contents
+ *   as a string for C. Also returns nil and a message if it cannot be read.
+ *   Where Lua reads files in text mode (Windows), "\r\n" in the mapped file
+ *   is taken for a line end: lines lose the '\r', and so do tokens and the
+ *   rest of the file returned by 'getline' in C sources.
+ *
+ * - ldoc_lexer.highlight(code, cpp, pre, linenos, globals, user_keywords, resolve)
+ *   The code as highlighted HTML, exactly like prettify.lua builds it from the
+ *   tokens of 'lexer.lua(code,{},{})' or 'lexer.cpp(code,{},{})'; or nil and
+ *   a message for empty code. 'linenos' is nil or a list of line numbers that
+ *   get anchors, 'globals' is ldoc.builtin.globals, and 'resolve(val, lineno)'
+ *   is called for comments and backticks, for @{references}.
+ *
+ * Filtering of token types is not supported; ldoc/lexer.lua falls back to the
+ * Lua implementation whenever a filter is requested.
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "ldoc_native.h"
+
+#define STREAM_TYPE "ldoc_lexer.stream"
+
+enum Language {
+  LANG_LUA,			// lua_matches
+  LANG_CPP,			// cpp_matches
+  LANG_CPP_NO_STRING		// cpp_matches_no_string
+};
+
+enum TokenKind {
+  TK_SPACE,
+  TK_NUMBER,
+  TK_NAME,			// 'keyword' or 'iden'
+  TK_STRING,			// quoted string
+  TK_LONG_STRING,		// Lua [[long string]]
+  TK_CHAR,			// C character literal
+  TK_BACKTICK,
+  TK_COMMENT,
+  TK_PREPRO,
+  TK_OPERATOR			// type and value are the token itself
+};
+
+struct Token {
+  TokenKind kind;
+  const char *text;
+  size_t len;
+};
+
+struct TokenStream {
+  Language language;
+  bool convertNumbers;		// options.number
+  bool stripQuotes;		// options.string
+  bool fileMode;
+  bool crlf;			// named file: "\r\n" is read as '\n'
+  bool exhausted;		// end of file reached (file mode only)
+  const char *s;		// current subject: the string, or the current line incl. '\n'
+  size_t sz;
+  size_t idx;			// 0-based position of the next token in s
+  int line;
+  const char *data;		// file mode: complete content of the file
+  size_t dataSize;
+  size_t nextLine;		// file mode: offset of the next unread line in data
+  std::string lastLine;		// file mode: unterminated last line with '\n' appended
+  std::string buffer;		// file mode: content read from a file handle
+  std::string translated;	// crlf: the current token without its '\r's
+  LDocSource *source;		// the mapped file, if any
+
+  ~TokenStream() { ldoc_source_close(source); }
+};
+
+// Keyword sets of ldoc/lexer.lua, sorted for binary search
+static const char *const LUA_KEYWORDS[] = {
+  "and", "break", "do", "else", "elseif", "end", "false", "for", "function",
+  "if", "in", "local", "nil", "not", "or", "repeat", "return", "then", "true",
+  "until", "while"
+};
+
+static const char *const CPP_KEYWORDS[] = {
+  "bool", "break", "case", "catch", "char", "class", "const", "continue",
+  "default", "delete", "do", "double", "else", "enum", "extern", "false",
+  "float", "for", "goto", "if", "int", "long", "namespace", "new", "private",
+  "protected", "public", "register", "return", "short", "signed", "sizeof",
+  "static", "struct", "switch", "true", "try", "typedef", "union", "unsigned",
+  "void", "volatile", "while"
+};
+
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+// Character classes of Lua patterns in the "C" locale (%s, %d, %a, %w, %x)
+static inline bool IsSpace(unsigned char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+static inline bool IsDigit(unsigned char c) { return c >= '0' && c <= '9'; }
+static inline bool IsAlpha(unsigned char c) { return (c | 0x20) >= 'a' && (c | 0x20) <= 'z'; }
+static inline bool IsNameStart(unsigned char c) { return IsAlpha(c) || c == '_'; }
+static inline bool IsNameChar(unsigned char c) { return IsNameStart(c) || IsDigit(c); }
+static inline bool IsXDigit(unsigned char c) {
+  return IsDigit(c) || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f');
+}
+
+static bool IsKeyword(Language language, const char *text, size_t len) {
+  const char *const *list = language == LANG_LUA ? LUA_KEYWORDS : CPP_KEYWORDS;
+  size_t lo = 0, hi = language == LANG_LUA ? COUNT_OF(LUA_KEYWORDS) : COUNT_OF(CPP_KEYWORDS);
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    int cmp = strncmp(list[mid], text, len);
+    if (cmp == 0 && list[mid][len] != '\0') cmp = 1;	// keyword is longer
+    if (cmp == 0) return true;
+    if (cmp < 0) lo = mid + 1; else hi = mid;
+  }
+  return false;
+}
+
+/* The Match* functions implement single patterns of the Lua match tables,
+ * anchored at position i. They return the end of the match (exclusive) or 0
+ * if the pattern does not match, which can never be a valid end. */
+
+// '^%s+'
+static size_t MatchSpace(const char *s, size_t sz, size_t i) {
+  while (i < sz && IsSpace(s[i])) ++i;
+  return i;
+}
+
+// '^0x[%da-fA-F]+', then '^%d+%.?%d*[eE][%+%-]?%d+', then '^%d+%.?%d*'
+static size_t MatchNumber(const char *s, size_t sz, size_t i) {
+  if (i + 2 < sz && s[i] == '0' && s[i + 1] == 'x' && IsXDigit(s[i + 2])) {
+    i += 3;
+    while (i < sz && IsXDigit(s[i])) ++i;
+    return i;
+  }
+  while (i < sz && IsDigit(s[i])) ++i;
+  if (i < sz && s[i] == '.') ++i;
+  while (i < sz && IsDigit(s[i])) ++i;
+  if (i < sz && (s[i] == 'e' || s[i] == 'E')) {
+    size_t j = i + 1;
+    if (j < sz && (s[j] == '+' || s[j] == '-')) ++j;
+    if (j < sz && IsDigit(s[j])) {
+      while (j < sz && IsDigit(s[j])) ++j;
+      return j;
+    }
+  }
+  return i;
+}
+
+/* '^'.-[^\\]'', '^".-[^\\]"' and PREPRO ('^#.-[^\\]\n'): the first delimiter
+ * at i + 2 or later, which is not preceded by a backslash. With crlf, the
+ * character before a '\n' is the one before its '\r', if any. */
+static size_t MatchDelimited(const char *s, size_t sz, size_t i, char delim, bool crlf) {
+  if (i + 2 >= sz) return 0;
+  const char *p = s + i + 2, *end = s + sz;
+  while ((p = (const char *)memchr(p, delim, end - p)) != NULL) {
+    const char *prev = crlf && p[-1] == '\r' ? p - 2 : p - 1;
+    if (prev > s + i && *prev != '\\') return (p - s) + 1;
+    if (++p == end) break;
+  }
+  return 0;
+}
+
+// '^%[(=*)%[.-%]%1%]', with i at the opening bracket
+static size_t MatchLongBracket(const char *s, size_t sz, size_t i) {
+  size_t level = 0, j = i + 1;
+  while (j < sz && s[j] == '=') { ++j; ++level; }
+  if (j >= sz || s[j] != '[') return 0;
+  const char *p = s + j + 1, *end = s + sz;
+  while (p < end && (p = (const char *)memchr(p, ']', end - p)) != NULL) {
+    if ((size_t)(end - p) < level + 2) break;
+    size_t k = 1;
+    while (k <= level && p[k] == '=') ++k;
+    if (k > level && p[k] == ']') return (p - s) + level + 2;
+    ++p;
+  }
+  return 0;
+}
+
+// '^`[^`]+`'
+static size_t MatchBacktick(const char *s, size_t sz, size_t i) {
+  if (i + 1 >= sz) return 0;
+  const char *p = (const char *)memchr(s + i + 1, '`', sz - i - 1);
+  if (!p || p == s + i + 1) return 0;
+  return (p - s) + 1;
+}
+
+// '^//.-\n' resp. '^%-%-.-\n' (plus '.-$' if toEnd is set), i at the comment start
+static size_t MatchLineComment(const char *s, size_t sz, size_t i, bool toEnd) {
+  const char *p = (const char *)memchr(s + i + 2, '\n', sz - i - 2);
+  if (p) return (p - s) + 1;
+  return toEnd ? sz : 0;
+}
+
+// '^/%*.-%*/'
+static size_t MatchBlockComment(const char *s, size_t sz, size_t i) {
+  const char *p = s + i + 2, *end = s + sz;
+  while (p < end && (p = (const char *)memchr(p, '*', end - p)) != NULL) {
+    if (p + 1 < end && p[1] == '/') return (p - s) + 2;
+    ++p;
+  }
+  return 0;
+}
+
+static size_t ScanLua(const char *s, size_t sz, size_t i, TokenKind *kind) {
+  unsigned char c = s[i];
+  size_t e;
+  *kind = TK_OPERATOR;
+  if (IsSpace(c)) { *kind = TK_SPACE; return MatchSpace(s, sz, i); }
+  if (IsDigit(c)) { *kind = TK_NUMBER; return MatchNumber(s, sz, i); }
+  if (IsNameStart(c)) {
+    *kind = TK_NAME;
+    for (e = i + 1; e < sz && IsNameChar(s[e]); ++e) {}
+    return e;
+  }
+  char next = i + 1 < sz ? s[i + 1] : '\0';
+  switch (c) {
+  case '\'': case '"':
+    *kind = TK_STRING;
+    if (next == (char)c) return i + 2;
+    if ((e = MatchDelimited(s, sz, i, c, false)) != 0) return e;
+    break;
+  case '`':
+    *kind = TK_BACKTICK;
+    if ((e = MatchBacktick(s, sz, i)) != 0) return e;
+    break;
+  case '-':
+    if (next == '-') {
+      *kind = TK_COMMENT;
+      if (i + 2 < sz && s[i + 2] == '[' && (e = MatchLongBracket(s, sz, i + 2)) != 0) return e;
+      return MatchLineComment(s, sz, i, true);
+    }
+    break;
+  case '[':
+    *kind = TK_LONG_STRING;
+    if ((e = MatchLongBracket(s, sz, i)) != 0) return e;
+    break;
+  case '=': case '~': case '<': case '>':
+    if (next == '=') return i + 2;
+    break;
+  case '.':
+    if (next == '.') return (i + 2 < sz && s[i + 2] == '.') ? i + 3 : i + 2;
+    break;
+  }
+  *kind = TK_OPERATOR;		// '^.'
+  return i + 1;
+}
+
+static size_t ScanCpp(const char *s, size_t sz, size_t i, bool strings, bool crlf,
+		      TokenKind *kind) {
+  unsigned char c = s[i];
+  size_t e;
+  *kind = TK_OPERATOR;
+  if (IsSpace(c)) { *kind = TK_SPACE; return MatchSpace(s, sz, i); }
+  if (c == '#') {
+    *kind = TK_PREPRO;
+    if ((e = MatchDelimited(s, sz, i, '\n', crlf)) != 0) return e;
+    *kind = TK_OPERATOR;
+    return i + 1;
+  }
+  if (IsDigit(c)) { *kind = TK_NUMBER; return MatchNumber(s, sz, i); }
+  if (IsNameStart(c)) {
+    *kind = TK_NAME;
+    for (e = i + 1; e < sz && IsNameChar(s[e]); ++e) {}
+    return e;
+  }
+  char next = i + 1 < sz ? s[i + 1] : '\0';
+  switch (c) {
+  case '\'': case '"':
+    if (!strings) break;
+    *kind = TK_STRING;		// STRING3 yields 'string' for both quotes
+    if (next == (char)c) return i + 2;
+    *kind = c == '\'' ? TK_CHAR : TK_STRING;
+    if ((e = MatchDelimited(s, sz, i, c, false)) != 0) return e;
+    break;
+  case '/':
+    if (next == '/' || next == '*') {
+      *kind = TK_COMMENT;
+      e = next == '/' ? MatchLineComment(s, sz, i, strings) : MatchBlockComment(s, sz, i);
+      if (e != 0) return e;
+    }
+    else if (next == '=') return i + 2;
+    break;
+  case '=': case '!': case '<': case '>': case '*': case '^':
+    if (next == '=') return i + 2;
+    break;
+  case '-':
+    if (next == '>' || next == '-' || next == '=') return i + 2;
+    break;
+  case '+':
+    if (next == '+' || next == '=') return i + 2;
+    break;
+  case '|':
+    if (next == '|' || next == '=') return i + 2;
+    break;
+  case '&': case ':':
+    if (next == (char)c) return i + 2;
+    break;
+  case '.':
+    if (next == '.' && i + 2 < sz && s[i + 2] == '.') return i + 3;
+    break;
+  }
+  *kind = TK_OPERATOR;		// '^.'
+  return i + 1;
+}
+
+static int CountLines(int line, const char *text, size_t len) {
+  /* Same as count_lines() in ldoc/lexer.lua: if there is a "\r\n" anywhere
+   * ahead, it counts as one line and scanning resumes behind it; otherwise the
+   * next single '\r', '\n' or '\f' is counted. */
+  size_t index = 0;
+  while (index < len) {
+    const char *p = text + index, *end = text + len;
+    const char *crlf = NULL;
+    while (p < end && (p = (const char *)memchr(p, '\r', end - p)) != NULL) {
+      if (p + 1 < end && p[1] == '\n') { crlf = p; break; }
+      ++p;
+    }
+    if (!crlf) {
+      // no "\r\n" anymore, so every remaining line break counts from here
+      for (; index < len; ++index) {
+	char c = text[index];
+	if (c == '\r' || c == '\n' || c == '\f') ++line;
+      }
+      break;
+    }
+    index = (crlf - text) + 2;
+    ++line;
+  }
+  return line;
+}
+
+static bool ReadLine(TokenStream *ts, const char **line, size_t *len, bool *terminated) {
+  // Like file:read(): the next line without its '\n', or false at the end of file
+  if (ts->nextLine >= ts->dataSize) return false;
+  const char *start = ts->data + ts->nextLine;
+  size_t avail = ts->dataSize - ts->nextLine;
+  const char *nl = (const char *)memchr(start, '\n', avail);
+  *line = start;
+  *len = nl ? (size_t)(nl - start) : avail;
+  *terminated = nl != NULL;
+  ts->nextLine += *len + (nl ? 1 : 0);
+  if (ts->crlf && nl && *len > 0 && start[*len - 1] == '\r') --*len;
+  return true;
+}
+
+// with crlf, text without the '\r' of each "\r\n" (in ts->translated if there is one)
+static const char *Translate(TokenStream *ts, const char *text, size_t *len) {
+  if (!ts->crlf || memchr(text, '\r', *len) == NULL) return text;
+  std::string &out = ts->translated;
+  out.clear();
+  for (size_t i = 0; i < *len; ++i) {
+    if (text[i] == '\r' && i + 1 < *len && text[i + 1] == '\n') continue;
+    out.push_back(text[i]);
+  }
+  *len = out.size();
+  return out.data();
+}
+
+static bool NextSubjectLine(TokenStream *ts, bool first) {
+  // s = file:read() .. '\n'
+  const char *line;
+  size_t len;
+  bool terminated;
+  if (!ReadLine(ts, &line, &len, &terminated)) return false;
+  if (first && len >= 2 && (unsigned char)line[0] == 0xEF && (unsigned char)line[1] == 0xBB) {
+    // UTF-8 BOM, stripped by s:sub(4) in the Lua version
+    size_t skip = len < 3 ? len : 3;
+    line += skip;
+    len -= skip;
+  }
+  if (terminated && line[len] == '\n') {
+    ts->s = line;		// the '\n' is already in place
+  }
+  else {
+    ts->lastLine.assign(line, len);
+    ts->lastLine.push_back('\n');
+    ts->s = ts->lastLine.data();
+  }
+  ts->sz = len + 1;
+  ts->idx = 0;
+  return true;
+}
+
+static bool NextToken(TokenStream *ts, Token *tok) {
+  if (ts->exhausted) return false;
+  while (ts->idx >= ts->sz) {
+    if (!ts->fileMode) return false;
+    ++ts->line;
+    if (!NextSubjectLine(ts, false)) {
+      ts->exhausted = true;
+      return false;
+    }
+  }
+  size_t start = ts->idx, end;
+  if (ts->language == LANG_LUA) {
+    end = ScanLua(ts->s, ts->sz, start, &tok->kind);
+  }
+  else {
+    end = ScanCpp(ts->s, ts->sz, start, ts->language == LANG_CPP, ts->crlf && !ts->fileMode,
+		  &tok->kind);
+  }
+  tok->len = end - start;
+  tok->text = ts->fileMode ? ts->s + start : Translate(ts, ts->s + start, &tok->len);
+  ts->idx = end;
+  if (!ts->fileMode && (tok->kind == TK_SPACE || tok->kind == TK_COMMENT)) {
+    ts->line = CountLines(ts->line, tok->text, tok->len);
+  }
+  return true;
+}
+
+static int PushToken(lua_State *L, const TokenStream *ts, const Token *tok) {
+  const char *text = tok->text;
+  size_t len = tok->len;
+  size_t strip = 0;
+  const char *type;
+  switch (tok->kind) {
+  case TK_SPACE: type = "space"; break;
+  case TK_NAME: type = IsKeyword(ts->language, text, len) ? "keyword" : "iden"; break;
+  case TK_STRING: type = "string"; strip = 1; break;
+  case TK_LONG_STRING: type = "string"; strip = 2; break;
+  case TK_CHAR: type = "char"; strip = 1; break;
+  case TK_BACKTICK: type = "backtick"; strip = 1; break;
+  case TK_COMMENT: type = "comment"; break;
+  case TK_PREPRO: type = "prepro"; break;
+  case TK_NUMBER:
+    lua_pushliteral(L, "number");
+    lua_pushlstring(L, text, len);
+    if (ts->convertNumbers) {
+      // tonumber(tok)
+      if (lua_stringtonumber(L, lua_tostring(L, -1)) == len + 1) lua_remove(L, -2);
+      else { lua_pop(L, 1); lua_pushnil(L); }
+    }
+    return 2;
+  default:			// TK_OPERATOR
+    lua_pushlstring(L, text, len);
+    lua_pushvalue(L, -1);
+    return 2;
+  }
+  lua_pushstring(L, type);
+  if (ts->stripQuotes && strip) lua_pushlstring(L, text + strip, len - 2 * strip);
+  else lua_pushlstring(L, text, len);
+  return 2;
+}
+
+static TokenStream *CheckStream(lua_State *L) {
+  return (TokenStream *)luaL_checkudata(L, 1, STREAM_TYPE);
+}
+
+static int StreamCall(lua_State *L) {
+  TokenStream *ts = CheckStream(L);
+  Token tok;
+  if (!NextToken(ts, &tok)) return 0;
+  return PushToken(L, ts, &tok);
+}
+
+static int StreamNext(lua_State *L) {
+  // the next non-space token
+  TokenStream *ts = CheckStream(L);
+  Token tok;
+  do {
+    if (!NextToken(ts, &tok)) return 0;
+  } while (tok.kind == TK_SPACE);
+  return PushToken(L, ts, &tok);
+}
+
+static int StreamLineno(lua_State *L) {
+  lua_pushinteger(L, CheckStream(L)->line);
+  return 1;
+}
+
+static int StreamGetline(lua_State *L) {
+  // everything up to the end of the current line (the end of the subject in string mode)
+  TokenStream *ts = CheckStream(L);
+  size_t len = ts->sz - ts->idx;
+  const char *rest = ts->fileMode ? ts->s + ts->idx : Translate(ts, ts->s + ts->idx, &len);
+  ts->idx = ts->sz;
+  ++ts->line;
+  if (len > 1) {
+    lua_pushlstring(L, rest, len - 1);
+    return 1;
+  }
+  if (!ts->fileMode) return luaL_error(L, "getline: end of string reached");
+  const char *line;
+  bool terminated;
+  if (!ReadLine(ts, &line, &len, &terminated)) return 0;
+  lua_pushlstring(L, line, len);
+  return 1;
+}
+
+static int StreamGC(lua_State *L) {
+  CheckStream(L)->~TokenStream();
+  return 0;
+}
+
+/* Highlighting, as in prettify.lua: the output is built in one buffer instead
+ * of a list of spans, so the element of the name before a call, which becomes
+ * a 'function-name' span, is remembered by position. */
+
+static void AppendSpan(std::string *out, const char *cls, const std::string &val) {
+  out->append("<span class=\"");
+  out->append(cls);
+  out->append("\">");
+  out->append(val);
+  out->append("</span>");
+}
+
+// t[val] for the table at idx
+static bool InSet(lua_State *L, int idx, const std::string &val) {
+  lua_pushlstring(L, val.data(), val.size());
+  bool found = lua_rawget(L, idx) != LUA_TNIL && lua_toboolean(L, -1);
+  lua_pop(L, 1);
+  return found;
+}
+
+static int LexerHighlight(lua_State *L) {
+  size_t len;
+  const char *code = luaL_checklstring(L, 1, &len);
+  Language language = lua_toboolean(L, 2) ? LANG_CPP : LANG_LUA;
+  bool pre = lua_toboolean(L, 3);
+  bool linenos = lua_toboolean(L, 4);
+  luaL_checktype(L, 5, LUA_TTABLE);
+  luaL_checktype(L, 6, LUA_TTABLE);
+  luaL_checktype(L, 7, LUA_TFUNCTION);
+  lua_settop(L, 7);
+  if (len == 0) {
+    lua_pushnil(L);
+    lua_pushliteral(L, "empty file");
+    return 2;
+  }
+  lua_getfield(L, 5, "functions");	// 8
+  lua_getfield(L, 5, "tables");		// 9
+  luaL_checktype(L, 8, LUA_TTABLE);
+  luaL_checktype(L, 9, LUA_TTABLE);
+  lua_pushnil(L);
+  bool userKeywords = lua_next(L, 6) != 0;
+  lua_settop(L, 9);
+
+  // a stream on the string, like lexer.lua(code,{},{}): no conversions
+  TokenStream ts;
+  ts.language = language;
+  ts.convertNumbers = ts.stripQuotes = false;
+  ts.fileMode = ts.crlf = ts.exhausted = false;
+  ts.s = code;
+  ts.sz = len;
+  ts.idx = 0;
+  ts.line = 1;
+  ts.data = NULL;
+  ts.dataSize = ts.nextLine = 0;
+  ts.source = NULL;
+
+  std::string out, val, lastVal;
+  out.reserve(len * 2);
+  if (pre) out.append("<pre>\n");
+  lua_Integer ik = 1;
+  size_t start = 0;		// the element of the current token
+  size_t idenStart = 0, idenLen = 0;	// the last non-space token, if a plain name
+  bool lastIden = false, lastComment = false;
+  Token tok;
+  while (NextToken(&ts, &tok)) {
+    val.clear();
+    ldoc_html_append_escaped(&val, tok.text, tok.len, true);
+    if (linenos) {
+      lua_rawgeti(L, 4, ik);
+      lua_pushinteger(L, ts.line);
+      if (lua_compare(L, -1, -2, LUA_OPEQ)) {
+	lua_pop(L, 1);
+	out.append("<a id=\"");
+	out.append(lua_tostring(L, -1));
+	out.append("\"></a>");
+	++ik;
+      }
+      else lua_pop(L, 1);
+      lua_pop(L, 1);
+    }
+
+    const char *type = NULL;	// NULL for operators, whose type is the value itself
+    bool span = true;
+    switch (tok.kind) {
+    case TK_SPACE: type = "space"; span = false; break;
+    case TK_NUMBER: type = "number"; break;
+    case TK_NAME:
+      if (IsKeyword(language, tok.text, tok.len)) type = "keyword";
+      else {
+	type = "iden";
+	span = false;
+      }
+      // the keys of globals.functions and globals.tables are all names
+      if (InSet(L, 8, val) || InSet(L, 9, val)) {
+	type = "global";
+	span = true;
+      }
+      break;
+    case TK_STRING: case TK_LONG_STRING: type = "string"; break;
+    case TK_CHAR: type = "char"; span = false; break;
+    case TK_BACKTICK: type = "backtick"; break;
+    case TK_COMMENT: type = "comment"; break;
+    case TK_PREPRO: type = "prepro"; span = false; break;
+    default: span = false; break;
+    }
+
+    bool userKeyword = userKeywords && InSet(L, 6, val);
+    start = out.size();
+    if (userKeyword) {
+      AppendSpan(&out, ("user-keyword keyword-" + val).c_str(), val);
+    }
+    else if (span) {
+      if (tok.kind == TK_COMMENT || tok.kind == TK_BACKTICK) {	// may contain @{ref} or `..`
+	lua_pushvalue(L, 7);
+	lua_pushlstring(L, val.data(), val.size());
+	lua_pushinteger(L, ts.line);
+	lua_call(L, 2, 1);
+	size_t n;
+	const char *resolved = luaL_tolstring(L, -1, &n);
+	val.assign(resolved, n);
+	lua_pop(L, 2);
+      }
+      AppendSpan(&out, type, val);
+    }
+    else out.append(val);
+
+    bool delimiter = val.size() == 1 && strchr("({\"'", val[0]);
+    if ((tok.kind == TK_STRING || tok.kind == TK_LONG_STRING || delimiter) && lastIden) {
+      static const char OPEN[] = "<span class=\"function-name\">", CLOSE[] = "</span>";
+      out.insert(idenStart + idenLen, CLOSE);
+      out.insert(idenStart, OPEN);
+      start += sizeof(OPEN) - 1 + sizeof(CLOSE) - 1;
+    }
+    if (tok.kind != TK_SPACE) {
+      // user keywords don't become function names
+      lastIden = !userKeyword && type && strcmp(type, "iden") == 0;
+      idenStart = start;
+      idenLen = out.size() - start;
+    }
+    lastComment = tok.kind == TK_COMMENT;
+    if (lastComment) lastVal = val;
+  }
+
+  if (lastComment) {
+    // the final comment, without its line end
+    out.resize(start);
+    if (!lastVal.empty() && lastVal.back() == '\n') {
+      lastVal.pop_back();
+      while (!lastVal.empty() && lastVal.back() == '\r') lastVal.pop_back();
+    }
+    AppendSpan(&out, "comment", lastVal);
+  }
+  if (out.size() > start && out.back() == '\n') {
+    // the last element loses all of its line ends
+    size_t j = start;
+    for (size_t i = start; i < out.size(); ++i)
+      if (out[i] != '\n') out[j++] = out[i];
+    out.resize(j);
+  }
+  if (pre) out.append("</pre>\n");
+  lua_pushlstring(L, out.data(), out.size());
+  return 1;
+}
+
+// input of a stream: argument 1 is a string, a file handle or a file name
+enum StreamInput {
+  INPUT_STRING,
+  INPUT_HANDLE,
+  INPUT_NAMED_FILE
+};
+
+static int NewStream(lua_State *L, Language language, StreamInput input) {
+  bool convertNumbers = true, stripQuotes = true;
+  if (!lua_isnoneornil(L, 2)) {
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_getfield(L, 2, "number");
+    convertNumbers = lua_toboolean(L, -1);
+    lua_getfield(L, 2, "string");
+    stripQuotes = lua_toboolean(L, -1);
+    lua_pop(L, 2);
+  }
+
+  luaL_Stream *fh = NULL;
+  LDocSource *source = NULL;
+  if (input == INPUT_NAMED_FILE) {
+    std::string error;
+    source = ldoc_source_open(luaL_checkstring(L, 1), &error);
+    if (source == NULL) {
+      lua_pushnil(L);
+      lua_pushlstring(L, error.data(), error.size());
+      return 2;
+    }
+  }
+  else if (input == INPUT_HANDLE) {
+    fh = (luaL_Stream *)luaL_checkudata(L, 1, LUA_FILEHANDLE);
+    if (fh->closef == NULL) return luaL_error(L, "attempt to use a closed file");
+  }
+  else if (lua_rawlen(L, 1) == 0) {
+    lua_pushnil(L);		// empty string
+    return 1;
+  }
+
+  TokenStream *ts = new (lua_newuserdatauv(L, sizeof(TokenStream), 1)) TokenStream();
+  luaL_setmetatable(L, STREAM_TYPE);
+  ts->language = language;
+  ts->convertNumbers = convertNumbers;
+  ts->stripQuotes = stripQuotes;
+  /* Lua sources are read line by line, like from a file handle; C sources
+   * were always read as a whole and scanned like a string */
+  ts->fileMode = input == INPUT_HANDLE || (input == INPUT_NAMED_FILE && language == LANG_LUA);
+  ts->crlf = source != NULL && ldoc_source_crlf(source);
+  ts->exhausted = false;
+  ts->line = 1;
+  ts->idx = 0;
+  ts->nextLine = 0;
+  ts->source = source;
+
+  if (input == INPUT_HANDLE) {
+    /* Read the remaining file at once through the same FILE*, so that the C
+     * runtime applies the same text mode translation as file:read() would. */
+    char buffer[16384];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fh->f)) > 0) ts->buffer.append(buffer, n);
+    ts->data = ts->buffer.data();
+    ts->dataSize = ts->buffer.size();
+  }
+  else if (input == INPUT_NAMED_FILE) {
+    ts->data = ldoc_source_data(source, &ts->dataSize);
+  }
+
+  if (ts->fileMode) {
+    if (!NextSubjectLine(ts, true)) {
+      lua_pushnil(L);		// empty file
+      return 1;
+    }
+  }
+  else if (input == INPUT_NAMED_FILE) {
+    ts->s = ts->data;
+    ts->sz = ts->dataSize;
+    if (ts->sz >= 3 && memcmp(ts->s, "\xEF\xBB\xBF", 3) == 0) {	// UTF-8 BOM
+      ts->s += 3;
+      ts->sz -= 3;
+    }
+    if (ts->sz == 0) {
+      lua_pushnil(L);		// empty file
+      return 1;
+    }
+  }
+  else {
+    ts->s = lua_tolstring(L, 1, &ts->sz);
+    lua_pushvalue(L, 1);	// keep the subject alive as long as the stream
+    lua_setiuservalue(L, -2, 1);
+  }
+  return 1;
+}
+
+static StreamInput Input(lua_State *L) {
+  return lua_type(L, 1) == LUA_TSTRING ? INPUT_STRING : INPUT_HANDLE;
+}
+
+static int LexerLua(lua_State *L) {
+  return NewStream(L, LANG_LUA, Input(L));
+}
+
+static int LexerCpp(lua_State *L) {
+  return NewStream(L, lua_toboolean(L, 3) ? LANG_CPP_NO_STRING : LANG_CPP, Input(L));
+}
+
+static int LexerLuaFile(lua_State *L) {
+  return NewStream(L, LANG_LUA, INPUT_NAMED_FILE);
+}
+
+static int LexerCppFile(lua_State *L) {
+  return NewStream(L, lua_toboolean(L, 3) ? LANG_CPP_NO_STRING : LANG_CPP, INPUT_NAMED_FILE);
+}
+
+int luaopen_ldoc_lexer(lua_State *L) {
+  static const luaL_Reg methods[] = {
+    {"lineno", StreamLineno},
+    {"getline", StreamGetline},
+    {"next", StreamNext},
+    {NULL, NULL}
+  };
+  static const luaL_Reg functions[] = {
+    {"lua", LexerLua},
+    {"cpp", LexerCpp},
+    {"lua_file", LexerLuaFile},
+    {"cpp_file", LexerCppFile},
+    {"highlight", LexerHighlight},
+    {NULL, NULL}
+  };
+  if (luaL_newmetatable(L, STREAM_TYPE)) {
+    luaL_newlib(L, methods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, StreamCall);
+    lua_setfield(L, -2, "__call");
+    lua_pushcfunction(L, StreamGC);
+    lua_setfield(L, -2, "__gc");
+  }
+  lua_pop(L, 1);
+  luaL_newlib(L, functions);
+  return 1;
+}
@@ -0,0 +1,1141 @@
+/**
+ * @file ldoc_markdown.cpp
+ * @brief Markdown to HTML, as format = 'native' (see ldoc/markup.lua).
+ *
+ * Does what ldoc/markdown.lua does, step by step and with the same Lua patterns,
+ * so that both give the same HTML; only the bookkeeping is done natively (the
+ * placeholders for protected blocks and escaped text are looked up and replaced
+ * in one pass, instead of once for each of them, which is what makes
+ * markdown.lua slow on large documents). LDoc hands over text that is already
+ * pre-processed: code has been highlighted into <pre> blocks and @{references}
+ * have become links, which both renderers pass through as raw HTML.
+ *
+ * Two deliberate differences to markdown.lua, which suit source code
+ * documentation better (see tests/markdown/differences.md):
+ * - underscores inside words never start or end emphasis (no need to escape
+ *   them in identifiers like some_function)
+ * - e-mail autolinks are not obfuscated with character entities
+ *
+ * Interface:
+ * - ldoc_markdown.render(s) -> HTML text
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ldoc_native.h"
+
+#define TAB_WIDTH 4
+#define MAX_CAPTURES 4
+
+// characters that a backslash makes literal, as in markdown.lua
+static const char ESCAPE_CHARS[] = "'\\`*_{}[]()>#+-.!";
+
+// HTML tags whose blocks are passed through as they are
+static const char *const BLOCK_TAGS[] = {
+  "p", "div", "h1", "h2", "h3", "h4", "h5", "h6", "blockquote", "pre", "table",
+  "dl", "ol", "ul", "script", "noscript", "form", "fieldset", "iframe", "math",
+  "ins", "del", NULL
+};
+
+/* -----------------------------------------------------------------------------
+ * Lua patterns
+ *
+ * A matcher for Lua patterns, which works like string.find and string.gsub of
+ * Lua 5.4 (lstrlib.c), so that the patterns of markdown.lua can be used as
+ * they are. Positions are 0-based and ends exclusive.
+ */
+
+#define CAP_UNFINISHED (-1)
+
+struct MatchState {
+  const char *src, *srcEnd, *patEnd;
+  int level;
+  struct {
+    const char *init;
+    ptrdiff_t len;
+  } capture[MAX_CAPTURES];
+};
+
+// a match: where it starts and ends, and its captures
+struct Match {
+  size_t start, end;
+  int level;
+  std::string capture[MAX_CAPTURES];
+};
+
+static const char *DoMatch(MatchState *ms, const char *s, const char *p);
+
+static const char *ClassEnd(const char *p) {
+  if (*p == '%') return p + 2;
+  if (*p++ == '[') {
+    if (*p == '^') ++p;
+    do {			// look for a ']'; the first character may be one
+      if (*p++ == '%') ++p;
+    } while (*p != ']');
+    return p + 1;
+  }
+  return p;
+}
+
+static bool MatchClass(int c, int cl) {
+  bool res;
+  switch (tolower(cl)) {
+  case 'a': res = isalpha(c); break;
+  case 'c': res = iscntrl(c); break;
+  case 'd': res = isdigit(c); break;
+  case 'g': res = isgraph(c); break;
+  case 'l': res = islower(c); break;
+  case 'p': res = ispunct(c); break;
+  case 's': res = isspace(c); break;
+  case 'u': res = isupper(c); break;
+  case 'w': res = isalnum(c); break;
+  case 'x': res = isxdigit(c); break;
+  default: return cl == c;
+  }
+  return isupper(cl) ? !res : res;
+}
+
+// p is at '[' and ec at the closing ']'
+static bool MatchBracketClass(int c, const char *p, const char *ec) {
+  bool sig = true;
+  if (*(p + 1) == '^') {
+    sig = false;
+    ++p;
+  }
+  while (++p < ec) {
+    if (*p == '%') {
+      ++p;
+      if (MatchClass(c, (unsigned char)*p)) return sig;
+    }
+    else if (*(p + 1) == '-' && p + 2 < ec) {
+      p += 2;
+      if ((unsigned char)*(p - 2) <= c && c <= (unsigned char)*p) return sig;
+    }
+    else if ((unsigned char)*p == c) {
+      return sig;
+    }
+  }
+  return !sig;
+}
+
+static bool SingleMatch(MatchState *ms, const char *s, const char *p, const char *ep) {
+  if (s >= ms->srcEnd) return false;
+  int c = (unsigned char)*s;
+  switch (*p) {
+  case '.': return true;
+  case '%': return MatchClass(c, (unsigned char)*(p + 1));
+  case '[': return MatchBracketClass(c, p, ep - 1);
+  default: return (unsigned char)*p == c;
+  }
+}
+
+static const char *MatchBalance(MatchState *ms, const char *s, const char *p) {
+  if (s >= ms->srcEnd || *s != *p) return NULL;
+  int b = *p, e = *(p + 1), cont = 1;
+  while (++s < ms->srcEnd) {
+    if (*s == e) {
+      if (--cont == 0) return s + 1;
+    }
+    else if (*s == b) {
+      ++cont;
+    }
+  }
+  return NULL;
+}
+
+static const char *MaxExpand(MatchState *ms, const char *s, const char *p, const char *ep) {
+  ptrdiff_t i = 0;
+  while (SingleMatch(ms, s + i, p, ep)) ++i;
+  for (; i >= 0; --i) {		// try with the most repetitions first
+    const char *res = DoMatch(ms, s + i, ep + 1);
+    if (res) return res;
+  }
+  return NULL;
+}
+
+static const char *MinExpand(MatchState *ms, const char *s, const char *p, const char *ep) {
+  for (;;) {
+    const char *res = DoMatch(ms, s, ep + 1);
+    if (res) return res;
+    if (!SingleMatch(ms, s, p, ep)) return NULL;
+    ++s;
+  }
+}
+
+static const char *StartCapture(MatchState *ms, const char *s, const char *p) {
+  if (ms->level >= MAX_CAPTURES) {
+    /* lstrlib raises "too many captures"; there is no state to raise it in
+     * here, and the patterns are those of this file, so complain and fail */
+    fprintf(stderr, "ldoc_markdown: too many captures in a pattern (at most %d)\n", MAX_CAPTURES);
+    return NULL;
+  }
+  ms->capture[ms->level].init = s;
+  ms->capture[ms->level].len = CAP_UNFINISHED;
+  ms->level++;
+  const char *res = DoMatch(ms, s, p);
+  if (res == NULL) ms->level--;
+  return res;
+}
+
+static const char *EndCapture(MatchState *ms, const char *s, const char *p) {
+  int l = ms->level - 1;
+  while (ms->capture[l].len != CAP_UNFINISHED) --l;
+  ms->capture[l].len = s - ms->capture[l].init;
+  const char *res = DoMatch(ms, s, p);
+  if (res == NULL) ms->capture[l].len = CAP_UNFINISHED;
+  return res;
+}
+
+static const char *DoMatch(MatchState *ms, const char *s, const char *p) {
+  while (p != ms->patEnd) {
+    switch (*p) {
+    case '(':
+      return StartCapture(ms, s, p + 1);
+    case ')':
+      return EndCapture(ms, s, p + 1);
+    case '$':
+      if (p + 1 == ms->patEnd) return s == ms->srcEnd ? s : NULL;
+      break;
+    case '%':
+      if (*(p + 1) == 'b') {
+	s = MatchBalance(ms, s, p + 2);
+	if (s == NULL) return NULL;
+	p += 4;
+	continue;
+      }
+      break;
+    default:
+      break;
+    }
+    const char *ep = ClassEnd(p);
+    if (!SingleMatch(ms, s, p, ep)) {
+      if (*ep == '*' || *ep == '?' || *ep == '-') {	// accept empty
+	p = ep + 1;
+	continue;
+      }
+      return NULL;
+    }
+    switch (*ep) {
+    case '?': {
+      const char *res = DoMatch(ms, s + 1, ep + 1);
+      if (res) return res;
+      p = ep + 1;
+      continue;
+    }
+    case '+': return MaxExpand(ms, s + 1, p, ep);
+    case '*': return MaxExpand(ms, s, p, ep);
+    case '-': return MinExpand(ms, s, p, ep);
+    default:
+      ++s;
+      p = ep;
+      continue;
+    }
+  }
+  return s;
+}
+
+static void GetMatch(const MatchState &ms, const char *s, const char *e, Match *m) {
+  m->start = s - ms.src;
+  m->end = e - ms.src;
+  m->level = ms.level;
+  for (int i = 0; i < ms.level; ++i) {
+    m->capture[i].assign(ms.capture[i].init, ms.capture[i].len);
+  }
+  if (ms.level == 0) m->capture[0].assign(s, e - s);	// the whole match, as in gsub
+}
+
+// string.find(s, pat, init + 1)
+static bool Find(const std::string &s, const char *pat, size_t init, Match *m) {
+  if (init > s.size()) return false;
+  MatchState ms;
+  ms.src = s.data();
+  ms.srcEnd = s.data() + s.size();
+  bool anchor = *pat == '^';
+  if (anchor) ++pat;
+  ms.patEnd = pat + strlen(pat);
+  if (!anchor && strpbrk(pat, "^$*+?.([%-") == NULL) {	// plain text
+    size_t at = s.find(pat, init);
+    if (at == std::string::npos) return false;
+    m->start = at;
+    m->end = at + strlen(pat);
+    m->level = 0;
+    return true;
+  }
+  const char *s1 = ms.src + init;
+  do {
+    ms.level = 0;
+    const char *e = DoMatch(&ms, s1, pat);
+    if (e) {
+      GetMatch(ms, s1, e, m);
+      return true;
+    }
+  } while (s1++ < ms.srcEnd && !anchor);
+  return false;
+}
+
+static bool Find(const std::string &s, const std::string &pat, size_t init, Match *m) {
+  return Find(s, pat.c_str(), init, m);
+}
+
+// string.match(s, pat) ~= nil
+static bool Matches(const std::string &s, const char *pat) {
+  Match m;
+  return Find(s, pat, 0, &m);
+}
+
+/* string.gsub(s, pat, repl) with a function: repl(m, &text) gives the text to
+ * replace the match m with, or false to keep it. */
+template <typename Repl>
+static std::string Gsub(const std::string &s, const char *pat, Repl repl, int *count = NULL) {
+  MatchState ms;
+  ms.src = s.data();
+  ms.srcEnd = s.data() + s.size();
+  bool anchor = *pat == '^';
+  if (anchor) ++pat;
+  ms.patEnd = pat + strlen(pat);
+  const char *src = ms.src, *lastMatch = NULL;
+  std::string out;
+  int n = 0;
+  for (;;) {
+    ms.level = 0;
+    const char *e = DoMatch(&ms, src, pat);
+    if (e != NULL && e != lastMatch) {
+      ++n;
+      Match m;
+      GetMatch(ms, src, e, &m);
+      std::string text;
+      if (repl(m, &text)) out.append(text);
+      else out.append(src, e - src);
+      src = lastMatch = e;
+    }
+    else if (src < ms.srcEnd) {
+      out.push_back(*src++);
+    }
+    else {
+      break;
+    }
+    if (anchor) break;
+  }
+  out.append(src, ms.srcEnd - src);
+  if (count) *count = n;
+  return out;
+}
+
+// string.gsub(s, pat, repl) with a string, where %1 stands for the first capture
+static std::string Gsub(const std::string &s, const char *pat, const std::string &repl,
+			int *count = NULL) {
+  return Gsub(s, pat, [&](const Match &m, std::string *text) {
+    for (size_t i = 0; i < repl.size(); ++i) {
+      if (repl[i] == '%' && i + 1 < repl.size()) {
+	char d = repl[++i];
+	if (isdigit((unsigned char)d)) text->append(m.capture[d == '0' ? 0 : d - '1']);
+	else text->push_back(d);
+      }
+      else {
+	text->push_back(repl[i]);
+      }
+    }
+    return true;
+  }, count);
+}
+
+// string.gsub(s, plain, repl) for plain text, as markdown.lua does for its hashes
+static std::string Replace(const std::string &s, const std::string &plain, const std::string &repl) {
+  std::string out;
+  size_t pos = 0;
+  for (size_t at = s.find(plain); at != std::string::npos; at = s.find(plain, pos)) {
+    out.append(s, pos, at - pos).append(repl);
+    pos = at + plain.size();
+  }
+  return out.append(s, pos, std::string::npos);
+}
+
+/* -----------------------------------------------------------------------------
+ * Helpers
+ */
+
+static std::vector<std::string> Split(const std::string &text) {
+  std::vector<std::string> lines;
+  size_t pos = 0;
+  for (size_t nl = text.find('\n'); nl != std::string::npos; nl = text.find('\n', pos)) {
+    lines.push_back(text.substr(pos, nl - pos));
+    pos = nl + 1;
+  }
+  lines.push_back(text.substr(pos));
+  return lines;
+}
+
+static std::string Join(const std::vector<std::string> &lines) {
+  std::string text;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (i > 0) text.push_back('\n');
+    text.append(lines[i]);
+  }
+  return text;
+}
+
+// tabs become spaces, up to the next multiple of TAB_WIDTH
+static std::string Detab(const std::string &text) {
+  if (text.find('\t') == std::string::npos) return text;
+  std::string out;
+  size_t column = 0;
+  for (char c : text) {
+    if (c == '\t') {
+      size_t spaces = TAB_WIDTH - column % TAB_WIDTH;
+      out.append(spaces, ' ');
+      column += spaces;
+    }
+    else {
+      out.push_back(c);
+      column = c == '\n' ? 0 : column + 1;
+    }
+  }
+  return out;
+}
+
+static std::string Lower(std::string s) {
+  for (char &c : s) c = (char)tolower((unsigned char)c);
+  return s;
+}
+
+// removes up to one level of indentation
+static std::string Outdent(const std::string &text) {
+  return Gsub("\n" + text, "\n  ? ? ?", std::string("\n")).substr(1);
+}
+
+static std::string Indent(const std::string &text) {
+  return Replace(text, "\n", "\n    ");
+}
+
+// escapes & " and < in attribute values
+static std::string EncodeAlt(const std::string &s) {
+  return Replace(Replace(Replace(s, "&", "&amp;"), "\"", "&quot;"), "<", "&lt;");
+}
+
+// the first of the patterns to match, as find_first does
+static bool FindFirst(const std::string &s, const std::vector<std::string> &patterns, size_t init,
+		      Match *m) {
+  bool found = false;
+  for (const std::string &p : patterns) {
+    Match pm;
+    if (Find(s, p, init, &pm) && (!found || pm.start < m->start)) {
+      *m = pm;
+      found = true;
+    }
+  }
+  return found;
+}
+
+/* -----------------------------------------------------------------------------
+ * Document state
+ */
+
+struct LinkDef {
+  bool hasUrl = false, hasTitle = false;
+  std::string url, title;
+};
+
+/* A pattern for HTML blocks, which starts with `open`. If it `spans`, it goes
+ * on with '.-', so once it fails after its opening it cannot match further on. */
+struct BlockPattern {
+  std::string open, pattern;
+  bool spans, failed;
+};
+
+struct LineInfo {
+  enum Type { BLANK, NORMAL, INDENTED, RULER, HEADER, LIST_ITEM, BLOCKQUOTE, RAW } type;
+  std::string line, text, html;
+  char rulerChar = 0;
+  int level = 0;
+  bool numeric = false;
+};
+
+typedef std::vector<LineInfo> LineInfos;
+
+struct Markdown {
+  /* Protected blocks and escaped text are replaced by unique hashes, which
+   * are made of letters and digits, so that no pattern sees what they stand
+   * for. These are exactly the hashes markdown.lua uses. */
+  std::string hashId;
+  std::map<std::string, size_t> hashes;	// the text each hash stands for, by text
+  std::vector<std::string> hashed;	// ... and by number
+  std::vector<bool> isBlock, isEscape;
+  std::map<std::string, std::string> escapes;
+  std::map<std::string, LinkDef> links;
+
+  void InitHash(const std::string &text);
+  std::string Hash(const std::string &s);
+  std::string AddEscape(const std::string &s);
+  const std::string &Escape(char c) { return escapes[std::string(1, c)]; }
+  size_t HashAt(const std::string &s, size_t i, size_t *len);
+  std::string Expand(const std::string &s, const std::vector<bool> &which);
+
+  std::string ProtectMatches(const std::string &text, std::vector<BlockPattern> patterns);
+  std::string Protect(const std::string &text);
+  std::string StripLinkDefinitions(const std::string &text);
+  LineInfo Classify(const std::string &line);
+  std::string BlockTransform(const std::string &text, bool sublist);
+  LineInfos Lists(LineInfos lines, bool sublist);
+  std::string ProcessList(LineInfos lines);
+  LineInfos Codeblocks(LineInfos lines);
+  LineInfos Blockquotes(LineInfos lines);
+  std::vector<std::string> BlocksToHtml(const LineInfos &lines, bool noParagraphs);
+
+  std::string EncodeCode(const std::string &s);
+  std::string CodeSpans(std::string s);
+  std::string EscapeSpecialChars(const std::string &text);
+  std::string EncodeBackslashEscapes(std::string t);
+  std::string Images(const std::string &text);
+  std::string Anchors(const std::string &text);
+  std::string AutoLinks(const std::string &text);
+  std::string IntrawordUnderscores(const std::string &text);
+  std::string SpanTransform(const std::string &text);
+};
+
+void Markdown::InitHash(const std::string &text) {
+  for (int counter = 0;; ++counter) {
+    hashId = "HASH" + std::to_string(counter);
+    if (text.find(hashId) == std::string::npos) break;
+  }
+  hashed.assign(1, std::string());
+  isBlock.assign(1, false);
+  isEscape.assign(1, false);
+}
+
+std::string Markdown::Hash(const std::string &s) {
+  auto it = hashes.find(s);
+  size_t n;
+  if (it != hashes.end()) {
+    n = it->second;
+  }
+  else {
+    n = hashed.size();
+    hashes[s] = n;
+    hashed.push_back(s);
+    isBlock.push_back(false);
+    isEscape.push_back(false);
+  }
+  return hashId + std::to_string(n) + "X";
+}
+
+std::string Markdown::AddEscape(const std::string &s) {
+  auto it = escapes.find(s);
+  if (it != escapes.end()) return it->second;
+  std::string h = Hash(s);
+  isEscape[hashes[s]] = true;
+  return escapes[s] = h;
+}
+
+// the number of the hash at s[i] and its length, or 0
+size_t Markdown::HashAt(const std::string &s, size_t i, size_t *len) {
+  if (s.compare(i, hashId.size(), hashId) != 0) return 0;
+  size_t j = i + hashId.size(), n = 0;
+  while (j < s.size() && isdigit((unsigned char)s[j]) && n < hashed.size()) {
+    n = n * 10 + (s[j++] - '0');
+  }
+  if (j >= s.size() || s[j] != 'X' || n == 0 || n >= hashed.size()) return 0;
+  *len = j + 1 - i;
+  return n;
+}
+
+/* replaces the hashes of the kind `which` by what they stand for, until
+ * there are none left (like unprotect and unescape_special_chars) */
+std::string Markdown::Expand(const std::string &s, const std::vector<bool> &which) {
+  std::string out;
+  size_t pos = 0, at = s.find(hashId);
+  while (at != std::string::npos) {
+    size_t len, n = HashAt(s, at, &len);
+    if (n == 0 || !which[n]) {
+      at = s.find(hashId, at + 1);
+      continue;
+    }
+    out.append(s, pos, at - pos).append(Expand(hashed[n], which));
+    pos = at + len;
+    at = s.find(hashId, pos);
+  }
+  if (pos == 0) return s;
+  return out.append(s, pos, std::string::npos);
+}
+
+/* -----------------------------------------------------------------------------
+ * Block transform
+ */
+
+/* HTML blocks are replaced by hashes on lines of their own. markdown.lua looks
+ * for the first match of any of the patterns again and again, from the start;
+ * as nothing before a protected block changes, one pass over the text finds
+ * the same blocks. */
+std::string Markdown::ProtectMatches(const std::string &text, std::vector<BlockPattern> patterns) {
+  std::string out;
+  size_t pos = 0;
+  for (size_t at = text.find("\n<"); at != std::string::npos; at = text.find("\n<", at + 1)) {
+    for (BlockPattern &p : patterns) {
+      if (p.failed || text.compare(at, p.open.size(), p.open) != 0) continue;
+      Match m;
+      if (!Find(text, p.pattern, at, &m)) {
+	p.failed = p.spans;
+	continue;
+      }
+      std::string block = text.substr(m.start, m.end - m.start);
+      out.append(text, pos, at + 1 - pos).append(Hash(block));
+      isBlock[hashes[block]] = true;
+      pos = m.end - 1;		// the line end after the block
+      at = pos - 1;
+      break;
+    }
+  }
+  return out.append(text, pos, std::string::npos);
+}
+
+std::string Markdown::Protect(const std::string &text) {
+  std::vector<BlockPattern> blocks, lines;
+  for (int i = 0; BLOCK_TAGS[i] != NULL; ++i) {
+    std::string tag = BLOCK_TAGS[i];
+    blocks.push_back({"\n<" + tag, "^\n<" + tag + ".-\n</" + tag + ">[ \t]*\n", true, false});
+    lines.push_back({"\n<" + tag, "^\n<" + tag + ".-</" + tag + ">[ \t]*\n", true, false});
+  }
+  std::string s = ProtectMatches(text, blocks);
+  s = ProtectMatches(s, lines);
+  s = ProtectMatches(s, {{"\n<hr", "^\n<hr[^>]->[ \t]*\n", false, false}});
+  return ProtectMatches(s, {{"\n<!--", "^\n<!%-%-.-%-%->[ \t]*\n", true, false}});
+}
+
+std::string Markdown::StripLinkDefinitions(const std::string &text) {
+  auto linkDef = [&](const Match &m, std::string *out) {
+    Match id;
+    Find(m.capture[0], "%[(.+)%]", 0, &id);
+    LinkDef &def = links[Lower(id.capture[0])];
+    def.url = m.capture[1];
+    def.hasUrl = true;
+    if (m.level > 2) {
+      def.title = m.capture[2];
+      def.hasTitle = true;
+    }
+    out->clear();
+    return true;
+  };
+  std::string noTitle = "\n ? ? ?(%b[]):[ \t]*\n?[ \t]*<?([^%s>]+)>?[ \t]*";
+  std::string title1 = noTitle + "[ \t]+\n?[ \t]*[\"'(]([^\n]+)[\"')][ \t]*";
+  std::string title2 = noTitle + "[ \t]*\n[ \t]*[\"'(]([^\n]+)[\"')][ \t]*";
+  std::string title3 = noTitle + "[ \t]*\n?[ \t]+[\"'(]([^\n]+)[\"')][ \t]*";
+  std::string s = Gsub(text, title1.c_str(), linkDef);
+  s = Gsub(s, title2.c_str(), linkDef);
+  s = Gsub(s, title3.c_str(), linkDef);
+  return Gsub(s, noTitle.c_str(), linkDef);
+}
+
+static bool IsRulerOf(const std::string &line, char c) {
+  std::string only = std::string("^[ %") + c + "]*$";
+  std::string three = std::string("%") + c + ".*%" + c + ".*%" + c;
+  return Matches(line, only.c_str()) && Matches(line, three.c_str());
+}
+
+LineInfo Markdown::Classify(const std::string &line) {
+  LineInfo info;
+  info.line = info.text = line;
+  Match m;
+  size_t n, len;
+  if (line.compare(0, 4, "    ") == 0) {
+    info.type = LineInfo::INDENTED;
+    return info;
+  }
+  for (char c : {'*', '-', '_', '='}) {
+    if (IsRulerOf(line, c)) {
+      info.type = LineInfo::RULER;
+      info.rulerChar = c;
+      return info;
+    }
+  }
+  if (line.empty()) {
+    info.type = LineInfo::BLANK;
+  }
+  else if (Find(line, "^(#+)[ \t]*(.-)[ \t]*#*[ \t]*$", 0, &m)) {
+    info.type = LineInfo::HEADER;
+    info.level = (int)m.capture[0].size();
+    info.text = m.capture[1];
+  }
+  else if (Find(line, "^ ? ? ?(%d+)%.[ \t]+(.+)", 0, &m)) {
+    info.type = LineInfo::LIST_ITEM;
+    info.numeric = true;
+    info.text = m.capture[1];
+  }
+  else if (Find(line, "^ ? ? ?([%*%+%-])[ \t]+(.+)", 0, &m)) {
+    info.type = LineInfo::LIST_ITEM;
+    info.text = m.capture[1];
+  }
+  else if (Find(line, "^>[ \t]?(.*)", 0, &m)) {
+    info.type = LineInfo::BLOCKQUOTE;
+    info.text = m.capture[0];
+  }
+  else if ((n = HashAt(line, 0, &len)) != 0 && isBlock[n] && len == line.size()) {
+    info.type = LineInfo::RAW;
+    info.html = Expand(line, isBlock);
+  }
+  else {
+    info.type = LineInfo::NORMAL;
+  }
+  return info;
+}
+
+static LineInfo Raw(const std::string &html) {
+  LineInfo info;
+  info.type = LineInfo::RAW;
+  info.line = info.html = html;
+  return info;
+}
+
+static void Splice(LineInfos *lines, size_t start, size_t stop, const LineInfo &info) {
+  lines->erase(lines->begin() + start + 1, lines->begin() + stop + 1);
+  (*lines)[start] = info;
+}
+
+// a normal line followed by a ruler of '-' or '=' is a header
+static void Headers(LineInfos *lines) {
+  for (size_t i = 0; i + 1 < lines->size(); ++i) {
+    LineInfo &a = (*lines)[i], &b = (*lines)[i + 1];
+    if (a.type == LineInfo::NORMAL && b.type == LineInfo::RULER &&
+	(b.rulerChar == '-' || b.rulerChar == '=')) {
+      a.type = LineInfo::HEADER;
+      a.text = a.line;
+      a.level = b.rulerChar == '=' ? 1 : 2;
+      lines->erase(lines->begin() + i + 1);
+    }
+  }
+}
+
+std::string Markdown::ProcessList(LineInfos lines) {
+  bool block = false;
+  for (const LineInfo &l : lines) block = block || l.type == LineInfo::BLANK;
+  std::string out;
+  for (size_t i = 0; i < lines.size();) {
+    size_t j = i + 1;			// the lines of this item
+    while (j < lines.size() && lines[j].type != LineInfo::LIST_ITEM) ++j;
+    size_t last = j;
+    while (lines[last - 1].type == LineInfo::BLANK) --last;
+    std::string text = lines[i].text;
+    for (size_t k = i + 1; k < last; ++k) text += "\n" + Outdent(lines[k].line);
+    if (block) {
+      text = BlockTransform(text, true);
+    }
+    else {
+      LineInfos item;
+      for (const std::string &l : Split(text)) item.push_back(Classify(l));
+      text = Join(BlocksToHtml(Lists(item, true), true));
+    }
+    if (text.find("<pre>") == std::string::npos) text = Indent(text);
+    out += "    <li>" + text + "</li>\n";
+    i = j;
+  }
+  if (lines[0].numeric) return "<ol>\n" + out + "</ol>";
+  return "<ul>\n" + out + "</ul>";
+}
+
+/* A list starts with a list item at the start or after a blank line (or
+ * anywhere in a sublist), and ends before a blank line followed by something
+ * else than a list item or indented text. */
+LineInfos Markdown::Lists(LineInfos lines, bool sublist) {
+  size_t from = 0;
+  for (;;) {
+    size_t start = lines.size();
+    if (from == 0 && !lines.empty() && lines[0].type == LineInfo::LIST_ITEM) {
+      start = 0;
+    }
+    else if (sublist) {
+      for (size_t i = from; i < lines.size(); ++i) {
+	if (lines[i].type == LineInfo::LIST_ITEM) {
+	  start = i;
+	  break;
+	}
+      }
+    }
+    else {
+      for (size_t i = from; i + 1 < lines.size(); ++i) {
+	if (lines[i].type == LineInfo::BLANK && lines[i + 1].type == LineInfo::LIST_ITEM) {
+	  start = i + 1;
+	  break;
+	}
+      }
+    }
+    if (start == lines.size()) break;
+    size_t stop = lines.size() - 1;
+    for (size_t i = start; i + 1 < lines.size(); ++i) {
+      LineInfo::Type next = lines[i + 1].type;
+      if (lines[i].type == LineInfo::BLANK && next != LineInfo::LIST_ITEM &&
+	  next != LineInfo::INDENTED && next != LineInfo::BLANK) {
+	stop = i - 1;
+	break;
+      }
+    }
+    while (stop > start && lines[stop].type == LineInfo::BLANK) --stop;
+    std::string html = ProcessList(LineInfos(lines.begin() + start, lines.begin() + stop + 1));
+    Splice(&lines, start, stop, Raw(html));
+    from = start;
+  }
+  for (LineInfo &l : lines) {
+    if (l.type == LineInfo::LIST_ITEM) l.type = LineInfo::NORMAL;
+  }
+  return lines;
+}
+
+LineInfos Markdown::Codeblocks(LineInfos lines) {
+  for (size_t start = 0; start < lines.size(); ++start) {
+    if (lines[start].type != LineInfo::INDENTED) continue;
+    size_t stop = lines.size() - 1;
+    for (size_t i = start + 1; i < lines.size(); ++i) {
+      if (lines[i].type != LineInfo::INDENTED && lines[i].type != LineInfo::BLANK) {
+	stop = i - 1;
+	break;
+      }
+    }
+    while (lines[stop].type == LineInfo::BLANK) --stop;
+    std::string html = "<pre><code>";
+    for (size_t i = start; i <= stop; ++i) {
+      if (i > start) html.push_back('\n');
+      html += Detab(EncodeCode(Outdent(lines[i].line)));
+    }
+    html += "\n</code></pre>";
+    Splice(&lines, start, stop, Raw(html));
+  }
+  return lines;
+}
+
+LineInfos Markdown::Blockquotes(LineInfos lines) {
+  for (size_t start = 0; start < lines.size(); ++start) {
+    if (lines[start].type != LineInfo::BLOCKQUOTE) continue;
+    size_t stop = lines.size() - 1;
+    for (size_t i = start + 1; i < lines.size(); ++i) {
+      LineInfo::Type t = lines[i].type;
+      if (t == LineInfo::BLANK || t == LineInfo::BLOCKQUOTE) continue;
+      if (t != LineInfo::NORMAL || lines[i - 1].type == LineInfo::BLANK) {
+	stop = i - 1;
+	break;
+      }
+    }
+    while (lines[stop].type == LineInfo::BLANK) --stop;
+    std::string raw = lines[start].text;
+    for (size_t i = start + 1; i <= stop; ++i) raw += "\n" + lines[i].text;
+    std::string bt = BlockTransform(raw, false);
+    if (bt.find("<pre>") == std::string::npos) bt = Indent(bt);
+    Splice(&lines, start, stop, Raw("<blockquote>\n    " + bt + "\n</blockquote>"));
+  }
+  return lines;
+}
+
+std::vector<std::string> Markdown::BlocksToHtml(const LineInfos &lines, bool noParagraphs) {
+  std::vector<std::string> out;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    const LineInfo &line = lines[i];
+    switch (line.type) {
+    case LineInfo::RULER:
+      out.push_back("<hr/>");
+      break;
+    case LineInfo::RAW:
+      out.push_back(line.html);
+      break;
+    case LineInfo::NORMAL: {
+      std::string s = line.line;
+      while (i + 1 < lines.size() && lines[i + 1].type == LineInfo::NORMAL) {
+	s += "\n" + lines[++i].line;
+      }
+      if (noParagraphs) out.push_back(SpanTransform(s));
+      else out.push_back("<p>" + SpanTransform(s) + "</p>");
+      break;
+    }
+    case LineInfo::HEADER: {
+      std::string level = std::to_string(line.level);
+      out.push_back("<h" + level + ">" + SpanTransform(line.text) + "</h" + level + ">");
+      break;
+    }
+    default:
+      out.push_back(line.line);
+      break;
+    }
+  }
+  return out;
+}
+
+std::string Markdown::BlockTransform(const std::string &text, bool sublist) {
+  LineInfos lines;
+  for (const std::string &l : Split(text)) lines.push_back(Classify(l));
+  Headers(&lines);
+  lines = Blockquotes(Codeblocks(Lists(lines, sublist)));
+  return Join(BlocksToHtml(lines, false));
+}
+
+/* -----------------------------------------------------------------------------
+ * Span transform
+ */
+
+// code is literal: escapes HTML and hashes the characters Markdown looks at
+std::string Markdown::EncodeCode(const std::string &s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '&') out.append("&amp;");
+    else if (c == '<') out.append("&lt;");
+    else if (c == '>') out.append("&gt;");
+    else if (strchr(ESCAPE_CHARS, c) != NULL && c != '\0') out.append(Escape(c));
+    else out.push_back(c);
+  }
+  return out;
+}
+
+std::string Markdown::CodeSpans(std::string s) {
+  s = Replace(s, "\\\\", Escape('\\'));
+  s = Replace(s, "\\`", Escape('`'));
+  size_t pos = 0;
+  for (;;) {
+    size_t start = s.find('`', pos);
+    if (start == std::string::npos) return s;
+    size_t stop = s.find_first_not_of('`', start);
+    if (stop == std::string::npos) stop = s.size();
+    // the same number of backticks, before the end of the line
+    size_t estart = s.find(std::string(stop - start, '`'), stop);
+    size_t br = s.find('\n', stop);
+    if (estart == std::string::npos || (br != std::string::npos && estart > br)) {
+      pos = stop;
+      continue;
+    }
+    std::string code = s.substr(stop, estart - stop);
+    size_t b = code.find_first_not_of(" \t");
+    code = b == std::string::npos ? std::string() : code.substr(b, code.find_last_not_of(" \t") - b + 1);
+    code = Replace(code, Escape('\\'), Escape('\\') + Escape('\\'));
+    code = Replace(code, Escape('`'), Escape('\\') + Escape('`'));
+    code = AddEscape("<code>" + EncodeCode(code) + "</code>");
+    s = s.substr(0, start) + code + s.substr(estart + (stop - start));
+    pos = start + code.size();
+  }
+}
+
+// outside of tags, backslash escapes; inside, '*' and '_'
+std::string Markdown::EscapeSpecialChars(const std::string &text) {
+  static const std::vector<std::string> starts = {"<!%-%-", "<[a-z/!$]", "<%?"};
+  std::string out;
+  size_t pos = 0;
+  Match m;
+  while (FindFirst(text, starts, pos, &m)) {
+    size_t start = m.start;
+    if (start != pos) out += EncodeBackslashEscapes(text.substr(pos, start - pos));
+    Match e;
+    bool found;
+    if (text.compare(start, 4, "<!--") == 0) found = Find(text, "%-%->", start, &e);
+    else if (text.compare(start, 2, "<?") == 0) found = Find(text, "?>", start, &e);
+    else found = Find(text, "%b<>", start, &e);
+    if (!found) {
+      out += EncodeBackslashEscapes(text.substr(start, 1));
+      pos = start + 1;
+      continue;
+    }
+    std::string tag = text.substr(start, e.end - start);
+    tag = Replace(Replace(tag, "*", Escape('*')), "_", Escape('_'));
+    out += tag;
+    pos = e.end;
+  }
+  return out + EncodeBackslashEscapes(text.substr(pos));
+}
+
+std::string Markdown::EncodeBackslashEscapes(std::string t) {
+  for (const char *c = ESCAPE_CHARS; *c; ++c) {
+    t = Replace(t, std::string("\\") + *c, Escape(*c));
+  }
+  return t;
+}
+
+std::string Markdown::Images(const std::string &text) {
+  auto referenceLink = [&](const Match &m, std::string *out) {
+    Match id;
+    Find(m.capture[1], "%[(.*)%]", 0, &id);
+    std::string key = Lower(id.capture[0]);
+    if (key.empty()) key = Lower(text);
+    const LinkDef &def = links[key];
+    if (!def.hasUrl) return false;
+    std::string alt = EncodeAlt(m.capture[0].substr(1, m.capture[0].size() - 2));
+    std::string title = def.hasTitle ? " title=\"" + EncodeAlt(def.title) + "\"" : "";
+    *out = AddEscape("<img src=\"" + EncodeAlt(def.url) + "\" alt=\"" + alt + "\"" + title + "/>");
+    return true;
+  };
+  auto inlineLink = [&](const Match &m, std::string *out) {
+    std::string alt = EncodeAlt(m.capture[0].substr(1, m.capture[0].size() - 2));
+    Match link;
+    if (Find(m.capture[1], "%(<?(.-)>?[ \t]*['\"](.+)['\"]", 0, &link)) {
+      *out = AddEscape("<img src=\"" + EncodeAlt(link.capture[0]) + "\" alt=\"" + alt +
+		       "\" title=\"" + EncodeAlt(link.capture[1]) + "\"/>");
+    }
+    else {
+      Find(m.capture[1], "%(<?(.-)>?%)", 0, &link);
+      *out = AddEscape("<img src=\"" + EncodeAlt(link.capture[0]) + "\" alt=\"" + alt + "\"/>");
+    }
+    return true;
+  };
+  std::string s = Gsub(text, "!(%b[])[ \t]*\n?[ \t]*(%b[])", referenceLink);
+  return Gsub(s, "!(%b[])(%b())", inlineLink);
+}
+
+std::string Markdown::Anchors(const std::string &text) {
+  auto referenceLink = [&](const Match &m, std::string *out) {
+    std::string linkText = m.capture[0].substr(1, m.capture[0].size() - 2);
+    std::string key = Lower(m.capture[1].substr(1, m.capture[1].size() - 2));
+    if (key.empty()) key = Lower(linkText);
+    const LinkDef &def = links[key];
+    if (!def.hasUrl) return false;
+    std::string title = def.hasTitle ? " title=\"" + EncodeAlt(def.title) + "\"" : "";
+    *out = AddEscape("<a href=\"" + EncodeAlt(def.url) + "\"" + title + ">") + linkText +
+      AddEscape("</a>");
+    return true;
+  };
+  auto inlineLink = [&](const Match &m, std::string *out) {
+    std::string linkText = m.capture[0].substr(1, m.capture[0].size() - 2);
+    Match link;
+    if (Find(m.capture[1], "%(<?(.-)>?[ \t]*['\"](.+)['\"]", 0, &link)) {
+      *out = AddEscape("<a href=\"" + EncodeAlt(link.capture[0]) + "\" title=\"" +
+		       EncodeAlt(link.capture[1]) + "\">") + linkText + "</a>";
+    }
+    else {
+      std::string url;
+      if (Find(m.capture[1], "%(<?(.-)>?%)", 0, &link)) url = link.capture[0];
+      *out = AddEscape("<a href=\"" + EncodeAlt(url) + "\">") + linkText + AddEscape("</a>");
+    }
+    return true;
+  };
+  std::string s = Gsub(text, "(%b[])[ \t]*\n?[ \t]*(%b[])", referenceLink);
+  return Gsub(s, "(%b[])(%b())", inlineLink);
+}
+
+std::string Markdown::AutoLinks(const std::string &text) {
+  auto link = [&](const Match &m, std::string *out) {
+    *out = AddEscape("<a href=\"" + m.capture[0] + "\">") + m.capture[0] + "</a>";
+    return true;
+  };
+  // unlike markdown.lua, addresses are not hidden behind character entities
+  auto mail = [&](const Match &m, std::string *out) {
+    std::string address = Expand(m.capture[0], isEscape);
+    *out = AddEscape("<a href=\"mailto:" + address + "\">" + address + "</a>");
+    return true;
+  };
+  std::string s = Gsub(text, "<(https?:[^'\">%s]+)>", link);
+  s = Gsub(s, "<(ftp:[^'\">%s]+)>", link);
+  s = Gsub(s, "<mailto:([^'\">%s]+)>", mail);
+  return Gsub(s, "<([-.%w]+%@[-.%w]+)>", mail);
+}
+
+// encodes '&' unless it starts an entity, and '<' unless it may start a tag
+static std::string AmpsAndAngles(std::string s) {
+  for (size_t amp = s.find('&'); amp != std::string::npos; amp = s.find('&', amp + 1)) {
+    size_t semi = s.find(';', amp + 1);
+    size_t stop = s.find_first_of(" \t\n&", amp + 1);
+    if (semi == std::string::npos || (stop != std::string::npos && stop < semi) || semi - amp > 15) {
+      s.replace(amp, 1, "&amp;");
+    }
+  }
+  s = Gsub(s, "<([^a-zA-Z/?$!])", std::string("&lt;%1"));
+  return Gsub(s, "<$", std::string("&lt;"));
+}
+
+static std::string Emphasis(std::string text) {
+  for (const char *d : {"%*%*", "%_%_"}) {
+    std::string s = d;
+    text = Gsub(text, (s + "([^%s][%*%_]?)" + s).c_str(), std::string("<strong>%1</strong>"));
+    text = Gsub(text, (s + "([^%s][^<>]-[^%s][%*%_]?)" + s).c_str(), std::string("<strong>%1</strong>"));
+  }
+  for (const char *d : {"%*", "%_"}) {
+    std::string s = d;
+    text = Gsub(text, (s + "([^%s_])" + s).c_str(), std::string("<em>%1</em>"));
+    text = Gsub(text, (s + "(<strong>[^%s_]</strong>)" + s).c_str(), std::string("<em>%1</em>"));
+    text = Gsub(text, (s + "([^%s_][^<>_]-[^%s_])" + s).c_str(), std::string("<em>%1</em>"));
+    text = Gsub(text, (s + "([^<>_]-<strong>[^<>_]-</strong>[^<>_]-)" + s).c_str(), std::string("<em>%1</em>"));
+  }
+  return text;
+}
+
+// unlike markdown.lua, underscores between letters or digits are literal
+std::string Markdown::IntrawordUnderscores(const std::string &text) {
+  if (text.find('_') == std::string::npos) return text;
+  std::string out;
+  for (size_t i = 0; i < text.size();) {
+    size_t j = i;
+    while (j < text.size() && text[j] == '_') ++j;
+    if (j == i) {
+      out.push_back(text[i++]);
+      continue;
+    }
+    bool inside = i > 0 && isalnum((unsigned char)text[i - 1]) && j < text.size() &&
+      isalnum((unsigned char)text[j]);
+    for (; i < j; ++i) {
+      if (inside) out.append(Escape('_'));
+      else out.push_back('_');
+    }
+  }
+  return out;
+}
+
+std::string Markdown::SpanTransform(const std::string &text) {
+  std::string s = CodeSpans(IntrawordUnderscores(text));
+  s = AutoLinks(Anchors(Images(EscapeSpecialChars(s))));
+  s = Emphasis(AmpsAndAngles(s));
+  return Gsub(s, "  +\n", std::string(" <br/>\n"));	// line breaks
+}
+
+/* -----------------------------------------------------------------------------
+ * Document
+ */
+
+static std::string Render(const char *s, size_t len) {
+  std::string text(s, len);
+  Markdown md;
+  md.InitHash(text);
+  for (const char *c = ESCAPE_CHARS; *c; ++c) md.AddEscape(std::string(1, *c));
+
+  // line ends are "\n", there are no tabs, and blank lines are empty
+  text = Replace(Replace(text, "\r\n", "\n"), "\r", "\n");
+  text = Detab(text);
+  for (int subs = 1; subs > 0;) text = Gsub(text, "\n[ \t]+\n", std::string("\n\n"), &subs);
+  text = "\n" + text + "\n";
+
+  text = md.StripLinkDefinitions(md.Protect(text));
+  return md.Expand(md.BlockTransform(text, false), md.isEscape);
+}
+
+static int MarkdownRender(lua_State *L) {
+  size_t len;
+  const char *s = luaL_checklstring(L, 1, &len);
+  std::string html = Render(s, len);
+  lua_pushlstring(L, html.data(), html.size());
+  return 1;
+}
+
+int luaopen_ldoc_markdown(lua_State *L) {
+  static const luaL_Reg functions[] = {
+    {"render", MarkdownRender},
+    {NULL, NULL}
+  };
+  luaL_newlib(L, functions);
+  return 1;
+}
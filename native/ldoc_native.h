@@ -0,0 +1,122 @@
+/**
+ * @file ldoc_native.h
+ * @brief Native modules linked into the LDoc launcher.
+ *
+ * Every module is registered in 'package.preload' by ldoc.cpp, so the Lua side
+ * simply tries to require() it and falls back to its pure Lua implementation
+ * when running outside of the launcher (e.g. 'lua ldoc.lua').
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <lua.hpp>
+
+// Lua 5.3 compatibility for the user value API of Lua 5.4
+#if LUA_VERSION_NUM < 504
+#define lua_newuserdatauv(L, sz, nuv) lua_newuserdata(L, sz)
+#define lua_setiuservalue(L, idx, n) lua_setuservalue(L, idx)
+#define lua_getiuservalue(L, idx, n) lua_getuservalue(L, idx)
+#endif
+
+// ldoc_lexer.cpp: token streams for Lua and C/C++ (see ldoc/lexer.lua)
+int luaopen_ldoc_lexer(lua_State *L);
+
+// ldoc_tags.cpp: splitting doc comments into tags (see ldoc/parse.lua)
+int luaopen_ldoc_tags(lua_State *L);
+
+// ldoc_source.cpp: read-only views of whole source files, memory-mapped where possible
+struct LDocSource;
+// NULL with a message in error if the file cannot be read
+LDocSource *ldoc_source_open(const char *name, std::string *error);
+const char *ldoc_source_data(const LDocSource *src, size_t *len);
+// true if "\r\n" in the data is a line end, as text mode reads it (Windows)
+bool ldoc_source_crlf(const LDocSource *src);
+void ldoc_source_close(LDocSource *src);
+
+// ldoc_jobs.cpp: worker states for parallel parsing and rendering (see ldoc/jobs.lua)
+int luaopen_ldoc_jobs(lua_State *L);
+
+/* Worker states are created by the launcher: the factory returns a new state,
+ * set up like the main state for the arguments args of the run (arg[0] first),
+ * with the ldoc.lua chunk on top of its stack, or NULL on failure. It is called
+ * from the worker threads, and args lives as long as the state. */
+typedef lua_State *(*LDocStateFactory)(const std::vector<std::string> &args);
+// registry field of every state: the arguments it was created with (light userdata)
+#define LDOC_ARGS_KEY "ldoc.args"
+
+void ldoc_jobs_set_state_factory(LDocStateFactory factory);
+
+// ldoc_serialize.cpp: Lua values as a flat string, for ldoc_jobs and ldoc_cache
+bool ldoc_serialize(lua_State *L, int idx, bool withClasses, std::string *out, const char **error);
+// pushes the value on success, and nothing otherwise
+bool ldoc_deserialize(lua_State *L, const char *data, size_t len, bool withClasses);
+// Lua function set_classes{name = metatable, ...} of both modules
+int ldoc_set_classes(lua_State *L);
+
+// ldoc_cache.cpp: content hashes and entries of the parse cache (see ldoc/cache.lua)
+int luaopen_ldoc_cache(lua_State *L);
+/* The launcher notes the source of each of LDoc's own chunks it loads, i.e.
+ * 'ldoc' and the 'ldoc.*' modules, so that parse cache entries written by other
+ * sources are not used: either the embedded text, or the file it was loaded
+ * from whenever it is compiled anew */
+void ldoc_cache_note_source(const char *name, const char *source, size_t len);
+void ldoc_cache_note_file(const char *name, const char *filename);
+
+// ldoc_output.cpp: writing generated pages on a background thread (see ldoc/html.lua)
+int luaopen_ldoc_output(lua_State *L);
+
+// ldoc_html.cpp: escaping and whitespace cleanup of the pages (see ldoc/html.lua)
+int luaopen_ldoc_html(lua_State *L);
+// appends s to out, escaped like ldoc_html.escape, or like escape_code if code
+void ldoc_html_append_escaped(std::string *out, const char *s, size_t len, bool code);
+
+// ldoc_profile.cpp: sampling profiler for --profile (see ldoc/profile.lua)
+int luaopen_ldoc_profile(lua_State *L);
+
+// ldoc_markdown.cpp: Markdown to HTML for format = 'native' (see ldoc/markup.lua)
+int luaopen_ldoc_markdown(lua_State *L);
+
+// ldoc_dir.cpp: listing the files below a directory in one walk (see ldoc/tools.lua)
+int luaopen_ldoc_dir(lua_State *L);
+
+// ldoc_search.cpp: the index of --search (see ldoc/search.lua)
+int luaopen_ldoc_search(lua_State *L);
+
+// ldoc_watch.cpp: waiting for changes to the inputs in --watch mode (see ldoc/watch.lua)
+int luaopen_ldoc_watch(lua_State *L);
+// a run starts: inputs modified from now on are changes; runs may only watch
+// if allow is true
+void ldoc_watch_begin(bool allow);
+// true if the current run has asked to run again once its inputs change
+bool ldoc_watch_pending(void);
+// true if the last run asked to run again once its inputs change
+bool ldoc_watch_requested(void);
+// blocks until any of the inputs registered by the last run changes; false if
+// none of them can be watched
+bool ldoc_watch_wait(void);
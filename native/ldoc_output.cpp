@@ -0,0 +1,393 @@
+/**
+ * @file ldoc_output.cpp
+ * @brief Writing the generated pages on a background thread (see ldoc/html.lua).
+ *
+ * Pages are handed over as Lua strings, which the writer keeps referenced
+ * (in the uservalue of the writer) until its I/O thread is done with them, so
+ * the text is never copied. A file whose contents would not change is left
+ * alone, which keeps its time stamp and saves the write on slow drives. Errors
+ * are collected and only reported by finish().
+ *
+ * Interface:
+ * - ldoc_output.open() -> writer
+ * - writer:write(name, text) - queue the file
+ * - writer:finish() -> {written = n, unchanged = n, errors = {message, ...}},
+ *   once all files are written
+ *
+ * For --stream, a page can also be written while it is rendered, in chunks:
+ * - ldoc_output.stream(name) -> stream, or nil and a message
+ * - stream:write(s)
+ * - stream:close() -> true, or nil and a message
+ * The text is cleaned up like cleanup_whitespaces in ldoc/html.lua does it
+ * for a whole page.
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <new>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ldoc_native.h"
+
+#define WRITER_TYPE "ldoc_output.Writer"
+#define STREAM_TYPE "ldoc_output.Stream"
+
+// uservalue of a writer: the texts still in use, by job id
+#define WRITER_TEXTS 1
+
+struct OutputJob {
+  std::string name;
+  const char *text;
+  size_t len;
+  lua_Integer id;
+};
+
+struct OutputWriter {
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable queued;
+  std::deque<OutputJob> jobs;
+  std::vector<lua_Integer> finished;	// ids of texts that can be released
+  bool stopping = false;
+  lua_Integer nextId = 0;
+  lua_Integer written = 0, unchanged = 0;
+  std::vector<std::string> errors;
+};
+
+// does the file already hold exactly this text?
+// the size of the open file f, which may be 2 GB or more even where long is 32 bits
+static bool FileSize(FILE *f, uint64_t *size) {
+#ifdef _WIN32
+  if (_fseeki64(f, 0, SEEK_END) != 0) return false;
+  __int64 end = _ftelli64(f);
+#else
+  if (fseeko(f, 0, SEEK_END) != 0) return false;
+  off_t end = ftello(f);
+#endif
+  if (end < 0) return false;
+  *size = (uint64_t)end;
+  return true;
+}
+
+static bool SameContents(const std::string &name, const char *text, size_t len) {
+  FILE *f = fopen(name.c_str(), "rb");
+  if (f == NULL) return false;
+  uint64_t size;
+  bool same = FileSize(f, &size) && size == (uint64_t)len && fseek(f, 0, SEEK_SET) == 0;
+  char buffer[16384];
+  for (size_t pos = 0; same && pos < len;) {
+    size_t n = fread(buffer, 1, sizeof(buffer), f);
+    if (n == 0 || n > len - pos || memcmp(buffer, text + pos, n) != 0) same = false;
+    pos += n;
+  }
+  fclose(f);
+  return same;
+}
+
+static void WriteOutput(OutputWriter *writer, const OutputJob &job) {
+  if (SameContents(job.name, job.text, job.len)) {
+    std::lock_guard<std::mutex> lock(writer->mutex);
+    writer->unchanged++;
+    return;
+  }
+  std::string error;
+  FILE *f = fopen(job.name.c_str(), "wb");
+  if (f == NULL) {
+    error = job.name + ": " + strerror(errno);
+  }
+  else {
+    bool ok = fwrite(job.text, 1, job.len, f) == job.len;
+    if (fclose(f) != 0) ok = false;
+    if (!ok) error = job.name + ": " + strerror(errno);
+  }
+  std::lock_guard<std::mutex> lock(writer->mutex);
+  if (error.empty()) writer->written++;
+  else writer->errors.push_back(error);
+}
+
+static void WriterLoop(OutputWriter *writer) {
+  std::unique_lock<std::mutex> lock(writer->mutex);
+  for (;;) {
+    writer->queued.wait(lock, [&] { return writer->stopping || !writer->jobs.empty(); });
+    if (writer->jobs.empty()) break;
+    OutputJob job = writer->jobs.front();
+    writer->jobs.pop_front();
+    lock.unlock();
+    WriteOutput(writer, job);
+    lock.lock();
+    writer->finished.push_back(job.id);
+  }
+}
+
+// wait for the I/O thread to finish, and let it go
+static void StopWriter(OutputWriter *writer) {
+  {
+    std::lock_guard<std::mutex> lock(writer->mutex);
+    writer->stopping = true;
+  }
+  writer->queued.notify_all();
+  if (writer->thread.joinable()) writer->thread.join();
+}
+
+static OutputWriter **CheckWriter(lua_State *L) {
+  OutputWriter **writer = (OutputWriter **)luaL_checkudata(L, 1, WRITER_TYPE);
+  if (*writer == NULL) luaL_error(L, "output writer already finished");
+  return writer;
+}
+
+// drop the references to texts that have been written; the texts table is on top
+static void ReleaseTexts(lua_State *L, OutputWriter *writer) {
+  std::vector<lua_Integer> finished;
+  {
+    std::lock_guard<std::mutex> lock(writer->mutex);
+    finished.swap(writer->finished);
+  }
+  for (lua_Integer id : finished) {
+    lua_pushnil(L);
+    lua_rawseti(L, -2, id);
+  }
+}
+
+static int OutputOpen(lua_State *L) {
+  OutputWriter **ud = (OutputWriter **)lua_newuserdatauv(L, sizeof(OutputWriter *), 1);
+  *ud = NULL;
+  luaL_setmetatable(L, WRITER_TYPE);
+  lua_newtable(L);
+  lua_setiuservalue(L, -2, WRITER_TEXTS);
+  OutputWriter *writer = new OutputWriter;
+  try {
+    writer->thread = std::thread(WriterLoop, writer);
+  }
+  catch (const std::exception &) {
+    delete writer;
+    return 0;
+  }
+  *ud = writer;
+  return 1;
+}
+
+static int WriterWrite(lua_State *L) {
+  OutputWriter *writer = *CheckWriter(L);
+  size_t nameLen, len;
+  const char *name = luaL_checklstring(L, 2, &nameLen);
+  const char *text = luaL_checklstring(L, 3, &len);
+  lua_getiuservalue(L, 1, WRITER_TEXTS);
+  ReleaseTexts(L, writer);
+  lua_Integer id = ++writer->nextId;
+  lua_pushvalue(L, 3);			// keeps text valid for the I/O thread
+  lua_rawseti(L, -2, id);
+  {
+    std::lock_guard<std::mutex> lock(writer->mutex);
+    writer->jobs.push_back(OutputJob{std::string(name, nameLen), text, len, id});
+  }
+  writer->queued.notify_one();
+  return 0;
+}
+
+static int WriterFinish(lua_State *L) {
+  OutputWriter **ud = CheckWriter(L);
+  OutputWriter *writer = *ud;
+  StopWriter(writer);
+  lua_getiuservalue(L, 1, WRITER_TEXTS);
+  ReleaseTexts(L, writer);
+  lua_pop(L, 1);
+
+  lua_createtable(L, 0, 3);
+  lua_pushinteger(L, writer->written);
+  lua_setfield(L, -2, "written");
+  lua_pushinteger(L, writer->unchanged);
+  lua_setfield(L, -2, "unchanged");
+  lua_createtable(L, (int)writer->errors.size(), 0);
+  for (size_t i = 0; i < writer->errors.size(); ++i) {
+    lua_pushlstring(L, writer->errors[i].data(), writer->errors[i].size());
+    lua_rawseti(L, -2, (lua_Integer)i + 1);
+  }
+  lua_setfield(L, -2, "errors");
+  delete writer;
+  *ud = NULL;
+  return 1;
+}
+
+static int WriterGC(lua_State *L) {
+  OutputWriter **ud = (OutputWriter **)luaL_checkudata(L, 1, WRITER_TYPE);
+  if (*ud) {
+    // the texts are only collected after this, so the thread can finish them
+    StopWriter(*ud);
+    delete *ud;
+    *ud = NULL;
+  }
+  return 0;
+}
+
+/* Streams: the whitespace cleanup has to work across chunks, so white space is
+ * held back until it is clear whether it ends a line, and a '\r' at the end of
+ * a chunk may still be followed by its '\n'. */
+struct OutputStream {
+  FILE *f = NULL;
+  std::string name;
+  std::string buffer;		// cleaned up text, not yet written
+  std::string space;		// white space that may still end a line
+  bool afterCR = false;		// a '\n' right now belongs to the last '\r'
+  bool lineStart = true;	// nothing written yet, or a line end was the last
+  int error = 0;		// errno of the first failure
+
+  ~OutputStream() {
+    if (f) fclose(f);
+  }
+};
+
+static const size_t STREAM_BUFFER_SIZE = 1 << 16;
+
+static void FlushStream(OutputStream *stream) {
+  if (stream->buffer.empty()) return;
+  if (!stream->error && fwrite(stream->buffer.data(), 1, stream->buffer.size(), stream->f) != stream->buffer.size()) {
+    stream->error = errno ? errno : EIO;
+  }
+  stream->buffer.clear();
+}
+
+static bool IsLineSpace(char c) { return c == ' ' || c == '\t' || c == '\v' || c == '\f'; }
+
+static void StreamText(OutputStream *stream, const char *s, size_t len) {
+  std::string &out = stream->buffer;
+  for (size_t i = 0; i < len; ++i) {
+    char c = s[i];
+    if (stream->afterCR) {
+      stream->afterCR = false;
+      if (c == '\n') continue;
+    }
+    if (c == '\r' || c == '\n') {
+      stream->space.clear();
+      out.push_back('\n');
+      stream->afterCR = c == '\r';
+      stream->lineStart = true;
+      continue;
+    }
+    stream->lineStart = false;
+    if (IsLineSpace(c)) {
+      stream->space.push_back(c);
+    }
+    else {
+      if (!stream->space.empty()) {
+	out.append(stream->space);
+	stream->space.clear();
+      }
+      out.push_back(c);
+    }
+  }
+  if (out.size() >= STREAM_BUFFER_SIZE) FlushStream(stream);
+}
+
+static OutputStream *CheckStream(lua_State *L) {
+  OutputStream *stream = (OutputStream *)luaL_checkudata(L, 1, STREAM_TYPE);
+  if (stream->f == NULL) luaL_error(L, "output stream already closed");
+  return stream;
+}
+
+static int OutputStreamOpen(lua_State *L) {
+  const char *name = luaL_checkstring(L, 1);
+  OutputStream *stream = new (lua_newuserdatauv(L, sizeof(OutputStream), 0)) OutputStream();
+  luaL_setmetatable(L, STREAM_TYPE);
+  stream->name = name;
+  stream->f = fopen(name, "wb");
+  if (stream->f == NULL) {
+    lua_pushnil(L);
+    lua_pushfstring(L, "%s: %s", name, strerror(errno));
+    return 2;
+  }
+  stream->buffer.reserve(STREAM_BUFFER_SIZE + 4096);
+  return 1;
+}
+
+static int StreamWrite(lua_State *L) {
+  OutputStream *stream = CheckStream(L);
+  size_t len;
+  const char *s = luaL_checklstring(L, 2, &len);
+  StreamText(stream, s, len);
+  return 0;
+}
+
+static int StreamClose(lua_State *L) {
+  OutputStream *stream = CheckStream(L);
+  if (!stream->lineStart) stream->buffer.push_back('\n');	// the file ends with a newline
+  FlushStream(stream);
+  if (fclose(stream->f) != 0 && !stream->error) stream->error = errno ? errno : EIO;
+  stream->f = NULL;
+  if (stream->error) {
+    lua_pushnil(L);
+    lua_pushfstring(L, "%s: %s", stream->name.c_str(), strerror(stream->error));
+    return 2;
+  }
+  lua_pushboolean(L, 1);
+  return 1;
+}
+
+static int StreamGC(lua_State *L) {
+  ((OutputStream *)luaL_checkudata(L, 1, STREAM_TYPE))->~OutputStream();
+  return 0;
+}
+
+int luaopen_ldoc_output(lua_State *L) {
+  static const luaL_Reg methods[] = {
+    {"write", WriterWrite},
+    {"finish", WriterFinish},
+    {NULL, NULL}
+  };
+  static const luaL_Reg streamMethods[] = {
+    {"write", StreamWrite},
+    {"close", StreamClose},
+    {NULL, NULL}
+  };
+  static const luaL_Reg functions[] = {
+    {"open", OutputOpen},
+    {"stream", OutputStreamOpen},
+    {NULL, NULL}
+  };
+  if (luaL_newmetatable(L, WRITER_TYPE)) {
+    luaL_newlib(L, methods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, WriterGC);
+    lua_setfield(L, -2, "__gc");
+  }
+  lua_pop(L, 1);
+  if (luaL_newmetatable(L, STREAM_TYPE)) {
+    luaL_newlib(L, streamMethods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, StreamGC);
+    lua_setfield(L, -2, "__gc");
+  }
+  lua_pop(L, 1);
+  luaL_newlib(L, functions);
+  return 1;
+}
@@ -0,0 +1,243 @@
+/**
+ * @file ldoc_profile.cpp
+ * @brief Sampling profiler and wall clock for --profile (see ldoc/profile.lua).
+ *
+ * A timer thread arms a count hook on the main state once per interval; at the
+ * next VM instruction the hook records the Lua call stack and disarms itself
+ * again, so between samples the state runs at full speed. Time spent inside a
+ * long C function is counted once it returns to Lua.
+ *
+ * Interface:
+ * - ldoc_profile.clock() -> wall clock time in seconds
+ * - ldoc_profile.start([interval]) -> sampler, taking a sample every interval
+ *   seconds (default 0.001) until it is stopped or collected
+ * - sampler:stop() -> {samples = n, interval = seconds, functions = {{name =,
+ *   self =, total =}, ...}, stacks = {['outer;...;inner'] = n, ...}}, with the
+ *   functions sorted by samples in themselves (self) and the stacks in the
+ *   collapsed form of flamegraph tools
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ldoc_native.h"
+
+#define SAMPLER_TYPE "ldoc_profile.Sampler"
+
+static const int MAX_DEPTH = 200;	// deeper stacks are cut off at the bottom
+
+struct FunctionCounts {
+  unsigned long long self = 0, total = 0;
+};
+
+struct Sampler {
+  lua_State *L = NULL;
+  std::chrono::microseconds interval;
+  std::thread timer;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  unsigned long long samples = 0;
+  std::unordered_map<std::string, FunctionCounts> functions;
+  std::unordered_map<std::string, unsigned long long> stacks;
+};
+
+// the sampler the hook reports to; there is only one main state to profile
+static Sampler *current = NULL;
+
+static std::string FrameName(lua_Debug *ar) {
+  std::string name;
+  if (*ar->what == 'C') {
+    name = ar->name ? ar->name : "?";
+    name += " [C]";
+  }
+  else if (*ar->what == 'm') {
+    name = "main chunk (";
+    name += ar->short_src;
+    name += ")";
+  }
+  else {
+    name = ar->name ? ar->name : "function";
+    name += " (";
+    name += ar->short_src;
+    name += ":" + std::to_string(ar->linedefined) + ")";
+  }
+  std::replace(name.begin(), name.end(), ';', ':');	// the frame separator
+  return name;
+}
+
+static void SampleHook(lua_State *L, lua_Debug *) {
+  lua_sethook(L, NULL, 0, 0);
+  Sampler *sampler = current;
+  if (sampler == NULL || sampler->L != L) return;
+
+  std::vector<std::string> frames;
+  lua_Debug ar;
+  for (int level = 0; level < MAX_DEPTH && lua_getstack(L, level, &ar); ++level) {
+    if (!lua_getinfo(L, "Sn", &ar)) break;
+    frames.push_back(FrameName(&ar));
+  }
+  if (frames.empty()) return;
+
+  ++sampler->samples;
+  sampler->functions[frames[0]].self++;
+  std::unordered_set<std::string> seen;	// recursion counts once
+  std::string stack;
+  for (size_t i = frames.size(); i-- > 0;) {
+    if (seen.insert(frames[i]).second) sampler->functions[frames[i]].total++;
+    if (!stack.empty()) stack.push_back(';');
+    stack += frames[i];
+  }
+  sampler->stacks[stack]++;
+}
+
+static void TimerLoop(Sampler *sampler) {
+  std::unique_lock<std::mutex> lock(sampler->mutex);
+  while (!sampler->wake.wait_for(lock, sampler->interval, [&] { return sampler->stopping; })) {
+    /* Setting a hook from another thread is what lua.c does from its signal
+     * handler; Lua allows it for exactly this purpose. */
+    lua_sethook(sampler->L, SampleHook, LUA_MASKCOUNT, 1);
+  }
+}
+
+static void StopSampler(Sampler *sampler) {
+  {
+    std::lock_guard<std::mutex> lock(sampler->mutex);
+    sampler->stopping = true;
+  }
+  sampler->wake.notify_all();
+  if (sampler->timer.joinable()) sampler->timer.join();
+  lua_sethook(sampler->L, NULL, 0, 0);
+  if (current == sampler) current = NULL;
+}
+
+static int ProfileClock(lua_State *L) {
+  using namespace std::chrono;
+  lua_pushnumber(L, duration<double>(steady_clock::now().time_since_epoch()).count());
+  return 1;
+}
+
+static int ProfileStart(lua_State *L) {
+  lua_Number interval = luaL_optnumber(L, 1, 0.001);
+  luaL_argcheck(L, interval > 0, 1, "interval must be positive");
+  if (current != NULL) return luaL_error(L, "the profiler is already running");
+  Sampler **ud = (Sampler **)lua_newuserdatauv(L, sizeof(Sampler *), 0);
+  *ud = NULL;
+  luaL_setmetatable(L, SAMPLER_TYPE);
+  Sampler *sampler = new Sampler;
+  lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+  sampler->L = lua_tothread(L, -1);
+  lua_pop(L, 1);
+  sampler->interval = std::chrono::microseconds((long long)(interval * 1e6) + 1);
+  *ud = sampler;
+  current = sampler;
+  sampler->timer = std::thread(TimerLoop, sampler);
+  return 1;
+}
+
+static int SamplerStop(lua_State *L) {
+  Sampler **ud = (Sampler **)luaL_checkudata(L, 1, SAMPLER_TYPE);
+  Sampler *sampler = *ud;
+  if (sampler == NULL) return 0;
+  StopSampler(sampler);
+
+  typedef std::pair<std::string, FunctionCounts> Entry;
+  std::vector<Entry> functions(sampler->functions.begin(), sampler->functions.end());
+  std::sort(functions.begin(), functions.end(), [](const Entry &a, const Entry &b) {
+    if (a.second.self != b.second.self) return a.second.self > b.second.self;
+    if (a.second.total != b.second.total) return a.second.total > b.second.total;
+    return a.first < b.first;
+  });
+
+  lua_createtable(L, 0, 4);
+  lua_pushinteger(L, (lua_Integer)sampler->samples);
+  lua_setfield(L, -2, "samples");
+  lua_pushnumber(L, sampler->interval.count() / 1e6);
+  lua_setfield(L, -2, "interval");
+  lua_createtable(L, (int)functions.size(), 0);
+  for (size_t i = 0; i < functions.size(); ++i) {
+    lua_createtable(L, 0, 3);
+    lua_pushlstring(L, functions[i].first.data(), functions[i].first.size());
+    lua_setfield(L, -2, "name");
+    lua_pushinteger(L, (lua_Integer)functions[i].second.self);
+    lua_setfield(L, -2, "self");
+    lua_pushinteger(L, (lua_Integer)functions[i].second.total);
+    lua_setfield(L, -2, "total");
+    lua_rawseti(L, -2, (lua_Integer)i + 1);
+  }
+  lua_setfield(L, -2, "functions");
+  lua_createtable(L, 0, (int)sampler->stacks.size());
+  for (const auto &stack : sampler->stacks) {
+    lua_pushlstring(L, stack.first.data(), stack.first.size());
+    lua_pushinteger(L, (lua_Integer)stack.second);
+    lua_rawset(L, -3);
+  }
+  lua_setfield(L, -2, "stacks");
+
+  delete sampler;
+  *ud = NULL;
+  return 1;
+}
+
+static int SamplerGC(lua_State *L) {
+  Sampler **ud = (Sampler **)luaL_checkudata(L, 1, SAMPLER_TYPE);
+  if (*ud) {
+    StopSampler(*ud);
+    delete *ud;
+    *ud = NULL;
+  }
+  return 0;
+}
+
+int luaopen_ldoc_profile(lua_State *L) {
+  static const luaL_Reg methods[] = {
+    {"stop", SamplerStop},
+    {NULL, NULL}
+  };
+  static const luaL_Reg functions[] = {
+    {"clock", ProfileClock},
+    {"start", ProfileStart},
+    {NULL, NULL}
+  };
+  if (luaL_newmetatable(L, SAMPLER_TYPE)) {
+    luaL_newlib(L, methods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, SamplerGC);
+    lua_setfield(L, -2, "__gc");
+  }
+  lua_pop(L, 1);
+  luaL_newlib(L, functions);
+  return 1;
+}
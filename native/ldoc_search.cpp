@@ -0,0 +1,225 @@
+/**
+ * @file ldoc_search.cpp
+ * @brief The search index of --search, built natively (see ldoc/search.lua).
+ *
+ * The entries of all modules and items are split into terms, each with the
+ * list of entries it occurs in, and written out as the JSON text of
+ * search_index.js. ldoc/search.lua describes the format and has a Lua version
+ * that gives the same text; terms are sorted by their bytes, which is what
+ * table.sort does in the "C" locale.
+ *
+ * Interface:
+ * - ldoc_search.build(entries) -> the text of search_index.js. An entry is
+ *   {name=, kind=, href=, summary=, module=, params=}, where `module` is the
+ *   index of the module's entry for items and `params` their parameter names.
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ldoc_native.h"
+
+typedef std::unordered_map<std::string, std::vector<int> > Postings;
+
+// the characters of terms, like '[%w_\128-\255]' in Lua
+static inline bool IsTermChar(unsigned char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+    c == '_' || c >= 0x80;
+}
+
+static void AddTerm(Postings *postings, const std::string &term, int entry, size_t min) {
+  if (term.size() < min) return;
+  std::vector<int> &list = (*postings)[term];
+  if (list.empty() || list.back() != entry) list.push_back(entry);
+}
+
+// the words of s in lower case, and the parts of those with underscores
+static void AddTerms(Postings *postings, const char *s, size_t len, int entry, size_t min) {
+  size_t i = 0;
+  std::string word;
+  while (i < len) {
+    while (i < len && !IsTermChar((unsigned char)s[i])) ++i;
+    if (i == len) break;
+    word.clear();
+    bool parts = false;
+    for (; i < len && IsTermChar((unsigned char)s[i]); ++i) {
+      char c = s[i];
+      if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+      if (c == '_') parts = true;
+      word.push_back(c);
+    }
+    AddTerm(postings, word, entry, min);
+    if (!parts) continue;
+    size_t start = 0;
+    while (start < word.size()) {
+      size_t end = word.find('_', start);
+      if (end == std::string::npos) end = word.size();
+      if (end > start) AddTerm(postings, word.substr(start, end - start), entry, min);
+      start = end + 1;
+    }
+  }
+}
+
+static void AppendString(std::string *out, const char *s, size_t len) {
+  out->push_back('"');
+  for (size_t i = 0; i < len; ++i) {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back((char)c);
+    } else if (c < 0x20 || c == 0x7f) {
+      char buf[8];
+      snprintf(buf, sizeof buf, "\\u%04x", c);
+      out->append(buf);
+    } else {
+      out->push_back((char)c);
+    }
+  }
+  out->push_back('"');
+}
+
+static void AppendString(std::string *out, const std::string &s) { AppendString(out, s.data(), s.size()); }
+
+static void AppendInt(std::string *out, long long n) {
+  char buf[24];
+  snprintf(buf, sizeof buf, "%lld", n);
+  out->append(buf);
+}
+
+// the string field `name` of the table at the top, "" if there is none
+static const char *StringField(lua_State *L, const char *name, size_t *len) {
+  lua_getfield(L, -1, name);
+  const char *s = lua_type(L, -1) == LUA_TSTRING ? lua_tolstring(L, -1, len) : NULL;
+  lua_pop(L, 1);		// the entries table keeps it alive
+  if (!s) {
+    *len = 0;
+    return "";
+  }
+  return s;
+}
+
+static int SearchBuild(lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_Integer n = (lua_Integer)lua_rawlen(L, 1);
+  std::vector<std::string> kinds;
+  std::unordered_map<std::string, int> kindIndex;
+  Postings postings;
+  std::string out = "ldoc_search_index({\"version\":1,\n\"entries\":[";
+  for (lua_Integer i = 1; i <= n; ++i) {
+    if (lua_rawgeti(L, 1, i) != LUA_TTABLE) {
+      return luaL_error(L, "entry %d is not a table", (int)i);
+    }
+    int entry = (int)(i - 1);
+    size_t nameLen, kindLen, hrefLen, summaryLen;
+    const char *name = StringField(L, "name", &nameLen);
+    std::string kind(StringField(L, "kind", &kindLen), kindLen);
+    const char *href = StringField(L, "href", &hrefLen);
+    const char *summary = StringField(L, "summary", &summaryLen);
+    lua_getfield(L, -1, "module");
+    long long module = lua_isinteger(L, -1) ? (long long)lua_tointeger(L, -1) - 1 : -1;
+    lua_pop(L, 1);
+
+    auto k = kindIndex.find(kind);
+    if (k == kindIndex.end()) {
+      k = kindIndex.emplace(kind, (int)kinds.size()).first;
+      kinds.push_back(kind);
+    }
+    out.append(i > 1 ? ",\n[" : "\n[");
+    AppendString(&out, name, nameLen);
+    out.push_back(',');
+    AppendInt(&out, module);
+    out.push_back(',');
+    AppendInt(&out, k->second);
+    out.push_back(',');
+    AppendString(&out, href, hrefLen);
+    out.push_back(',');
+    AppendString(&out, summary, summaryLen);
+    out.push_back(']');
+
+    AddTerms(&postings, name, nameLen, entry, 1);
+    lua_getfield(L, -1, "params");
+    if (lua_type(L, -1) == LUA_TTABLE) {
+      lua_Integer np = (lua_Integer)lua_rawlen(L, -1);
+      for (lua_Integer j = 1; j <= np; ++j) {
+	if (lua_rawgeti(L, -1, j) == LUA_TSTRING) {
+	  size_t len;
+	  const char *p = lua_tolstring(L, -1, &len);
+	  AddTerms(&postings, p, len, entry, 1);
+	}
+	lua_pop(L, 1);
+      }
+    }
+    lua_pop(L, 1);		// params
+    AddTerms(&postings, summary, summaryLen, entry, 2);
+    lua_pop(L, 1);		// entry
+  }
+
+  std::vector<const std::string *> terms;
+  terms.reserve(postings.size());
+  for (const auto &p : postings) terms.push_back(&p.first);
+  std::sort(terms.begin(), terms.end(),
+	    [](const std::string *a, const std::string *b) { return *a < *b; });
+
+  out.append("],\n\"kinds\":[");
+  for (size_t i = 0; i < kinds.size(); ++i) {
+    if (i > 0) out.push_back(',');
+    AppendString(&out, kinds[i]);
+  }
+  out.append("],\n\"terms\":[");
+  for (size_t i = 0; i < terms.size(); ++i) {
+    if (i > 0) out.push_back(',');
+    AppendString(&out, *terms[i]);
+  }
+  out.append("],\n\"postings\":[");
+  for (size_t i = 0; i < terms.size(); ++i) {
+    if (i > 0) out.push_back(',');
+    out.push_back('[');
+    int last = 0;
+    const std::vector<int> &list = postings[*terms[i]];
+    for (size_t j = 0; j < list.size(); ++j) {
+      if (j > 0) out.push_back(',');
+      AppendInt(&out, list[j] - last);
+      last = list[j];
+    }
+    out.push_back(']');
+  }
+  out.append("]});\n");
+  lua_pushlstring(L, out.data(), out.size());
+  return 1;
+}
+
+int luaopen_ldoc_search(lua_State *L) {
+  static const luaL_Reg functions[] = {
+    {"build", SearchBuild},
+    {NULL, NULL}
+  };
+  luaL_newlib(L, functions);
+  return 1;
+}
@@ -0,0 +1,306 @@
+/**
+ * @file ldoc_serialize.cpp
+ * @brief Lua values as a flat string, shared by the native modules.
+ *
+ * Used to move parse results between the states of ldoc_jobs and to store them
+ * in the parse cache of ldoc_cache. Tables may be shared or cyclic and keep
+ * their metatable, as long as it is one of the classes made known by
+ * set_classes() in the state on either end.
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include <string>
+
+#include "ldoc_native.h"
+
+#define CLASSES_KEY "ldoc_native.classes"		// registry: name -> metatable
+#define CLASS_NAMES_KEY "ldoc_native.class_names"	// registry: metatable -> name
+
+/* Format: one tag byte per value, followed by its data in native layout (data
+ * written to disk by ldoc_cache carries a header that identifies this layout):
+ *   'n' nil, 't'/'f' boolean, 'i' integer, 'd' float, 's' size + bytes,
+ *   'T' class name (size + bytes, empty for none), key/value pairs, 'e',
+ *   'r' number of a table written before
+ * Tables nest at most MAX_DEPTH deep.
+ */
+
+#define MAX_DEPTH 1000			// far more than parse results need; bounds the recursion
+
+struct Writer {
+  lua_State *L;
+  std::string *out;
+  int seen;			// table -> number
+  int names;			// metatable -> class name, or 0
+  lua_Integer count;
+  int depth;
+  const char *error;
+};
+
+template <typename T>
+static void Put(Writer *w, T value) {
+  w->out->append((const char *)&value, sizeof(value));
+}
+
+static void PutString(Writer *w, const char *s, size_t len) {
+  Put(w, len);
+  w->out->append(s, len);
+}
+
+static bool WriteValue(Writer *w, int idx);
+
+static bool WriteTable(Writer *w, int idx) {
+  lua_State *L = w->L;
+  if (w->depth >= MAX_DEPTH || !lua_checkstack(L, 4)) {
+    w->error = "tables nested too deeply";
+    return false;
+  }
+  lua_pushvalue(L, idx);
+  if (lua_rawget(L, w->seen) != LUA_TNIL) {	// shared or cyclic table
+    w->out->push_back('r');
+    Put(w, (lua_Integer)lua_tointeger(L, -1));
+    lua_pop(L, 1);
+    return true;
+  }
+  lua_pop(L, 1);
+  lua_pushvalue(L, idx);
+  lua_pushinteger(L, ++w->count);
+  lua_rawset(L, w->seen);
+
+  w->out->push_back('T');
+  if (lua_getmetatable(L, idx)) {
+    if (w->names == 0 || lua_rawget(L, w->names) != LUA_TSTRING) {
+      lua_pop(L, 1);
+      w->error = "table with unknown metatable";
+      return false;
+    }
+    size_t len;
+    const char *name = lua_tolstring(L, -1, &len);
+    PutString(w, name, len);
+    lua_pop(L, 1);
+  }
+  else {
+    PutString(w, "", 0);
+  }
+
+  w->depth++;
+  lua_pushnil(L);
+  while (lua_next(L, idx)) {
+    if (!WriteValue(w, -2) || !WriteValue(w, -1)) {
+      lua_pop(L, 2);
+      return false;
+    }
+    lua_pop(L, 1);
+  }
+  w->depth--;
+  w->out->push_back('e');
+  return true;
+}
+
+static bool WriteValue(Writer *w, int idx) {
+  lua_State *L = w->L;
+  idx = lua_absindex(L, idx);
+  switch (lua_type(L, idx)) {
+  case LUA_TNIL:
+    w->out->push_back('n');
+    return true;
+  case LUA_TBOOLEAN:
+    w->out->push_back(lua_toboolean(L, idx) ? 't' : 'f');
+    return true;
+  case LUA_TNUMBER:
+    if (lua_isinteger(L, idx)) {
+      w->out->push_back('i');
+      Put(w, (lua_Integer)lua_tointeger(L, idx));
+    }
+    else {
+      w->out->push_back('d');
+      Put(w, (lua_Number)lua_tonumber(L, idx));
+    }
+    return true;
+  case LUA_TSTRING: {
+    size_t len;
+    const char *s = lua_tolstring(L, idx, &len);
+    w->out->push_back('s');
+    PutString(w, s, len);
+    return true;
+  }
+  case LUA_TTABLE:
+    return WriteTable(w, idx);
+  default:
+    w->error = lua_typename(L, lua_type(L, idx));
+    return false;
+  }
+}
+
+bool ldoc_serialize(lua_State *L, int idx, bool withClasses, std::string *out, const char **error) {
+  idx = lua_absindex(L, idx);
+  lua_newtable(L);
+  Writer w = {L, out, lua_gettop(L), 0, 0, 0, NULL};
+  if (withClasses) {
+    lua_getfield(L, LUA_REGISTRYINDEX, CLASS_NAMES_KEY);
+    w.names = lua_istable(L, -1) ? lua_gettop(L) : 0;
+  }
+  bool ok = WriteValue(&w, idx);
+  lua_settop(L, w.seen - 1);
+  *error = w.error;
+  return ok;
+}
+
+struct Reader {
+  lua_State *L;
+  const char *p, *end;
+  int tables;			// number -> table
+  int classes;			// name -> metatable, or 0
+  lua_Integer count;
+  int depth;
+};
+
+template <typename T>
+static bool Get(Reader *r, T *value) {
+  if ((size_t)(r->end - r->p) < sizeof(T)) return false;
+  memcpy(value, r->p, sizeof(T));
+  r->p += sizeof(T);
+  return true;
+}
+
+static bool GetString(Reader *r, const char **s, size_t *len) {
+  if (!Get(r, len) || (size_t)(r->end - r->p) < *len) return false;
+  *s = r->p;
+  r->p += *len;
+  return true;
+}
+
+// can the value on top of the stack be a key? (a damaged entry may give any)
+static bool ValidKey(lua_State *L) {
+  if (lua_isnil(L, -1)) return false;
+  if (lua_type(L, -1) == LUA_TNUMBER && !lua_isinteger(L, -1)) {
+    lua_Number d = lua_tonumber(L, -1);
+    return d == d;		// not NaN
+  }
+  return true;
+}
+
+static bool ReadValue(Reader *r) {
+  // pushes the value on success
+  lua_State *L = r->L;
+  if (r->p >= r->end || !lua_checkstack(L, 4)) return false;
+  switch (*r->p++) {
+  case 'n': lua_pushnil(L); return true;
+  case 't': lua_pushboolean(L, 1); return true;
+  case 'f': lua_pushboolean(L, 0); return true;
+  case 'i': {
+    lua_Integer i;
+    if (!Get(r, &i)) return false;
+    lua_pushinteger(L, i);
+    return true;
+  }
+  case 'd': {
+    lua_Number d;
+    if (!Get(r, &d)) return false;
+    lua_pushnumber(L, d);
+    return true;
+  }
+  case 's': {
+    const char *s;
+    size_t len;
+    if (!GetString(r, &s, &len)) return false;
+    lua_pushlstring(L, s, len);
+    return true;
+  }
+  case 'r': {
+    lua_Integer i;
+    if (!Get(r, &i) || i < 1 || i > r->count) return false;
+    lua_rawgeti(L, r->tables, i);
+    return true;
+  }
+  case 'T': {
+    const char *name;
+    size_t len;
+    if (!GetString(r, &name, &len) || r->depth >= MAX_DEPTH) return false;
+    std::string className(name, len);
+    lua_newtable(L);
+    int t = lua_gettop(L);
+    lua_pushvalue(L, t);
+    lua_rawseti(L, r->tables, ++r->count);
+    r->depth++;
+    while (r->p < r->end && *r->p != 'e') {
+      if (!ReadValue(r) || !ValidKey(L) || !ReadValue(r)) return false;
+      lua_rawset(L, t);
+    }
+    r->depth--;
+    if (r->p >= r->end) return false;
+    ++r->p;			// 'e'
+    // the metatable is set last, so that filling in the fields bypasses it
+    if (!className.empty()) {
+      if (r->classes == 0 || lua_getfield(L, r->classes, className.c_str()) != LUA_TTABLE) {
+	return false;
+      }
+      lua_setmetatable(L, t);
+    }
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+bool ldoc_deserialize(lua_State *L, const char *data, size_t len, bool withClasses) {
+  int top = lua_gettop(L);
+  lua_newtable(L);
+  Reader r = {L, data, data + len, lua_gettop(L), 0, 0, 0};
+  if (withClasses) {
+    lua_getfield(L, LUA_REGISTRYINDEX, CLASSES_KEY);
+    r.classes = lua_istable(L, -1) ? lua_gettop(L) : 0;
+  }
+  if (!ReadValue(&r)) {
+    lua_settop(L, top);
+    return false;
+  }
+  lua_replace(L, top + 1);
+  lua_settop(L, top + 1);
+  return true;
+}
+
+int ldoc_set_classes(lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_newtable(L);		// name -> metatable
+  lua_newtable(L);		// metatable -> name
+  lua_pushnil(L);
+  while (lua_next(L, 1)) {
+    if (lua_type(L, -2) == LUA_TSTRING && lua_istable(L, -1)) {
+      lua_pushvalue(L, -2);
+      lua_pushvalue(L, -2);
+      lua_rawset(L, -6);
+      lua_pushvalue(L, -1);
+      lua_pushvalue(L, -3);
+      lua_rawset(L, -5);
+    }
+    lua_pop(L, 1);
+  }
+  lua_setfield(L, LUA_REGISTRYINDEX, CLASS_NAMES_KEY);
+  lua_setfield(L, LUA_REGISTRYINDEX, CLASSES_KEY);
+  return 0;
+}
@@ -0,0 +1,196 @@
+/**
+ * @file ldoc_source.cpp
+ * @brief Read-only views of whole source files, for the native lexer.
+ *
+ * Source files are memory-mapped, so the token streams of ldoc_lexer.cpp work
+ * on the file contents directly: there is neither a copy of the file nor a Lua
+ * string per line. If mapping is not possible, the file is read into memory
+ * in one go instead.
+ *
+ * On Windows, Lua reads source files in text mode. The contents are not
+ * translated here; a file with a '\r' in it is flagged instead, and the lexer
+ * then takes "\r\n" for a line end, giving the same tokens as before.
+ *
+ * Elsewhere a file truncated while it is mapped raises SIGBUS on the next
+ * access to a page behind its new end. Small files, where mapping gains
+ * nothing, and files modified within the last seconds, which may still be
+ * written by an editor (--watch runs right after a save), are read instead.
+ * A large file truncated by another process while LDoc lexes it still ends
+ * the process; Windows refuses to truncate a mapped file, so it is safe there.
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "ldoc_native.h"
+
+struct LDocSource {
+  const char *data = NULL;
+  size_t size = 0;
+  void *view = NULL;		// the mapping, if any
+  size_t viewSize = 0;
+  std::string copy;		// the contents, if not mapped
+  bool crlf = false;		// Windows: "\r\n" is a line end
+};
+
+static void Unmap(LDocSource *src) {
+  if (src->view == NULL) return;
+#ifdef _WIN32
+  UnmapViewOfFile(src->view);
+#else
+  munmap(src->view, src->viewSize);
+#endif
+  src->view = NULL;
+}
+
+#ifdef _WIN32
+
+static bool MapFile(LDocSource *src, const char *name, std::string *error) {
+  HANDLE file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+			    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    *error = std::string(name) + ": " + (GetLastError() == ERROR_FILE_NOT_FOUND ||
+					 GetLastError() == ERROR_PATH_NOT_FOUND
+					 ? "No such file or directory" : "cannot open file");
+    return false;
+  }
+  LARGE_INTEGER size;
+  bool ok = GetFileSizeEx(file, &size) != 0;
+  if (ok && size.QuadPart > 0) {
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL) {
+      src->view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+    }
+    if (src->view != NULL) {
+      src->viewSize = (size_t)size.QuadPart;
+      src->data = (const char *)src->view;
+      src->size = src->viewSize;
+    }
+    else {			// e.g. a file on some network drives
+      src->copy.resize((size_t)size.QuadPart);
+      DWORD n = 0;
+      ok = ReadFile(file, &src->copy[0], (DWORD)src->copy.size(), &n, NULL) != 0;
+      src->copy.resize(n);
+      src->data = src->copy.data();
+      src->size = src->copy.size();
+    }
+  }
+  CloseHandle(file);
+  if (!ok) {
+    *error = std::string(name) + ": read error";
+    Unmap(src);
+    return false;
+  }
+  // text mode, as io.open(name) would read the file
+  src->crlf = src->size > 0 && memchr(src->data, '\r', src->size) != NULL;
+  return true;
+}
+
+#else
+
+// files are read instead of mapped if they are smaller, or were modified more recently
+#define MIN_MAPPED_SIZE (64 * 1024)
+#define SETTLE_SECONDS 2
+
+static bool MapFile(LDocSource *src, const char *name, std::string *error) {
+  int fd = open(name, O_RDONLY);
+  if (fd < 0) {
+    *error = std::string(name) + ": " + strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    *error = std::string(name) + ": " + strerror(errno);
+    close(fd);
+    return false;
+  }
+  if (S_ISREG(st.st_mode) && st.st_size >= MIN_MAPPED_SIZE &&
+      time(NULL) - st.st_mtime > SETTLE_SECONDS) {
+    void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view != MAP_FAILED) {
+      src->view = view;
+      src->viewSize = (size_t)st.st_size;
+      src->data = (const char *)view;
+      src->size = src->viewSize;
+      close(fd);
+      return true;
+    }
+  }
+  // small, recently modified, not mappable or not a regular file: read it
+  char buffer[16384];
+  ssize_t n;
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0) src->copy.append(buffer, (size_t)n);
+  int err = errno;
+  close(fd);
+  if (n < 0) {
+    *error = std::string(name) + ": " + strerror(err);
+    return false;
+  }
+  src->data = src->copy.data();
+  src->size = src->copy.size();
+  return true;
+}
+
+#endif
+
+LDocSource *ldoc_source_open(const char *name, std::string *error) {
+  LDocSource *src = new LDocSource;
+  if (!MapFile(src, name, error)) {
+    delete src;
+    return NULL;
+  }
+  return src;
+}
+
+const char *ldoc_source_data(const LDocSource *src, size_t *len) {
+  *len = src->size;
+  return src->data;
+}
+
+bool ldoc_source_crlf(const LDocSource *src) {
+  return src->crlf;
+}
+
+void ldoc_source_close(LDocSource *src) {
+  if (src == NULL) return;
+  Unmap(src);
+  delete src;
+}
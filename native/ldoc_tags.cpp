@@ -0,0 +1,226 @@
+/**
+ * @file ldoc_tags.cpp
+ * @brief Splitting doc comments into preamble and tags (see ldoc/parse.lua).
+ *
+ * A single pass over the lines of a comment does what parse_at_tags and
+ * parse_colon_tags do with stringio lines, tools.grab_while_not and pattern
+ * matches per line; the results are identical, so that Item.check_tag and
+ * Tags:add see the same values.
+ *
+ * LuaDoc tag lines match '^%s*@(%w+)', optionally followed by '[modifiers]';
+ * colon tag lines contain a word ending in ':' and followed by white space,
+ * as matched by '%s*(%S-):%s'.
+ *
+ * Interface:
+ * - ldoc_tags.scan(text, colon) -> preamble, {{tag, value [, modifiers]}, ...}
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include <string>
+
+#include "ldoc_native.h"
+
+// Character classes of Lua patterns in the "C" locale (%s, %w)
+static inline bool IsSpace(unsigned char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+static inline bool IsAlnum(unsigned char c) {
+  return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z');
+}
+
+struct Line {
+  const char *s;
+  size_t len;
+};
+
+struct TagLine {
+  size_t tagStart, tagLen;	// the tag name
+  size_t modStart, modLen;	// the modifier string, '[...]'
+  bool hasModifiers;
+  size_t restStart;		// the value on the tag line
+};
+
+// '^%s*@(%w+)', then '^%s*@(%w+)%[([^%]]*)%](.*)' or '^%s*@(%w+)(.*)'
+static bool AtTag(const Line &line, TagLine *tag) {
+  size_t i = 0;
+  while (i < line.len && IsSpace(line.s[i])) ++i;
+  if (i >= line.len || line.s[i] != '@') return false;
+  size_t start = ++i;
+  while (i < line.len && IsAlnum(line.s[i])) ++i;
+  if (i == start) return false;
+  tag->tagStart = start;
+  tag->tagLen = i - start;
+  tag->hasModifiers = false;
+  tag->restStart = i;
+  if (i < line.len && line.s[i] == '[') {
+    const char *close = (const char *)memchr(line.s + i + 1, ']', line.len - i - 1);
+    if (close) {
+      tag->hasModifiers = true;
+      tag->modStart = i + 1;
+      tag->modLen = (size_t)(close - line.s) - tag->modStart;
+      tag->restStart = (size_t)(close - line.s) + 1;
+    }
+  }
+  return true;
+}
+
+/* '%s*(%S-):%s' (unanchored) and the following '(.*)': the first word which
+ * ends in ':' and is followed by a white space character, which is skipped */
+static bool ColonTag(const Line &line, TagLine *tag) {
+  size_t i = 0;
+  while (i < line.len) {
+    while (i < line.len && IsSpace(line.s[i])) ++i;
+    size_t start = i;
+    while (i < line.len && !IsSpace(line.s[i])) ++i;
+    if (i > start && line.s[i - 1] == ':' && i < line.len) {
+      tag->tagStart = start;
+      tag->tagLen = i - 1 - start;
+      tag->hasModifiers = false;
+      tag->restStart = i + 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+// like the lines of pl.stringio: split at '\n', no empty line after a final '\n'
+static bool NextLine(const char *text, size_t len, size_t *pos, Line *line) {
+  if (*pos >= len) return false;
+  const char *start = text + *pos;
+  const char *nl = (const char *)memchr(start, '\n', len - *pos);
+  line->s = start;
+  line->len = nl ? (size_t)(nl - start) : len - *pos;
+  *pos += line->len + 1;
+  return true;
+}
+
+// modifiers as parsed by parse_at_tags: 'k=v' pieces between commas, or 'k' for k=true
+static void PushModifiers(lua_State *L, const char *s, size_t len) {
+  lua_newtable(L);
+  size_t i = 0;
+  while (i < len) {
+    while (i < len && s[i] == ',') ++i;
+    if (i >= len) break;
+    size_t start = i;
+    while (i < len && s[i] != ',') ++i;
+    const char *piece = s + start;
+    size_t n = i - start;
+    const char *eq = (const char *)memchr(piece, '=', n);
+    if (eq && eq > piece) {		// '^([^=]+)=(.*)$'
+      lua_pushlstring(L, piece, (size_t)(eq - piece));
+      lua_pushlstring(L, eq + 1, n - (size_t)(eq - piece) - 1);
+    }
+    else {
+      lua_pushlstring(L, piece, n);
+      lua_pushboolean(L, 1);
+    }
+    lua_rawset(L, -3);
+  }
+}
+
+static int TagsScan(lua_State *L) {
+  size_t len;
+  const char *text = luaL_checklstring(L, 1, &len);
+  bool colon = lua_toboolean(L, 2);
+  bool (*isTag)(const Line &, TagLine *) = colon ? ColonTag : AtTag;
+
+  size_t pos = 0;
+  Line line;
+  TagLine tag;
+  std::string buffer;
+  bool haveTag = false;
+  // the preamble: lines up to the first tag line, joined by '\n'
+  bool first = true;
+  while (NextLine(text, len, &pos, &line)) {
+    if (isTag(line, &tag)) {
+      haveTag = true;
+      break;
+    }
+    if (!first) buffer.push_back('\n');
+    buffer.append(line.s, line.len);
+    first = false;
+  }
+  lua_pushlstring(L, buffer.data(), buffer.size());
+
+  lua_newtable(L);
+  lua_Integer n = 0;
+  while (haveTag) {
+    Line tagLine = line;
+    TagLine current = tag;
+    // the value: rest of the tag line, '\n' and the following lines up to the next tag
+    buffer.assign(tagLine.s + current.restStart, tagLine.len - current.restStart);
+    buffer.push_back('\n');
+    haveTag = false;
+    first = true;
+    while (NextLine(text, len, &pos, &line)) {
+      if (isTag(line, &tag)) {
+	haveTag = true;
+	break;
+      }
+      if (!first) buffer.push_back('\n');
+      buffer.append(line.s, line.len);
+      first = false;
+    }
+
+    lua_createtable(L, 3, 0);
+    const char *name = tagLine.s + current.tagStart;
+    size_t nameLen = current.tagLen;
+    if (colon && nameLen > 0 && (name[0] == '?' || name[0] == '!')) {
+      // '?type name' and '!type name' shortcuts: value becomes 'type name ...'
+      if (name[0] == '!') {
+	++name;
+	--nameLen;
+      }
+      std::string value(name, nameLen);
+      value.push_back(' ');
+      value += buffer;
+      lua_pushliteral(L, "tparam");
+      lua_rawseti(L, -2, 1);
+      lua_pushlstring(L, value.data(), value.size());
+      lua_rawseti(L, -2, 2);
+    }
+    else {
+      lua_pushlstring(L, name, nameLen);
+      lua_rawseti(L, -2, 1);
+      lua_pushlstring(L, buffer.data(), buffer.size());
+      lua_rawseti(L, -2, 2);
+    }
+    if (current.hasModifiers) {
+      PushModifiers(L, tagLine.s + current.modStart, current.modLen);
+      lua_rawseti(L, -2, 3);
+    }
+    lua_rawseti(L, -2, ++n);
+  }
+  return 2;
+}
+
+int luaopen_ldoc_tags(lua_State *L) {
+  static const luaL_Reg functions[] = {
+    {"scan", TagsScan},
+    {NULL, NULL}
+  };
+  luaL_newlib(L, functions);
+  return 1;
+}
@@ -0,0 +1,412 @@
+/**
+ * @file ldoc_watch.cpp
+ * @brief Waiting for changes to the inputs of a run (--watch).
+ *
+ * In watch mode, ldoc.lua tells the launcher which files and directories its
+ * output depends on (see ldoc/watch.lua). When the run is over, the launcher
+ * waits here until any of them changes, and then runs ldoc.lua again in a fresh
+ * state; with --cache and --incremental, only changed files are parsed again
+ * and only affected pages are written.
+ *
+ * Changes are noticed with ReadDirectoryChangesW on Windows and inotify on
+ * Linux; other platforms compare modification times twice a second. Before
+ * waiting, anything modified since the run started counts as a change too,
+ * since the run may not have seen it.
+ *
+ * Interface:
+ * - ldoc_watch.available() -> true, or false and a message if the launcher
+ *   does not run again (batch mode)
+ * - ldoc_watch.watch(paths, ignored) - run again once anything in the list of
+ *   absolute paths changes, except below one of the ignored directories
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "ldoc_native.h"
+
+namespace fs = std::filesystem;
+
+#ifdef _WIN32
+#define SEPARATOR '\\'
+#else
+#define SEPARATOR '/'
+#endif
+
+static const int SETTLE_MS = 200;	// changes usually come in bursts
+
+struct WatchRoot {
+  std::string path;
+  bool isDir;
+};
+
+static std::vector<WatchRoot> roots;
+static std::vector<std::string> ignored;
+static bool requested = false;
+static bool allowed = true;
+static fs::file_time_type runStart;	// of the current run
+
+static bool SamePath(const std::string &a, const std::string &b) {
+#ifdef _WIN32
+  return a.size() == b.size() && _strnicmp(a.c_str(), b.c_str(), a.size()) == 0;
+#else
+  return a == b;
+#endif
+}
+
+static bool IsBelow(const std::string &file, const std::string &dir) {
+  return file.size() > dir.size() && file[dir.size()] == SEPARATOR && SamePath(file.substr(0, dir.size()), dir);
+}
+
+static std::string Parent(const std::string &file) {
+  size_t sep = file.find_last_of(SEPARATOR);
+  return sep == std::string::npos ? std::string(".") : file.substr(0, sep);
+}
+
+static bool Relevant(const std::string &file) {
+  for (const std::string &dir : ignored) {
+    if (SamePath(file, dir) || IsBelow(file, dir)) return false;
+  }
+  for (const WatchRoot &root : roots) {
+    if (SamePath(file, root.path) || (root.isDir && IsBelow(file, root.path))) return true;
+  }
+  return false;
+}
+
+// true if anything watched was modified after the run started
+static bool ChangedDuringRun() {
+  std::error_code ec;
+  for (const WatchRoot &root : roots) {
+    auto mtime = fs::last_write_time(root.path, ec);
+    if (!ec && mtime > runStart) return true;
+    if (!root.isDir) continue;
+    fs::recursive_directory_iterator it(root.path, ec), end;
+    for (; !ec && it != end; it.increment(ec)) {
+      std::error_code entryEc;
+      std::string file = it->path().string();
+      if (!Relevant(file)) {
+	if (it->is_directory(entryEc)) it.disable_recursion_pending();
+	continue;
+      }
+      mtime = it->last_write_time(entryEc);
+      if (!entryEc && mtime > runStart) return true;
+    }
+  }
+  return false;
+}
+
+// the directories to watch: directories themselves, and the parents of files
+static std::vector<WatchRoot> WatchedDirs() {
+  std::vector<WatchRoot> dirs;
+  for (const WatchRoot &root : roots) {
+    WatchRoot dir = root.isDir ? root : WatchRoot{Parent(root.path), false};
+    bool known = false;
+    for (WatchRoot &other : dirs) {
+      if (SamePath(other.path, dir.path)) {
+	other.isDir = other.isDir || dir.isDir;
+	known = true;
+      }
+    }
+    if (!known) dirs.push_back(dir);
+  }
+  return dirs;
+}
+
+#ifdef _WIN32
+
+struct DirWatch {
+  HANDLE dir;
+  OVERLAPPED overlapped;
+  std::string path;
+  bool recursive;
+  DWORD buffer[16384];		// FILE_NOTIFY_INFORMATION records
+};
+
+static const DWORD NOTIFY_FILTER = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+  FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+
+static bool Arm(DirWatch *w) {
+  return ReadDirectoryChangesW(w->dir, w->buffer, sizeof(w->buffer), w->recursive,
+			       NOTIFY_FILTER, NULL, &w->overlapped, NULL) != 0;
+}
+
+// true if any of the changes reported to w matters
+static bool Collect(DirWatch *w) {
+  DWORD bytes = 0;
+  if (!GetOverlappedResult(w->dir, &w->overlapped, &bytes, FALSE)) return false;
+  if (bytes == 0) return true;	// buffer overflow: anything may have changed
+  bool relevant = false;
+  const char *p = (const char *)w->buffer;
+  for (;;) {
+    const FILE_NOTIFY_INFORMATION *info = (const FILE_NOTIFY_INFORMATION *)p;
+    int wlen = (int)(info->FileNameLength / sizeof(WCHAR));
+    // paths in Lua use the ANSI code page, like fopen() does
+    int len = WideCharToMultiByte(CP_ACP, 0, info->FileName, wlen, NULL, 0, NULL, NULL);
+    std::string name(len, '\0');
+    WideCharToMultiByte(CP_ACP, 0, info->FileName, wlen, &name[0], len, NULL, NULL);
+    if (Relevant(w->path + SEPARATOR + name)) relevant = true;
+    if (info->NextEntryOffset == 0) break;
+    p += info->NextEntryOffset;
+  }
+  return relevant;
+}
+
+static bool WaitForChange() {
+  std::vector<DirWatch *> watches;
+  std::vector<HANDLE> events;
+  for (const WatchRoot &dir : WatchedDirs()) {
+    if (events.size() == MAXIMUM_WAIT_OBJECTS) break;
+    DirWatch *w = new DirWatch();
+    w->path = dir.path;
+    w->recursive = dir.isDir;
+    w->dir = CreateFileA(dir.path.c_str(), FILE_LIST_DIRECTORY,
+			 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+			 OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    w->overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (w->dir == INVALID_HANDLE_VALUE || w->overlapped.hEvent == NULL || !Arm(w)) {
+      if (w->dir != INVALID_HANDLE_VALUE) CloseHandle(w->dir);
+      if (w->overlapped.hEvent != NULL) CloseHandle(w->overlapped.hEvent);
+      delete w;
+      continue;
+    }
+    watches.push_back(w);
+    events.push_back(w->overlapped.hEvent);
+  }
+  if (events.empty()) return false;
+
+  // (now that the watches are armed, nothing more can be missed)
+  bool changed = ChangedDuringRun();
+  DWORD timeout = changed ? SETTLE_MS : INFINITE;
+  for (;;) {
+    DWORD result = WaitForMultipleObjects((DWORD)events.size(), events.data(), FALSE, timeout);
+    if (result == WAIT_TIMEOUT || result == WAIT_FAILED) break; // settled
+    DirWatch *w = watches[result - WAIT_OBJECT_0];
+    if (Collect(w) && !changed) {
+      changed = true;
+      timeout = SETTLE_MS;
+    }
+    ResetEvent(w->overlapped.hEvent);
+    if (!Arm(w)) break;
+  }
+
+  for (DirWatch *w : watches) {
+    CancelIo(w->dir);
+    CloseHandle(w->dir);
+    CloseHandle(w->overlapped.hEvent);
+    delete w;
+  }
+  return true;
+}
+
+#elif defined(__linux__)
+
+static void AddWatches(int fd, const std::string &dir, bool recursive, std::map<int, std::string> *paths) {
+  const uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+  int wd = inotify_add_watch(fd, dir.c_str(), mask | IN_ONLYDIR);
+  if (wd < 0) return;
+  (*paths)[wd] = dir;
+  if (!recursive) return;
+  DIR *d = opendir(dir.c_str());
+  if (d == NULL) return;
+  while (struct dirent *entry = readdir(d)) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+    std::string sub = dir + SEPARATOR + entry->d_name;
+    std::error_code ec;
+    if (fs::is_directory(fs::symlink_status(sub, ec)) && Relevant(sub)) {
+      AddWatches(fd, sub, true, paths);
+    }
+  }
+  closedir(d);
+}
+
+static bool WaitForChange() {
+  int fd = inotify_init1(IN_CLOEXEC);
+  if (fd < 0) return false;
+  std::map<int, std::string> paths;	// watch descriptor -> directory
+  for (const WatchRoot &dir : WatchedDirs()) {
+    AddWatches(fd, dir.path, dir.isDir, &paths);
+  }
+  if (paths.empty()) {
+    close(fd);
+    return false;
+  }
+
+  // (now that the watches are armed, nothing more can be missed)
+  bool changed = ChangedDuringRun();
+  int timeout = changed ? SETTLE_MS : -1;
+  alignas(struct inotify_event) char buffer[16384];
+  for (;;) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeout);
+    if (ready == 0) break;	// settled
+    if (ready < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    ssize_t len = read(fd, buffer, sizeof(buffer));
+    if (len <= 0) break;
+    for (char *p = buffer; p < buffer + len; ) {
+      const struct inotify_event *event = (const struct inotify_event *)p;
+      p += sizeof(struct inotify_event) + event->len;
+      bool relevant = (event->mask & IN_Q_OVERFLOW) != 0;
+      auto dir = paths.find(event->wd);
+      if (!relevant && dir != paths.end()) {
+	relevant = Relevant(event->len ? dir->second + SEPARATOR + event->name : dir->second);
+      }
+      if (relevant && !changed) {
+	changed = true;
+	timeout = SETTLE_MS;
+      }
+    }
+  }
+  close(fd);
+  return true;
+}
+
+#else
+
+// no notifications available: compare modification times
+typedef std::map<std::string, fs::file_time_type> Snapshot;
+
+static void TakeSnapshot(Snapshot *snapshot) {
+  std::error_code ec;
+  for (const WatchRoot &root : roots) {
+    if (!root.isDir) {
+      (*snapshot)[root.path] = fs::last_write_time(root.path, ec);
+      continue;
+    }
+    fs::recursive_directory_iterator it(root.path, ec), end;
+    for (; !ec && it != end; it.increment(ec)) {
+      std::string file = it->path().string();
+      if (!Relevant(file)) {
+	if (it->is_directory(ec)) it.disable_recursion_pending();
+	continue;
+      }
+      (*snapshot)[file] = it->last_write_time(ec);
+    }
+  }
+}
+
+static bool WaitForChange() {
+  if (roots.empty()) return false;
+  Snapshot before;
+  TakeSnapshot(&before);
+  for (bool changed = ChangedDuringRun(); !changed; ) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    Snapshot now;
+    TakeSnapshot(&now);
+    changed = now != before;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_MS));
+  return true;
+}
+
+#endif
+
+void ldoc_watch_begin(bool allow) {
+  allowed = allow;
+  requested = false;
+  runStart = fs::file_time_type::clock::now();
+}
+
+bool ldoc_watch_pending(void) {
+  return requested;
+}
+
+bool ldoc_watch_requested(void) {
+  bool result = requested;
+  requested = false;
+  return result;
+}
+
+bool ldoc_watch_wait(void) {
+  return WaitForChange();
+}
+
+static void CheckPaths(lua_State *L, int idx, std::vector<std::string> *list) {
+  luaL_checktype(L, idx, LUA_TTABLE);
+  lua_Integer n = (lua_Integer)lua_rawlen(L, idx);
+  for (lua_Integer i = 1; i <= n; ++i) {
+    lua_rawgeti(L, idx, i);
+    size_t len;
+    const char *s = lua_tolstring(L, -1, &len);
+    if (s == NULL) luaL_error(L, "paths must be strings");
+    std::string p(s, len);
+    while (p.size() > 1 && (p.back() == '/' || p.back() == SEPARATOR)) p.pop_back();
+    list->push_back(p);
+    lua_pop(L, 1);
+  }
+}
+
+static int WatchAvailable(lua_State *L) {
+  lua_pushboolean(L, allowed);
+  if (allowed) return 1;
+  lua_pushliteral(L, "--watch is not supported in batch mode");
+  return 2;
+}
+
+static int WatchWatch(lua_State *L) {
+  if (!allowed) return luaL_error(L, "--watch is not supported in batch mode");
+  std::vector<std::string> paths, skip;
+  CheckPaths(L, 1, &paths);
+  if (!lua_isnoneornil(L, 2)) CheckPaths(L, 2, &skip);
+  roots.clear();
+  for (const std::string &p : paths) {
+    std::error_code ec;
+    roots.push_back(WatchRoot{p, fs::is_directory(p, ec)});
+  }
+  ignored.swap(skip);
+  requested = true;
+  return 0;
+}
+
+int luaopen_ldoc_watch(lua_State *L) {
+  static const luaL_Reg functions[] = {
+    {"available", WatchAvailable},
+    {"watch", WatchWatch},
+    {NULL, NULL}
+  };
+  luaL_newlib(L, functions);
+  return 1;
+}
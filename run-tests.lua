@@ -1,5 +1,17 @@
+-- lua run-tests.lua              compare the output for the test trees with cdocs
+-- lua run-tests.lua update       write the expected output to cdocs
+-- lua run-tests.lua native LDOC  check that the launcher LDOC gives the same output
+--                                with its native modules, without them and with --jobs,
+--                                that format = 'native' renders Markdown like markdown.lua,
+--                                and that --incremental only writes what changed
 local PWD = os.getenv("PWD")
 
+local function succeeded (...)
+   local ok, how, code = ...
+   if how == 'exit' then return code == 0 end
+   return ok == true or ok == 0
+end
+
 local run
 if not arg[1] then
   run = function (dir)
@@ -13,6 +25,119 @@ elseif arg[1] == 'update' then
      print(cmd)
      os.execute(cmd)
    end
+elseif arg[1] == 'native' then
+   local ldoc = arg[2] or 'ldoc'
+   if ldoc:find '/' and not ldoc:match '^/' then ldoc = PWD..'/'..ldoc end
+
+   -- the trees and the arguments to run ldoc on them with. Trees using
+   -- Markdown are rendered with the `other` renderer as well: 'native' or
+   -- markdown.lua ('markdown'); only the pages `native_only` may differ.
+   local trees = {
+      {'tests', '.', other = 'native'},
+      {'tests/example', '.'},
+      {'tests/md-test', '.', other = 'native'},
+      -- BOMs, CRLF line ends, long strings and comments, strings with escapes,
+      -- highlighted code
+      {'tests/native', '.', other = 'native'},
+      {'tests/markdown', '.', other = 'markdown', native_only = 'differences.md.html'},
+      -- colon tags, with the '?' and '!' shortcuts for tparam
+      {'tests/styles', '-C colon.lua'},
+   }
+
+   -- every variant writes its own output directory, compared with the first
+   local variants = {
+      {'native', ''},
+      {'lua', 'LDOC_NO_NATIVE=1 '},
+      {'jobs', '', ' --jobs 4'},
+      {'format', '', ' --format %s', markdown = true},
+   }
+
+   local failed = 0
+   local function check (cmd)
+      print(cmd)
+      if not succeeded(os.execute(cmd)) then
+         failed = failed + 1
+         print('FAILED')
+      end
+   end
+   for _, tree in ipairs(trees) do
+      local dir, args = tree[1], tree[2]
+      for i, v in ipairs(variants) do
+         if tree.other or not v.markdown then
+            local out = '_out_'..v[1]
+            check(('cd %s && rm -rf %s && %s%s --testing --quiet --dir %s%s %s'):format(
+               dir, out, v[2], ldoc, out, (v[3] or ''):format(tree.other), args))
+            if i > 1 then
+               -- without the native modules, format 'native' is markdown.lua
+               local exclude = ''
+               if tree.native_only and (v.markdown or v[1] == 'lua') then
+                  exclude = ' -x '..tree.native_only
+               end
+               check(('cd %s && diff -r%s _out_%s %s'):format(dir, exclude, variants[1][1], out))
+            end
+         end
+      end
+   end
+
+   local function readfile (fname)
+      local f = io.open(fname, 'rb')
+      if not f then return '' end
+      local text = f:read '*a'
+      f:close()
+      return text
+   end
+
+   -- the deliberate differences of format 'native': each line of
+   -- differences.html is in its page, and not in the page of markdown.lua
+   local expected = readfile 'tests/markdown/differences.html'
+   local native_page = readfile 'tests/markdown/_out_native/topics/differences.md.html'
+   local markdown_page = readfile 'tests/markdown/_out_format/topics/differences.md.html'
+   for line in expected:gmatch '[^\n]+' do
+      print('differences.html: '..line)
+      if not native_page:find(line, 1, true) or markdown_page:find(line, 1, true) then
+         failed = failed + 1
+         print('FAILED')
+      end
+   end
+
+   -- --emit_index writes the same index with and without the native modules
+   check(('cd tests/native && rm -rf _out_index && mkdir _out_index && '..
+      '%s --testing --quiet --dir _out_index/native --emit_index _out_index/native.idx . && '..
+      'LDOC_NO_NATIVE=1 %s --testing --quiet --dir _out_index/lua --emit_index _out_index/lua.idx . && '..
+      'cmp _out_index/native.idx _out_index/lua.idx'):format(ldoc, ldoc))
+
+   -- --incremental, on a copy of tests/incremental: changing a module only
+   -- writes the pages showing it, and removing one deletes its page; with
+   -- the native modules and without
+   local work = 'tests/incremental/_out_work'
+   local function edit (fname, from, to)
+      local text = readfile(fname)
+      local f = assert(io.open(fname, 'wb'))
+      f:write((text:gsub(from, to)))
+      f:close()
+   end
+   local function written (expected)
+      check(('cd %s && test "$(find out -name "*.html" -newer stamp | sort | tr "\\n" " ")" = "%s"')
+         :format(work, expected))
+   end
+   for _, env in ipairs {'', 'LDOC_NO_NATIVE=1 '} do
+      local incremental = ('cd %s && %s%s --testing --quiet --incremental --dir out .')
+         :format(work, env, ldoc)
+      check(('rm -rf %s && mkdir %s && cp -r tests/incremental/config.ld tests/incremental/src %s')
+         :format(work, work, work))
+      check(incremental)
+      check(('sleep 1 && touch %s/stamp'):format(work))
+      edit(work..'/src/a.lua', 'first version', 'second version')
+      check(incremental)
+      written 'out/index.html out/modules/a.html '
+      check(('sleep 1 && touch %s/stamp && rm %s/src/b.lua'):format(work, work))
+      check(incremental)
+      written 'out/index.html '
+      check(('test ! -e %s/out/modules/b.html && test -e %s/out/modules/a.html'):format(work, work))
+   end
+
+   print(failed == 0 and 'ok' or failed..' failed')
+   os.exit(failed == 0 and 0 or 1)
 end
 
 for _,d in ipairs{'tests','tests/example','tests/md-test'} do
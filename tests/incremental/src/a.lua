@@ -0,0 +1,13 @@
+--- Module a, first version.
+-- @module a
+
+local a = {}
+
+--- answer a question.
+-- @string q the question
+-- @treturn number the answer
+function a.answer (q)
+   return 42
+end
+
+return a
@@ -0,0 +1,12 @@
+--- Module b, which links to module a.
+-- @module b
+
+local b = {}
+
+--- ask a question.
+-- @see a.answer
+function b.ask ()
+   return require('a').answer 'why'
+end
+
+return b
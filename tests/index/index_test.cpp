@@ -0,0 +1,273 @@
+/**
+ * @file index_test.cpp
+ * @brief Tests of native/ldoc_index.h, the reader of 'ldoc --emit_index' files.
+ *
+ * An index is built in memory with the layout ldoc/index.lua writes: it must
+ * open and read back as written, and every kind of damage must make open()
+ * fail instead of letting a reader go out of bounds. Index files given on the
+ * command line (e.g. written by 'ldoc --emit_index') must open as well.
+ *
+ * -----------------------------------------------------------------------------
+ * MIT License
+ *
+ * Copyright (c) 2026 The OneLuaPro project authors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * -----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ldoc_index.h"
+
+using namespace ldoc_index;
+
+static int failures = 0;
+
+#define CHECK(cond)							\
+  do {									\
+    if (!(cond)) {							\
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures;							\
+    }									\
+  } while (0)
+
+// An index as ldoc/index.lua writes it: the records, then the string pool
+struct Builder {
+  std::vector<Module> modules;
+  std::vector<Item> items;
+  std::vector<Param> params;
+  std::vector<Return> returns;
+  std::vector<Ref> refs;
+  std::string pool;
+  std::map<std::string, uint32_t> offsets;
+
+  Builder() { str(""); }
+
+  uint32_t str(const std::string &s) {
+    auto found = offsets.find(s);
+    if (found != offsets.end()) return found->second;
+    uint32_t offset = (uint32_t)pool.size(), len = (uint32_t)s.size();
+    pool.append((const char *)&len, 4);
+    pool.append(s);
+    pool.append(1 + (4 - (s.size() + 5) % 4) % 4, '\0');
+    offsets[s] = offset;
+    return offset;
+  }
+
+  template <class T> static void Append(std::string *out, const std::vector<T> &table) {
+    if (!table.empty()) out->append((const char *)table.data(), table.size() * sizeof(T));
+  }
+
+  std::string bytes() const {
+    Header h;
+    memcpy(h.magic, "LDOCIDX1", 8);
+    h.version = VERSION;
+    h.flags = 0;
+    uint32_t offset = sizeof(Header);
+    h.moduleCount = (uint32_t)modules.size();
+    h.modulesOffset = offset;
+    offset += h.moduleCount * sizeof(Module);
+    h.itemCount = (uint32_t)items.size();
+    h.itemsOffset = offset;
+    offset += h.itemCount * sizeof(Item);
+    h.paramCount = (uint32_t)params.size();
+    h.paramsOffset = offset;
+    offset += h.paramCount * sizeof(Param);
+    h.returnCount = (uint32_t)returns.size();
+    h.returnsOffset = offset;
+    offset += h.returnCount * sizeof(Return);
+    h.refCount = (uint32_t)refs.size();
+    h.refsOffset = offset;
+    offset += h.refCount * sizeof(Ref);
+    h.stringsOffset = offset;
+    h.stringsSize = (uint32_t)pool.size();
+    std::string out((const char *)&h, sizeof(h));
+    Append(&out, modules);
+    Append(&out, items);
+    Append(&out, params);
+    Append(&out, returns);
+    Append(&out, refs);
+    out.append(pool);
+    return out;
+  }
+};
+
+// two modules; 'sum' has two parameters, two return groups and a @see to 'util'
+static Builder Sample() {
+  Builder b;
+  b.params.push_back({b.str("a"), b.str("number"), b.str("the first"), 0, 0});
+  b.params.push_back({b.str("b"), b.str("number"), b.str("the second"), b.str("0"),
+		      PARAM_OPTIONAL | PARAM_READONLY});
+  b.returns.push_back({0, b.str("number"), b.str("the sum")});
+  b.returns.push_back({1, b.str("nil"), b.str("no numbers")});
+  b.returns.push_back({1, b.str("string"), b.str("the error")});
+  b.refs.push_back({b.str("util"), 1, NONE, b.str("modules/util.html")});
+  b.items.push_back({b.str("sum"), b.str("function"), b.str("add two numbers."), b.str(""),
+		     b.str("(a, b)"), b.str(""), b.str("math.lua"), 12, 0, 0, 2, 0, 3, 0, 1});
+  b.items.push_back({b.str("PI"), b.str("field"), b.str("the constant."), b.str(""),
+		     b.str(""), b.str(""), b.str("math.lua"), 20, 0, 2, 0, 3, 0, 1, 0});
+  b.items.push_back({b.str("trim"), b.str("function"), b.str("trim a string."), b.str(""),
+		     b.str("(s)"), b.str(""), b.str("util.lua"), 3, 1, 2, 0, 3, 0, 1, 0});
+  b.modules.push_back({b.str("math"), b.str("module"), b.str("Arithmetic."), b.str(""),
+		       b.str("math.lua"), 1, 0, 2, 1, 0});
+  b.modules.push_back({b.str("util"), b.str("module"), b.str("Helpers."), b.str(""),
+		       b.str("util.lua"), 1, 2, 1, 1, 0});
+  return b;
+}
+
+// the data in storage that is 4-byte aligned, like a mapped file
+static bool Open(Index *index, const std::string &bytes, std::vector<uint32_t> *storage) {
+  storage->assign(bytes.size() / 4 + 1, 0);
+  memcpy(storage->data(), bytes.data(), bytes.size());
+  return index->open(storage->data(), bytes.size());
+}
+
+static void TestRead() {
+  std::vector<uint32_t> storage;
+  Index index;
+  CHECK(Open(&index, Sample().bytes(), &storage));
+  CHECK(index.moduleCount() == 2);
+  CHECK(index.itemCount() == 3);
+
+  uint32_t m = index.findModule("math");
+  CHECK(m == 0);
+  CHECK(index.str(index.module(m).summary) == "Arithmetic.");
+  CHECK(index.findModule("none") == NONE);
+
+  uint32_t i = index.findItem(m, "sum");
+  CHECK(i == 0);
+  const Item &sum = index.item(i);
+  CHECK(index.str(sum.args) == "(a, b)");
+  CHECK(index.str(sum.file) == "math.lua" && sum.lineno == 12);
+  CHECK(sum.paramCount == 2);
+  CHECK(index.str(index.param(sum.firstParam).name) == "a");
+  const Param &b = index.param(sum.firstParam + 1);
+  CHECK(index.str(b.defaultValue) == "0");
+  CHECK(b.flags == (PARAM_OPTIONAL | PARAM_READONLY));
+  CHECK(sum.returnCount == 3);
+  CHECK(index.ret(sum.firstReturn + 2).group == 1);
+  CHECK(index.str(index.ret(sum.firstReturn + 2).type) == "string");
+  CHECK(sum.refCount == 1);
+  const Ref &see = index.ref(sum.firstRef);
+  CHECK(see.module == 1 && see.item == NONE);
+  CHECK(index.str(see.href) == "modules/util.html");
+
+  // items are looked for in their own module only
+  CHECK(index.findItem(m, "trim") == NONE);
+  CHECK(index.findItem(index.findModule("util"), "trim") == 2);
+
+  // the empty string is at 0; bad references to strings read as ""
+  CHECK(index.str(0).empty());
+  CHECK(index.str(1).empty());
+  CHECK(index.str(0xFFFFFFF0).empty());
+}
+
+static void TestEmpty() {
+  std::vector<uint32_t> storage;
+  Index index;
+  CHECK(Open(&index, Builder().bytes(), &storage));
+  CHECK(index.moduleCount() == 0);
+  CHECK(index.findModule("math") == NONE);
+}
+
+// open() must fail on each of these
+static void TestDamage() {
+  std::vector<uint32_t> storage;
+  Index index;
+  std::string good = Sample().bytes();
+
+  std::string bytes = good;
+  bytes[0] = 'X';
+  CHECK(!Open(&index, bytes, &storage));	// magic
+
+  bytes = good;
+  ((Header *)&bytes[0])->version = VERSION + 1;
+  CHECK(!Open(&index, bytes, &storage));
+
+  CHECK(!Open(&index, good.substr(0, sizeof(Header) - 1), &storage));
+  CHECK(!Open(&index, good.substr(0, good.size() - 4), &storage));	// pool cut off
+
+  // not 4-byte aligned
+  std::vector<uint32_t> unaligned(good.size() / 4 + 2, 0);
+  memcpy((char *)unaligned.data() + 1, good.data(), good.size());
+  CHECK(!index.open((const char *)unaligned.data() + 1, good.size()));
+
+  Builder b = Sample();
+  b.modules[1].itemCount = 2;			// past the last item
+  CHECK(!Open(&index, b.bytes(), &storage));
+
+  b = Sample();
+  b.items[0].paramCount = 3;
+  CHECK(!Open(&index, b.bytes(), &storage));
+
+  b = Sample();
+  b.items[0].firstReturn = 0xFFFFFFFF;		// overflows first + count
+  CHECK(!Open(&index, b.bytes(), &storage));
+
+  b = Sample();
+  b.items[2].module = 2;
+  CHECK(!Open(&index, b.bytes(), &storage));
+
+  b = Sample();
+  b.refs[0].item = 3;
+  CHECK(!Open(&index, b.bytes(), &storage));
+
+  bytes = good;
+  ((Header *)&bytes[0])->itemCount = 1000;	// table larger than the file
+  CHECK(!Open(&index, bytes, &storage));
+
+  bytes = good;
+  ((Header *)&bytes[0])->stringsOffset += 2;
+  CHECK(!Open(&index, bytes, &storage));
+}
+
+// index files written by ldoc --emit_index
+static void TestFile(const char *name) {
+  FILE *f = fopen(name, "rb");
+  if (!f) {
+    fprintf(stderr, "%s: cannot open file\n", name);
+    ++failures;
+    return;
+  }
+  std::string bytes;
+  char buffer[16384];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) bytes.append(buffer, n);
+  fclose(f);
+  std::vector<uint32_t> storage;
+  Index index;
+  if (!Open(&index, bytes, &storage)) {
+    fprintf(stderr, "%s: not a valid index\n", name);
+    ++failures;
+  }
+}
+
+int main(int argc, char **argv) {
+  TestRead();
+  TestEmpty();
+  TestDamage();
+  for (int i = 1; i < argc; ++i) TestFile(argv[i]);
+  if (failures == 0) printf("ok\n");
+  return failures == 0 ? 0 : 1;
+}
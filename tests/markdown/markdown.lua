@@ -0,0 +1,15 @@
+--- A module whose text uses Markdown.
+-- It is rendered with format = 'native' (see same.md and differences.md).
+-- @module markdown
+
+local markdown = {}
+
+--- a function with emphasis in its description.
+-- The *first* and the **second** argument; a some_name is left alone.
+-- @string first the first
+-- @string second the second
+function markdown.join (first, second)
+   return first..second
+end
+
+return markdown
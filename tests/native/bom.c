@@ -0,0 +1,13 @@
+﻿/// A C module whose file starts with a UTF-8 byte order mark.
+// @module bomc
+
+/***
+The first function of the module.
+@function first
+@string s any text
+@treturn string the same text
+*/
+static int l_first (lua_State *L) {
+  lua_settop(L, 1);
+  return 1;
+}
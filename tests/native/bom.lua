@@ -0,0 +1,13 @@
+﻿--- A module whose file starts with a UTF-8 byte order mark.
+-- @module bom
+
+local bom = {}
+
+--- the first function of the module.
+-- @string s any text
+-- @treturn string the same text
+function bom.first (s)
+   return s
+end
+
+return bom
@@ -0,0 +1,26 @@
+--- A module with CRLF line ends, and text to escape: a < b && c > "d" 'e'.
+-- Lines of this comment end in white space.   
+-- @module crlf
+
+local crlf = {}
+
+--- join two strings with a separator.   
+-- The separator defaults to `", "`.
+-- @string a the first string
+-- @string b the second string
+-- @string[opt] sep separator, like '&amp;' or "<br>"
+-- @treturn string the joined strings
+-- @usage
+-- local s = crlf.join('a', 'b')   
+-- assert(s == "a, b")
+function crlf.join (a, b, sep)
+   return a .. (sep or ", ") .. b
+end
+
+--- a multi-line string.
+crlf.text = [[
+first line
+second line
+]]
+
+return crlf
@@ -0,0 +1,30 @@
+--- Code for the highlighter: globals, calls, user keywords and references.
+-- @module highlight
+
+local highlight = {}
+
+--- calls of all kinds.
+-- `expect` is a user keyword (see config.ld), so it is never a function name.
+-- @usage
+-- local t = highlight.calls {1, 2}
+-- expect(#t == 2)
+-- print(string.format("%d & %d", t[1], t[2]))
+function highlight.calls (t, ...)
+   local n = select('#', ...) -- see @{highlight.calls} and `highlight.numbers`
+   expect (n >= 0)
+   print "no parentheses"
+   table.insert(t, 0x1F)
+   return setmetatable(t, {__index = highlight}):method(1.5e3)
+end
+
+--- numbers, operators and long comments.
+-- @treturn number a number
+function highlight.numbers ()
+   --[[ a long comment
+   over two lines with <tags> ]]
+   local a, b = 10, 2.5
+   return a ~= b and a // 3 or a .. b
+end
+
+return highlight
+-- the file ends with a comment and no line end
\ No newline at end of file
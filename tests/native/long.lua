@@ -0,0 +1,43 @@
+--[[--
+Long strings and comments.
+A doc comment may be a long comment, and long strings and comments may
+contain what ends the shorter ones.
+
+@module long
+]]
+
+local long = {}
+
+--[==[
+Not a doc comment: ]] and --[[ do not end or start anything here.
+]==]
+
+--- a long string with levels.
+-- @treturn string text with `]]` in it
+function long.text ()
+   return [==[
+first line
+]] still the string ]=] too
+]==]
+end
+
+--[[ a long comment on one line ]] local function helper () return [[]] end
+
+--- a long string right after a call.
+-- @param f a function
+-- @return what `f` gives for the string
+function long.call (f)
+   return f[[
+argument]], helper()
+end
+
+--[=[--
+A doc comment as a long comment with a level.
+@tparam string s some text
+@treturn number its length
+]=]
+function long.length (s)
+   return #s --[[ the length ]]
+end
+
+return long
@@ -0,0 +1,36 @@
+--- Strings with and without escapes.
+-- Also characters which have to be escaped in HTML: < > &.
+-- @module strings
+
+local strings = {}
+
+--- strings as default values.
+-- @string[opt="a \"quoted\" word"] q a string with escaped quotes
+-- @string[opt='it\'s'] a an escaped quote in single quotes
+function strings.defaults (q, a)
+   q = q or "a \"quoted\" word"
+   a = a or 'it\'s'
+   return q, a
+end
+
+--- escapes of all kinds.
+-- @treturn table the strings
+function strings.escapes ()
+   return {
+      "plain", 'plain', "", '',
+      "\\", '\\', "\\\"", "a\\", 'b\\',
+      "\n\t\r\a\b\f\v", "\65\066\0677", "\x41\x42",
+      "\z
+         continued", "line\
+break",
+      "<tag> & 'quotes'", '<"double"> &amp;',
+      "-- not a comment", '[[not long]]',
+   }
+end
+
+--- a string ending in a backslash before a comment.
+function strings.backslash ()
+   return "\\" -- and a "comment"
+end
+
+return strings